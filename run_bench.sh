@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+# Compila y ejecuta el benchmark del analizador. Los parametros se pasan al
+# benchmark (ver bin/bench/bench_analizador -h). Cada medicion se escribe en
+# la salida estandar como un objeto JSON por linea.
+BENCH_PATH=bin/bench
+TEST_SRC=tests
+SRC=src
+CC_FLAGS="-fopenmp -O3 -Wall -std=c99"
+
+mkdir -p $BENCH_PATH
+gcc $CC_FLAGS -o $BENCH_PATH/bench_analizador \
+    $TEST_SRC/bench_analizador.c $SRC/analizador.c $SRC/indice.c $SRC/fuente.c \
+    $SRC/subredes.c $SRC/columnas.c $SRC/copia.c \
+    $SRC/cola.c $SRC/metricas.c
+
+if [ $? -eq 0 ]
+then
+    $BENCH_PATH/bench_analizador "$@"
+else
+    exit 1
+fi
@@ -6,7 +6,10 @@ CC_FLAGS="-fopenmp -fprofile-arcs -ftest-coverage -g -Wall -std=c99"
 
 mkdir -p $TEST_PATH
 gcc $CC_FLAGS -o $TEST_PATH/test_analizador \
-    $TEST_SRC/test_analizador.c $SRC/analizador.c
+    $TEST_SRC/test_analizador.c $SRC/analizador.c $SRC/indice.c \
+    $SRC/ventana.c $SRC/instantanea.c $SRC/captura.c $SRC/vivo.c $SRC/fuente.c \
+    $SRC/subredes.c $SRC/columnas.c $SRC/recarga.c \
+    $SRC/copia.c $SRC/cola.c $SRC/metricas.c
 
 if [ $? -eq 0 ]
 then
@@ -1,26 +1,73 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
+#include <syslog.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "analizador.h"
+#include "indice.h"
+#include "subredes.h"
+#include "columnas.h"
+#include "metricas.h"
+
+#ifdef _OPENMP
+#define HILO_ACTUAL omp_get_thread_num()
+#define MAX_HILOS omp_get_max_threads()
+#else
+#define HILO_ACTUAL 0
+#define MAX_HILOS 1
+#endif
 
 
 /*
  * prefijo
  * ---------------------------------------------------------------------------
  *  Obtiene la cantidad de bits de la mascara de subred pasada por parametro.
+ *  La cantidad de bits en uno es el prefijo si la mascara es igual a la
+ *  mascara de ese prefijo; caso contrario los bits no son contiguos.
+ *
+ *  Devuelve -1 si la mascara no es valida.
  */
 int prefijo(u_int32_t mascara)
 {
-    int i = 0;
-    if (mascara == MASCARA_HOST) {
-        return 32;
-    }
-    while (i < 32) {
-        if (mascara == GET_MASCARA(i))
-            return i;
-        i++;
-    }
-    return -1;
+    u_int32_t m = ntohl(mascara);
+    int bits = __builtin_popcount(m);
+    if (bits == 0)
+        return 0;
+    return m == 0xffffffff << (32 - bits) ? bits : -1;
+}
+
+/**
+ * ip_grupo(paquete, grupo)
+ * ---------------------------------------------------------------------------
+ *  Devuelve la direccion ip del paquete que se compara con las subredes del
+ *  grupo (outside o inside) segun la direccion del paquete.
+ */
+struct in_addr ip_grupo(const struct paquete *paquete, int grupo)
+{
+    if (grupo == GRUPO_OUTSIDE && paquete->direccion == ENTRANTE)
+        return paquete->ip_origen;
+    else if (grupo == GRUPO_INSIDE && paquete->direccion == SALIENTE)
+        return paquete->ip_origen;
+    return paquete->ip_destino;
+}
+
+/**
+ * puerto_grupo(paquete, grupo)
+ * ---------------------------------------------------------------------------
+ *  Devuelve el puerto del paquete que se compara con los puertos del grupo
+ *  (outside o inside) segun la direccion del paquete.
+ */
+int puerto_grupo(const struct paquete *paquete, int grupo)
+{
+    if (grupo == GRUPO_OUTSIDE && paquete->direccion == ENTRANTE)
+        return paquete->puerto_origen;
+    else if (grupo == GRUPO_INSIDE && paquete->direccion == SALIENTE)
+        return paquete->puerto_origen;
+    return paquete->puerto_destino;
 }
 
 /**
@@ -29,34 +76,30 @@ int prefijo(u_int32_t mascara)
  *  Compara las ips del paquete con un array de subredes de la clase de
  *  trafico.
  *
- *  Devuelve puntaje de coincidencia. A mayor puntaje, mejor coincidencia
+ *  Devuelve puntaje de coincidencia. A mayor puntaje, mejor coincidencia. El
+ *  puntaje es el prefijo mas largo de las subredes que contienen a la ip,
+ *  que se calcula al cargar cada subred.
  */
 int coincide_subred(const struct paquete *paquete,
                     const struct subred *subredes, int cantidad, int grupo)
 {
-    int i = 0;
+    int i, p;
     /* por defecto si la clase no especifica subredes, asumo coincidencia y
      * asigna un punto.
      */
     int puntos = cantidad == 0;
-    struct in_addr ip = paquete->ip_destino;
-
     /* determino si voy a usar la ip de origen o de destino del paquete para
      * la comparacion
      */
-    if (grupo == GRUPO_OUTSIDE && paquete->direccion == ENTRANTE)
-        ip = paquete->ip_origen;
-    else if (grupo == GRUPO_OUTSIDE && paquete->direccion == SALIENTE)
-        ip = paquete->ip_destino;
-    else if (grupo == GRUPO_INSIDE && paquete->direccion == ENTRANTE)
-        ip = paquete->ip_destino;
-    else if (grupo == GRUPO_INSIDE && paquete->direccion == SALIENTE)
-        ip = paquete->ip_origen;
+    struct in_addr ip = ip_grupo(paquete, grupo);
 
-    while (!puntos && i < cantidad) {
-        if (en_subred(ip, (subredes + i)))
-            puntos = prefijo((subredes + i)->mascara);
-        i++;
+
+    for (i = 0; i < cantidad; i++) {
+        if (en_subred(ip, (subredes + i))) {
+            p = (subredes + i)->prefijo;
+            if (p > puntos)
+                puntos = p;
+        }
     }
     return puntos;
 }
@@ -77,19 +120,10 @@ int coincide_puerto(const struct paquete *paquete,
      * asigna un punto.
      */
     int coincide = cantidad == 0;
-    int puerto;
-
     /* determino si voy a usar el puerto de origen o de destino del paquete
      * para la comparacion
      */
-    if (grupo == GRUPO_OUTSIDE && paquete->direccion == ENTRANTE)
-        puerto = paquete->puerto_origen;
-    else if (grupo == GRUPO_OUTSIDE && paquete->direccion == SALIENTE)
-        puerto = paquete->puerto_destino;
-    else if (grupo == GRUPO_INSIDE && paquete->direccion == ENTRANTE)
-        puerto = paquete->puerto_destino;
-    else if (grupo == GRUPO_INSIDE && paquete->direccion == SALIENTE)
-        puerto = paquete->puerto_origen;
+    int puerto = puerto_grupo(paquete, grupo);
 
     while (!coincide && i < cantidad) {
         coincide = puerto == (puertos + i)->numero;
@@ -138,6 +172,40 @@ int coincide(const struct clase *clase, const struct paquete *paquete)
         return 0;
 }
 
+/*
+ * coincide_vectores
+ * ---------------------------------------------------------------------------
+ *  Igual que coincide() pero compara las subredes de la clase con sus
+ *  vectores.
+ */
+static int coincide_vectores(const struct clase *clase,
+                             struct vector_subredes * const *vectores,
+                             const struct paquete *paquete)
+{
+    int redes_O = clase->cant_subredes_outside == 0 ? 1 :
+                  mejor_prefijo(vectores[0],
+                                ip_grupo(paquete, GRUPO_OUTSIDE));
+    int redes_I = clase->cant_subredes_inside == 0 ? 1 :
+                  mejor_prefijo(vectores[1],
+                                ip_grupo(paquete, GRUPO_INSIDE));
+    int puerto_O, puerto_I;
+
+    /* un prefijo /0 no suma puntos, igual que en coincide_subred() */
+    if (redes_O <= 0 || redes_I <= 0)
+        return 0;
+    puerto_O = coincide_puerto(paquete,
+                               clase->puertos_outside,
+                               clase->cant_puertos_outside,
+                               GRUPO_OUTSIDE);
+    puerto_I = coincide_puerto(paquete,
+                               clase->puertos_inside,
+                               clase->cant_puertos_inside,
+                               GRUPO_INSIDE);
+    if (puerto_O && puerto_I)
+        return redes_O + redes_I + puerto_O + puerto_I;
+    return 0;
+}
+
 /**
  * imprimir(clases, cantidad)
  * ---------------------------------------------------------------------------
@@ -172,15 +240,19 @@ int clases_to_file(FILE* file, const struct s_analizador *analizador)
                     "    \"id\": %d,\n"
                     "    \"nombre\": \"%s\",\n"
                     "    \"descripcion\": \"%s\",\n"
-                    "    \"subida\": %d,\n"
-                    "    \"bajada\": %d\n"
+                    "    \"subida\": %" PRIu64 ",\n"
+                    "    \"bajada\": %" PRIu64 ",\n"
+                    "    \"paquetes_subida\": %" PRIu64 ",\n"
+                    "    \"paquetes_bajada\": %" PRIu64 "\n"
                     "  }",
                     cantidad_procesada != 0 ? ',' : ' ',
                     (clases + i)->id,
                     (clases + i)->nombre,
                     (clases + i)->descripcion,
                     (clases + i)->bytes_subida,
-                    (clases + i)->bytes_bajada);
+                    (clases + i)->bytes_bajada,
+                    (clases + i)->paquetes_subida,
+                    (clases + i)->paquetes_bajada);
             cantidad_procesada++;
         }
     }
@@ -193,19 +265,193 @@ int clases_to_file(FILE* file, const struct s_analizador *analizador)
 /*
  * sumar_bytes
  * ---------------------------------------------------------------------------
- *  Suma los bytes del paquete a la clase de trafico.
+ *  Suma los bytes y la cantidad de paquetes a la clase de trafico.
+ *
+ *  Si el analizador tiene contadores por hilo, se suman al contador del hilo
+ *  actual sin sincronizacion. Caso contrario se suman directamente a la clase
+ *  de forma atomica.
  */
-void sumar_bytes(struct clase *clase, const struct paquete *paquete) {
-    if (paquete->direccion == ENTRANTE) {
+void sumar_bytes(const struct s_analizador *analizador, struct clase *clase,
+                 const struct paquete *paquete) {
+    struct contador *contador;
+    int hilo = HILO_ACTUAL;
+    if (analizador->contadores != NULL && hilo < analizador->cant_hilos) {
+        contador = analizador->contadores +
+                   hilo * analizador->contadores_hilo +
+                   (clase - analizador->clases);
+        if (paquete->direccion == ENTRANTE) {
+            contador->bytes_bajada += paquete->bytes;
+            contador->paquetes_bajada += paquete->cantidad;
+        } else if (paquete->direccion == SALIENTE) {
+            contador->bytes_subida += paquete->bytes;
+            contador->paquetes_subida += paquete->cantidad;
+        }
+    }
+    else if (paquete->direccion == ENTRANTE) {
         #pragma omp atomic
         clase->bytes_bajada += paquete->bytes;
+        #pragma omp atomic
+        clase->paquetes_bajada += paquete->cantidad;
     }
     else if (paquete->direccion == SALIENTE) {
         #pragma omp atomic
         clase->bytes_subida += paquete->bytes;
+        #pragma omp atomic
+        clase->paquetes_subida += paquete->cantidad;
+    }
+}
+
+
+/*
+ * contar_candidatas
+ * ---------------------------------------------------------------------------
+ *  Suma una comparacion a cada clase candidata que devolvio el indice para
+ *  el paquete. Solo se llama si se miden las comparaciones por clase.
+ */
+static void contar_candidatas(const u_int64_t *candidatas, int palabras,
+                              struct metrica_clase *metricas)
+{
+    u_int64_t palabra;
+    int i, c;
+    for (i = 0; i < palabras; i++) {
+        palabra = candidatas[i];
+        while (palabra) {
+            c = i * BITS_PALABRA + __builtin_ctzll(palabra);
+            palabra &= palabra - 1;
+            metricas[c].intentos++;
+        }
     }
 }
 
+/**
+ * clasificar_paquete(s_analizador, paquete)
+ * --------------------------------------------------------------------------
+ *  Busca la clase de trafico con mejor coincidencia con el paquete. Si las
+ *  clases fueron compiladas, se busca la mejor coincidencia en el indice.
+ *
+ *  Si se miden las comparaciones por clase, se cuentan en las metricas del
+ *  hilo actual las clases comparadas (con indice, las candidatas que
+ *  devuelve la misma busqueda) y la clase elegida.
+ *
+ *  Devuelve la posicion de la clase en el array de clases o 0 (la clase por
+ *  defecto) si el paquete no coincide con ninguna.
+ */
+int clasificar_paquete(const struct s_analizador* analizador,
+                       const struct paquete* paquete)
+{
+    int mayor_puntaje = 0;
+    int mejor_coincidencia = 0; /* por defecto, la clase por default */
+    int puntaje = 0; /* almacena el resultado de la comparacion con la clase */
+    int i = 0; /* iterador de clases */
+    struct metrica_clase *metricas = analizador->metricas == NULL ? NULL :
+        metricas_clases_hilo(analizador->metricas, analizador->cant_clases);
+
+    if (analizador->indice != NULL && metricas == NULL)
+        return indice_mejor_clase(analizador->indice, paquete, &puntaje, NULL);
+    if (analizador->indice != NULL) {
+        u_int64_t candidatas[analizador->indice->palabras];
+        mejor_coincidencia = indice_mejor_clase(analizador->indice, paquete,
+                                                &puntaje, candidatas);
+        contar_candidatas(candidatas, analizador->indice->palabras,
+                          metricas);
+        metricas[mejor_coincidencia].aciertos++;
+        return mejor_coincidencia;
+    }
+
+    /* La primer clase es la clase por default, no se compara. */
+    for (i = 1; i < analizador->cant_clases; i++) {
+        puntaje = analizador->vectores != NULL ?
+                  coincide_vectores(analizador->clases + i,
+                                    analizador->vectores + 2 * i,
+                                    paquete) :
+                  coincide(analizador->clases + i, paquete);
+        if (metricas != NULL)
+            metricas[i].intentos++;
+        if (puntaje > mayor_puntaje) {
+            mayor_puntaje = puntaje;
+            mejor_coincidencia = i;
+        }
+    }
+    if (metricas != NULL)
+        metricas[mejor_coincidencia].aciertos++;
+    return mejor_coincidencia;
+}
+
+/*
+ * hash_claves
+ * ---------------------------------------------------------------------------
+ *  Calcula la posicion en la cache de flujos del flujo con las claves pasadas
+ *  por parametro.
+ */
+static inline u_int32_t hash_claves(u_int32_t ip_origen, u_int32_t ip_destino,
+                                    u_int16_t puerto_origen,
+                                    u_int16_t puerto_destino,
+                                    int protocolo, int direccion)
+{
+    u_int64_t h = ((u_int64_t) ip_origen << 32) | ip_destino;
+    h ^= (((u_int64_t) puerto_origen << 48) |
+          ((u_int64_t) puerto_destino << 32) |
+          ((u_int64_t) (u_int32_t) protocolo << 1) |
+          (u_int64_t) (direccion & 1)) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (u_int32_t) h & (TAMANIO_CACHE - 1);
+}
+
+/*
+ * hash_flujo
+ * ---------------------------------------------------------------------------
+ *  Calcula la posicion del flujo del paquete en la cache de flujos.
+ */
+static u_int32_t hash_flujo(const struct paquete *paquete)
+{
+    return hash_claves(paquete->ip_origen.s_addr, paquete->ip_destino.s_addr,
+                       paquete->puerto_origen, paquete->puerto_destino,
+                       paquete->protocolo, paquete->direccion);
+}
+
+/*
+ * clase_cache
+ * ---------------------------------------------------------------------------
+ *  Obtiene la clase del paquete de la entrada de la cache de su flujo. Si la
+ *  entrada es de otro flujo o de una generacion anterior, se clasifica el
+ *  paquete y se reemplaza la entrada. Si se miden las comparaciones por
+ *  clase, el acierto se cuenta en la clase de la entrada.
+ */
+static inline int clase_cache(const struct s_analizador* analizador,
+                              struct cache_flujos *cache,
+                              struct entrada_cache *entrada,
+                              const struct paquete* paquete)
+{
+    struct metrica_clase *metricas;
+    int clase;
+    if (entrada->generacion == analizador->generacion &&
+        entrada->ip_origen == paquete->ip_origen.s_addr &&
+        entrada->ip_destino == paquete->ip_destino.s_addr &&
+        entrada->puerto_origen == paquete->puerto_origen &&
+        entrada->puerto_destino == paquete->puerto_destino &&
+        entrada->protocolo == paquete->protocolo &&
+        entrada->direccion == (int) paquete->direccion) {
+        cache->aciertos++;
+        if (analizador->metricas != NULL &&
+            (metricas = metricas_clases_hilo(analizador->metricas,
+                                             analizador->cant_clases)) != NULL)
+            metricas[entrada->clase].cache++;
+        return entrada->clase;
+    }
+    cache->fallos++;
+    clase = clasificar_paquete(analizador, paquete);
+    entrada->ip_origen = paquete->ip_origen.s_addr;
+    entrada->ip_destino = paquete->ip_destino.s_addr;
+    entrada->puerto_origen = paquete->puerto_origen;
+    entrada->puerto_destino = paquete->puerto_destino;
+    entrada->protocolo = paquete->protocolo;
+    entrada->direccion = paquete->direccion;
+    entrada->generacion = analizador->generacion;
+    entrada->clase = clase;
+    return clase;
+}
 
 /**
  * analizar_paquete(s_analizador, paquete)
@@ -213,7 +459,9 @@ void sumar_bytes(struct clase *clase, const struct paquete *paquete) {
  *  Compara un paquete con las clases de trafico instaladas. En caso que no
  *  coincida con ninuna, se agrega a la clase por defecto.
  *
- *  Se agregan los bytes a la clase con la mejor coincidencia.
+ *  Se agregan los bytes a la clase con la mejor coincidencia. Si el
+ *  analizador tiene cache de flujos, primero se busca el flujo en la cache
+ *  del hilo actual y solo si no esta se clasifica el paquete.
  *
  *  Devuelve 1 en caso que haya coincidencia con alguna clase de trafico, 0 en
  *  caso de que se haya agregado el paquete a la clase por defecto.
@@ -221,33 +469,458 @@ void sumar_bytes(struct clase *clase, const struct paquete *paquete) {
 int analizar_paquete(const struct s_analizador* analizador,
                      const struct paquete* paquete)
 {
-    int mayor_puntaje = 0;
-    struct clase *mejor_coincidencia = NULL;
-    struct clase *clases = analizador->cant_clases > 0 ?
-                           analizador->clases + 1 :
-                           NULL;
-    /* Por defecto, la primer clase es la clase por default. */
-    struct clase *clase_default = analizador->cant_clases > 0 ?
-                                  analizador->clases :
-                                  NULL;
-    int puntaje = 0; /* almacena el resultado de la comparacion con la clase */
-    int i = 0; /* iterador de clases */
+    struct cache_flujos *cache;
+    int hilo = HILO_ACTUAL;
+    int clase;
 
-    for (i = 0; i < analizador->cant_clases - 1; i++) {
-        puntaje = coincide(clases + i, paquete);
-        if (puntaje > mayor_puntaje) {
-            mayor_puntaje = puntaje;
-            mejor_coincidencia = clases + i;
+    if (analizador->cant_clases <= 0)
+        return 0;
+
+    if (analizador->caches != NULL && hilo < analizador->cant_caches) {
+        cache = analizador->caches + hilo;
+        clase = clase_cache(analizador, cache,
+                            cache->entradas + hash_flujo(paquete), paquete);
+    } else {
+        clase = clasificar_paquete(analizador, paquete);
+    }
+
+    sumar_bytes(analizador, analizador->clases + clase, paquete);
+    return clase > 0;
+}
+
+/*
+ * analizar_bloque
+ * ---------------------------------------------------------------------------
+ *  Clasifica un bloque de hasta BLOQUE_LOTE paquetes cuyas posiciones en la
+ *  cache ya se calcularon y anticiparon. Primero se anticipa la lectura de
+ *  las tablas de puertos del indice y luego se clasifica cada paquete.
+ *
+ *  Devuelve la cantidad de paquetes que coincidieron con alguna clase de
+ *  trafico distinta de la clase por defecto.
+ */
+static inline int analizar_bloque(const struct s_analizador* analizador,
+                                  struct cache_flujos *cache,
+                                  const u_int32_t *posiciones,
+                                  const struct paquete* paquetes,
+                                  int cantidad,
+                                  int *clases)
+{
+    int i, clase, coincidencias = 0;
+    if (analizador->indice != NULL)
+        for (i = 0; i < cantidad; i++)
+            indice_anticipar(analizador->indice, paquetes + i);
+    for (i = 0; i < cantidad; i++) {
+        clase = cache != NULL ?
+                clase_cache(analizador, cache,
+                            cache->entradas + posiciones[i],
+                            paquetes + i) :
+                clasificar_paquete(analizador, paquetes + i);
+        sumar_bytes(analizador, analizador->clases + clase, paquetes + i);
+        if (clases != NULL)
+            clases[i] = clase;
+        coincidencias += clase > 0;
+    }
+    return coincidencias;
+}
+
+/**
+ * analizar_lote(s_analizador, paquetes, cantidad, clases)
+ * --------------------------------------------------------------------------
+ *  Analiza los paquetes de a bloques de BLOQUE_LOTE. Para cada bloque primero
+ *  se calculan las posiciones de los flujos en la cache y se anticipa la
+ *  lectura de las entradas de la cache y de las tablas de puertos del
+ *  indice; luego se clasifica cada paquete, cuando esas lineas ya estan en
+ *  la cache del procesador.
+ *
+ *  Devuelve la cantidad de paquetes que coincidieron con alguna clase de
+ *  trafico distinta de la clase por defecto.
+ */
+int analizar_lote(const struct s_analizador* analizador,
+                  const struct paquete* paquetes,
+                  int cantidad,
+                  int *clases)
+{
+    struct cache_flujos *cache = NULL;
+    u_int32_t posiciones[BLOQUE_LOTE];
+    u_int64_t reloj = iniciar_etapa(analizador->metricas);
+    int hilo = HILO_ACTUAL;
+    int inicio, fin, i, coincidencias = 0;
+
+    if (analizador->cant_clases <= 0)
+        return 0;
+    if (analizador->caches != NULL && hilo < analizador->cant_caches)
+        cache = analizador->caches + hilo;
+
+    for (inicio = 0; inicio < cantidad; inicio += BLOQUE_LOTE) {
+        fin = inicio + BLOQUE_LOTE < cantidad ?
+              inicio + BLOQUE_LOTE :
+              cantidad;
+        /* claves del bloque y lectura anticipada */
+        if (cache != NULL)
+            for (i = inicio; i < fin; i++) {
+                posiciones[i - inicio] = hash_flujo(paquetes + i);
+                __builtin_prefetch(cache->entradas + posiciones[i - inicio]);
+            }
+        coincidencias += analizar_bloque(analizador, cache, posiciones,
+                                         paquetes + inicio, fin - inicio,
+                                         clases != NULL ? clases + inicio :
+                                                          NULL);
+    }
+    terminar_clasificacion(analizador->metricas, reloj, cantidad);
+    return coincidencias;
+}
+
+/**
+ * analizar_columnas(s_analizador, lote, inicio, cantidad, clases)
+ * --------------------------------------------------------------------------
+ *  Igual que analizar_lote() pero las posiciones de los flujos en la cache
+ *  se calculan leyendo solo las columnas de las claves. Cada bloque se copia
+ *  a un array de paquetes en la pila, que queda en la cache del procesador,
+ *  para clasificarlo.
+ *
+ *  Devuelve la cantidad de paquetes que coincidieron con alguna clase de
+ *  trafico distinta de la clase por defecto.
+ */
+int analizar_columnas(const struct s_analizador* analizador,
+                      const struct lote_columnas* lote,
+                      int inicio,
+                      int cantidad,
+                      int *clases)
+{
+    struct cache_flujos *cache = NULL;
+    struct paquete bloque[BLOQUE_LOTE];
+    u_int32_t posiciones[BLOQUE_LOTE];
+    u_int64_t reloj = iniciar_etapa(analizador->metricas);
+    int hilo = HILO_ACTUAL;
+    int primero, fin, i, coincidencias = 0;
+
+    if (analizador->cant_clases <= 0)
+        return 0;
+    if (analizador->caches != NULL && hilo < analizador->cant_caches)
+        cache = analizador->caches + hilo;
+
+    fin = inicio + cantidad;
+    for (primero = inicio; primero < fin; primero += BLOQUE_LOTE) {
+        cantidad = fin - primero < BLOQUE_LOTE ? fin - primero : BLOQUE_LOTE;
+        if (cache != NULL)
+            for (i = 0; i < cantidad; i++) {
+                posiciones[i] = hash_claves(lote->ip_origen[primero + i],
+                                            lote->ip_destino[primero + i],
+                                            lote->puerto_origen[primero + i],
+                                            lote->puerto_destino[primero + i],
+                                            lote->protocolo[primero + i],
+                                            lote->direccion[primero + i]);
+                __builtin_prefetch(cache->entradas + posiciones[i]);
+            }
+        columnas_a_paquetes(lote, primero, cantidad, bloque);
+        coincidencias += analizar_bloque(analizador, cache, posiciones,
+                                         bloque, cantidad,
+                                         clases != NULL ?
+                                         clases + primero - inicio : NULL);
+    }
+    terminar_clasificacion(analizador->metricas, reloj, fin - inicio);
+    return coincidencias;
+}
+
+/**
+ * compilar_clases(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Compila las clases de trafico del analizador en un indice para evitar
+ *  comparar cada paquete con todas las clases.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int compilar_clases(struct s_analizador* analizador)
+{
+    struct indice *indice = crear_indice(analizador->clases,
+                                         analizador->cant_clases);
+    if (indice == NULL)
+        return -1;
+    free_indice(analizador->indice);
+    analizador->indice = indice;
+    invalidar_cache(analizador);
+    return 0;
+}
+
+/**
+ * free_vectores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Libera los vectores de subredes de las clases.
+ */
+void free_vectores(struct s_analizador* analizador)
+{
+    int i;
+    if (analizador->vectores == NULL)
+        return;
+    for (i = 0; i < 2 * analizador->cant_clases; i++)
+        free_vector_subredes(analizador->vectores[i]);
+    free(analizador->vectores);
+    analizador->vectores = NULL;
+}
+
+/**
+ * vectorizar_clases(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Crea los vectores de subredes outside e inside de cada clase.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int vectorizar_clases(struct s_analizador* analizador)
+{
+    struct clase *clase;
+    int i;
+    free_vectores(analizador);
+    analizador->vectores = calloc(2 * analizador->cant_clases + 1,
+                                  sizeof(struct vector_subredes*));
+    if (analizador->vectores == NULL)
+        return -1;
+    for (i = 0; i < analizador->cant_clases; i++) {
+        clase = analizador->clases + i;
+        analizador->vectores[2 * i] = crear_vector_subredes(
+                clase->subredes_outside, clase->cant_subredes_outside);
+        analizador->vectores[2 * i + 1] = crear_vector_subredes(
+                clase->subredes_inside, clase->cant_subredes_inside);
+        if (analizador->vectores[2 * i] == NULL ||
+                analizador->vectores[2 * i + 1] == NULL) {
+            free_vectores(analizador);
+            return -1;
         }
     }
+    return 0;
+}
 
-    if (mayor_puntaje > 0) {
-        /* con coincidencia */
-        sumar_bytes(mejor_coincidencia, paquete);
-    } else {
-        /* sin coincidencia */
-        sumar_bytes(clase_default, paquete);
+/**
+ * free_analizador(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Libera la memoria ocupada por las estructuras compiladas del analizador.
+ */
+void free_analizador(struct s_analizador* analizador)
+{
+    free_vectores(analizador);
+    free_indice(analizador->indice);
+    analizador->indice = NULL;
+    free(analizador->memoria_contadores);
+    analizador->memoria_contadores = NULL;
+    analizador->contadores = NULL;
+    analizador->cant_hilos = 0;
+    free(analizador->caches);
+    analizador->caches = NULL;
+    analizador->cant_caches = 0;
+}
+
+/**
+ * reemplazar_clases(s_analizador, clases, cant_clases, indice)
+ * --------------------------------------------------------------------------
+ *  Primero se crean los contadores de la nueva cantidad de clases, que es lo
+ *  unico que puede fallar, y luego se reemplazan las clases.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int reemplazar_clases(struct s_analizador* analizador, struct clase *clases,
+                      int cant_clases, struct indice *indice)
+{
+    int anterior = analizador->cant_clases;
+    int vectorizado = analizador->vectores != NULL;
+    if (analizador->contadores != NULL) {
+        analizador->cant_clases = cant_clases;
+        if (iniciar_contadores(analizador) < 0) {
+            analizador->cant_clases = anterior;
+            return -1;
+        }
+        analizador->cant_clases = anterior;
+    }
+    free_vectores(analizador);
+    analizador->clases = clases;
+    analizador->cant_clases = cant_clases;
+    analizador->indice = indice;
+    /* sin vectores se compara de a una subred, con el mismo resultado */
+    if (vectorizado && vectorizar_clases(analizador) < 0)
+        syslog(LOG_WARNING, "No se pudieron crear los vectores de subredes");
+    /* las comparaciones por clase empiezan de nuevo con las clases nuevas */
+    if (analizador->metricas != NULL &&
+            reiniciar_clases_metricas(analizador->metricas, cant_clases) < 0)
+        syslog(LOG_WARNING, "No se contaran las comparaciones por clase");
+    invalidar_cache(analizador);
+    return 0;
+}
+
+/**
+ * crear_clases(cant_clases, cant_subredes, cant_puertos, subredes, puertos)
+ * --------------------------------------------------------------------------
+ *  El bloque tiene las clases, luego las subredes y luego los puertos. El
+ *  tamaño de struct clase y de struct subred es multiplo de la alineacion de
+ *  las estructuras que les siguen, por lo que no hace falta relleno.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct clase* crear_clases(int cant_clases, int cant_subredes,
+                           int cant_puertos, struct subred **subredes,
+                           struct puerto **puertos)
+{
+    struct clase *clases;
+    clases = calloc(1, sizeof(struct clase) * cant_clases +
+                       sizeof(struct subred) * cant_subredes +
+                       sizeof(struct puerto) * cant_puertos);
+    if (clases == NULL) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para cargar %d clases de trafico",
+               cant_clases);
+        return NULL;
+    }
+    *subredes = (struct subred *) (clases + cant_clases);
+    *puertos = (struct puerto *) (*subredes + cant_subredes);
+    return clases;
+}
+
+/**
+ * free_clases
+ * --------------------------------------------------------------------------
+ *  Las subredes y puertos estan en el mismo bloque que las clases, por lo
+ *  que se liberan con una sola llamada.
+ */
+void free_clases(struct clase *clases)
+{
+    free(clases);
+}
+
+/**
+ * iniciar_contadores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Crea un array de contadores de bytes por clase para cada hilo. El array de
+ *  cada hilo ocupa lineas de cache completas para que los hilos no compartan
+ *  lineas de cache.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int iniciar_contadores(struct s_analizador* analizador)
+{
+    int por_linea = LINEA_CACHE / sizeof(struct contador);
+    int hilos = MAX_HILOS;
+    int por_hilo = (analizador->cant_clases + por_linea - 1) /
+                   por_linea * por_linea;
+    size_t tamanio = sizeof(struct contador) * por_hilo * hilos;
+    void *memoria = calloc(1, tamanio + LINEA_CACHE);
+    if (memoria == NULL) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para contadores de %d hilos",
+               hilos);
+        return -1;
     }
+    free(analizador->memoria_contadores);
+    analizador->memoria_contadores = memoria;
+    /* alineo el array al inicio de una linea de cache */
+    analizador->contadores = (struct contador *)
+        (((uintptr_t) memoria + LINEA_CACHE - 1) &
+         ~(uintptr_t) (LINEA_CACHE - 1));
+    analizador->contadores_hilo = por_hilo;
+    analizador->cant_hilos = hilos;
+    return 0;
+}
+
+/**
+ * reducir_contadores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Suma los contadores de todos los hilos a las clases de trafico y los
+ *  vuelve a cero.
+ */
+void reducir_contadores(struct s_analizador* analizador)
+{
+    struct contador *contador;
+    struct clase *clase;
+    int i, j;
+    if (analizador->contadores == NULL)
+        return;
+    for (i = 0; i < analizador->cant_hilos; i++) {
+        for (j = 0; j < analizador->cant_clases; j++) {
+            contador = analizador->contadores +
+                       i * analizador->contadores_hilo + j;
+            clase = analizador->clases + j;
+            clase->bytes_subida += contador->bytes_subida;
+            clase->bytes_bajada += contador->bytes_bajada;
+            clase->paquetes_subida += contador->paquetes_subida;
+            clase->paquetes_bajada += contador->paquetes_bajada;
+            memset(contador, 0, sizeof(struct contador));
+        }
+    }
+}
 
-    return mayor_puntaje > 0;
+/**
+ * descartar_contadores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Vuelve a cero los contadores de los hilos y los totales de las clases.
+ */
+void descartar_contadores(struct s_analizador* analizador)
+{
+    struct clase *clase;
+    int i;
+    if (analizador->contadores != NULL)
+        memset(analizador->contadores, 0,
+               sizeof(struct contador) * analizador->contadores_hilo *
+               analizador->cant_hilos);
+    for (i = 0; i < analizador->cant_clases; i++) {
+        clase = analizador->clases + i;
+        clase->bytes_subida = 0;
+        clase->bytes_bajada = 0;
+        clase->paquetes_subida = 0;
+        clase->paquetes_bajada = 0;
+    }
+}
+
+/**
+ * iniciar_cache(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Crea una cache de flujos vacia para cada hilo. Cada hilo solo accede a su
+ *  propia cache, por lo que no es necesaria la sincronizacion.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int iniciar_cache(struct s_analizador* analizador)
+{
+    int hilos = MAX_HILOS;
+    struct cache_flujos *caches = calloc(hilos, sizeof(struct cache_flujos));
+    if (caches == NULL) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para la cache de flujos de %d hilos",
+               hilos);
+        return -1;
+    }
+    free(analizador->caches);
+    analizador->caches = caches;
+    analizador->cant_caches = hilos;
+    /* las entradas vacias tienen generacion cero */
+    if (analizador->generacion == 0)
+        analizador->generacion = 1;
+    return 0;
+}
+
+/**
+ * invalidar_cache(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Cambia la generacion de las clases para que ninguna entrada de la cache
+ *  sea valida. No recorre las caches.
+ */
+void invalidar_cache(struct s_analizador* analizador)
+{
+    analizador->generacion++;
+    /* la generacion cero es la de las entradas vacias */
+    if (analizador->generacion == 0)
+        analizador->generacion = 1;
+}
+
+/**
+ * estadisticas_cache(s_analizador, aciertos, fallos)
+ * --------------------------------------------------------------------------
+ *  Suma los aciertos y fallos de la cache de flujos de todos los hilos.
+ */
+void estadisticas_cache(const struct s_analizador* analizador,
+                        u_int64_t *aciertos,
+                        u_int64_t *fallos)
+{
+    int i;
+    *aciertos = 0;
+    *fallos = 0;
+    for (i = 0; i < analizador->cant_caches; i++) {
+        *aciertos += analizador->caches[i].aciertos;
+        *fallos += analizador->caches[i].fallos;
+    }
 }
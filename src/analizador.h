@@ -17,12 +17,76 @@
 
 #define PUNTOS_COINCIDENCIA_PUERTO 5
 #define LEN_ISO8601 32
+#define TAMANIO_LOTE 10000 /* cantidad de paquetes que se obtienen de la base
+                            * de datos por lote si no se configura otra.
+                            */
+
+#define BLOQUE_LOTE 16 /* paquetes cuyas claves se calculan y anticipan
+                         * juntas en analizar_lote().
+                         */
+
+#define LINEA_CACHE 64 /* tamaño de una linea de cache en bytes */
+#define TAMANIO_CACHE 4096 /* cantidad de flujos de la cache de cada hilo.
+                            * Debe ser potencia de dos.
+                            */
+
+struct indice; /* indice compilado de clases de trafico (ver indice.h) */
+struct vector_subredes; /* subredes de una clase (ver subredes.h) */
+struct lote_columnas; /* lote de paquetes por columnas (ver columnas.h) */
+struct metricas; /* metricas de la ejecucion (ver metricas.h) */
 
 /*
  * ESTRUCTURAS
  * ===========================================================================
  */
 
+/*
+ * struct contador
+ * ---------------------------------------------------------------------------
+ * Contador de bytes de una clase de trafico de un hilo de analisis. Cada hilo
+ * suma en sus propios contadores y al terminar el analisis se suman a las
+ * clases (ver reducir_contadores).
+ */
+struct contador {
+    u_int64_t bytes_subida;
+    u_int64_t bytes_bajada;
+    u_int64_t paquetes_subida;
+    u_int64_t paquetes_bajada;
+};
+
+/*
+ * struct entrada_cache
+ * ---------------------------------------------------------------------------
+ * Flujo clasificado de la cache de flujos. Guarda los campos del paquete que
+ * determinan su clase y la posicion de la clase elegida.
+ *
+ * La entrada es valida solo si su generacion es igual a la del analizador.
+ * Las entradas vacias tienen generacion cero.
+ */
+struct entrada_cache {
+    u_int32_t ip_origen;
+    u_int32_t ip_destino;
+    u_int16_t puerto_origen;
+    u_int16_t puerto_destino;
+    int protocolo;
+    int direccion;
+    u_int32_t generacion;
+    int clase; /* posicion de la clase en el array de clases */
+};
+
+/*
+ * struct cache_flujos
+ * ---------------------------------------------------------------------------
+ * Cache de flujos clasificados de un hilo de analisis. Es de mapeo directo:
+ * cada flujo tiene una sola posicion posible y un flujo nuevo reemplaza al
+ * que la ocupaba.
+ */
+struct cache_flujos {
+    u_int64_t aciertos; /* paquetes clasificados con la cache */
+    u_int64_t fallos; /* paquetes que se compararon con las clases */
+    struct entrada_cache entradas[TAMANIO_CACHE];
+};
+
 /*
  * struct s_analizador
  * ---------------------------------------------------------------------------
@@ -37,10 +101,51 @@ struct s_analizador {
     /* inicio y fin del intervalo en formato ISO8601*/
     char inicio[LEN_ISO8601];
     char fin[LEN_ISO8601];
+    /* cantidad de paquetes que se obtienen de la base de datos por lote. Si
+     * es cero se usa TAMANIO_LOTE. */
+    int tamanio_lote;
+    /* si es distinto de cero, la base de datos agrupa los paquetes por
+     * flujo (ips, puertos, protocolo y direccion) y se analiza cada flujo
+     * una sola vez. */
+    int agrupar;
+    /* si es distinto de cero, los paquetes se obtienen de la base de datos
+     * con COPY binario en lugar de un cursor (ver fuente_copia). */
+    int copia;
+    /* si es distinto de cero, el intervalo ISO8601 no incluye el inicio. Se
+     * usa en el modo demonio, donde el inicio es la hora de captura del
+     * ultimo paquete analizado. */
+    int incremental;
     /* cantidad de clases de clases de trafico. */
     int cant_clases;
     /* array de clases de trafico. */
     struct clase* clases;
+    /* indice compilado de las clases de trafico. Si es NULL se compara el
+     * paquete con todas las clases. */
+    struct indice* indice;
+    /* contadores de bytes por hilo y por clase. Si es NULL los bytes se suman
+     * directamente a las clases. */
+    struct contador* contadores;
+    /* cantidad de hilos que tienen contadores. */
+    int cant_hilos;
+    /* cantidad de contadores de cada hilo (mayor o igual a cant_clases). */
+    int contadores_hilo;
+    /* memoria reservada para los contadores. */
+    void* memoria_contadores;
+    /* cache de flujos de cada hilo. Si es NULL cada paquete se compara con
+     * las clases. */
+    struct cache_flujos* caches;
+    /* cantidad de hilos que tienen cache de flujos. */
+    int cant_caches;
+    /* generacion de las clases de trafico. Cambia cada vez que se compilan
+     * las clases e invalida las entradas de la cache. */
+    u_int32_t generacion;
+    /* subredes outside e inside de cada clase en vectores (posiciones 2 * i
+     * y 2 * i + 1). Si no es NULL, la comparacion con todas las clases
+     * compara varias subredes por instruccion. */
+    struct vector_subredes** vectores;
+    /* tiempo por etapa, paquetes por hilo y comparaciones por clase. Si es
+     * NULL no se miden. */
+    struct metricas* metricas;
 };
 
 /*
@@ -51,10 +156,38 @@ struct s_analizador {
 /*
  * prefijo
  * ---------------------------------------------------------------------------
- *  Obtiene la cantidad de bits de la mascara de subred pasada por parametro.
+ *  Obtiene la cantidad de bits de la mascara de subred pasada por parametro,
+ *  o -1 si los bits de la mascara no son contiguos. Se usa al cargar las
+ *  subredes para completar subred->prefijo.
  */
 int prefijo(u_int32_t mascara);
 
+/**
+ * ip_grupo(paquete, grupo)
+ * ---------------------------------------------------------------------------
+ *  Devuelve la direccion ip del paquete que se compara con las subredes del
+ *  grupo (outside o inside) segun la direccion del paquete.
+ */
+struct in_addr ip_grupo(const struct paquete *paquete, int grupo);
+
+/**
+ * puerto_grupo(paquete, grupo)
+ * ---------------------------------------------------------------------------
+ *  Devuelve el puerto del paquete que se compara con los puertos del grupo
+ *  (outside o inside) segun la direccion del paquete.
+ */
+int puerto_grupo(const struct paquete *paquete, int grupo);
+
+/**
+ * coincide_subred(paquete, subredes, cantidad, grupo)
+ * ---------------------------------------------------------------------------
+ *  Compara la ip del paquete del grupo pasado por parametro con un array de
+ *  subredes. Devuelve el prefijo guardado de la subred mas especifica que
+ *  contiene a la ip, 1 si el array esta vacio o 0 si ninguna la contiene.
+ */
+int coincide_subred(const struct paquete *paquete,
+                    const struct subred *subredes, int cantidad, int grupo);
+
 /**
  * coincide(clase, paquete)
  * ---------------------------------------------------------------------------
@@ -78,17 +211,206 @@ int imprimir(const struct s_analizador *analizador);
  */
 int clases_to_file(FILE* file, const struct s_analizador*);
 
+/**
+ * clasificar_paquete(s_analizador, paquete)
+ * --------------------------------------------------------------------------
+ *  Busca la clase de trafico con mejor coincidencia con el paquete sin sumar
+ *  sus bytes. No usa la cache de flujos.
+ *
+ *  Devuelve la posicion de la clase en el array de clases o 0 (la clase por
+ *  defecto) si el paquete no coincide con ninguna.
+ */
+int clasificar_paquete(const struct s_analizador*, const struct paquete*);
+
 /**
  * analizar_paquete(s_analizador, paquete)
  * --------------------------------------------------------------------------
  *  Compara un paquete con las clases de trafico instaladas. En caso que no
  *  coincida con ninuna, se agrega a la clase por defecto.
  *
+ *  Si el analizador tiene cache de flujos y el flujo del paquete ya fue
+ *  clasificado, se usa la clase de la cache sin comparar con las clases.
+ *
  *  Devuelve 1 en caso que haya coincidencia con alguna clase de trafico, 0 en
  *  caso de que se haya agregado el paquete a la clase por defecto.
  */
 int analizar_paquete(const struct s_analizador*, const struct paquete*);
 
+/**
+ * analizar_lote(s_analizador, paquetes, cantidad, clases)
+ * --------------------------------------------------------------------------
+ *  Analiza un array de paquetes con el mismo resultado que llamar a
+ *  analizar_paquete() con cada uno, pero sin una llamada por paquete y
+ *  anticipando la lectura de la cache de flujos y del indice.
+ *
+ *  Si *clases* no es NULL, se almacena en clases[i] la posicion de la clase
+ *  del paquete *i* en el array de clases, por ejemplo para contabilizar los
+ *  bytes por flujo ademas de por clase.
+ *
+ *  Se ejecuta en el hilo actual; para analizar en paralelo cada hilo debe
+ *  analizar una parte distinta del array.
+ *
+ *  Devuelve la cantidad de paquetes que coincidieron con alguna clase de
+ *  trafico.
+ */
+int analizar_lote(const struct s_analizador*,
+                  const struct paquete* paquetes,
+                  int cantidad,
+                  int *clases);
+
+/**
+ * analizar_columnas(s_analizador, lote, inicio, cantidad, clases)
+ * --------------------------------------------------------------------------
+ *  Igual que analizar_lote() con los paquetes de un lote por columnas (ver
+ *  columnas.h). Se analizan *cantidad* paquetes desde la posicion *inicio*
+ *  del lote y clases[i] corresponde al paquete inicio + i.
+ *
+ *  Devuelve la cantidad de paquetes que coincidieron con alguna clase de
+ *  trafico.
+ */
+int analizar_columnas(const struct s_analizador*,
+                      const struct lote_columnas* lote,
+                      int inicio,
+                      int cantidad,
+                      int *clases);
+
+/**
+ * compilar_clases(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Compila las clases de trafico del analizador en un indice para evitar
+ *  comparar cada paquete con todas las clases. Se debe llamar luego de
+ *  obtener las clases.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int compilar_clases(struct s_analizador*);
+
+/**
+ * vectorizar_clases(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Copia las subredes de las clases en vectores para compararlas con
+ *  instrucciones SIMD (ver subredes.h) cuando no hay indice compilado. Se
+ *  debe volver a llamar si se modifican las subredes de las clases.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int vectorizar_clases(struct s_analizador*);
+
+/**
+ * free_vectores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Libera los vectores de subredes creados por vectorizar_clases(). Se debe
+ *  llamar antes de cambiar la cantidad de clases del analizador, ya que los
+ *  vectores se recorren con esa cantidad.
+ */
+void free_vectores(struct s_analizador*);
+
+/**
+ * iniciar_contadores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Crea contadores de bytes por clase para cada hilo de analisis para que los
+ *  hilos no compitan por los contadores de las clases. Luego de analizar los
+ *  paquetes se debe llamar a reducir_contadores().
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int iniciar_contadores(struct s_analizador*);
+
+/**
+ * reducir_contadores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Suma los contadores de todos los hilos a las clases de trafico y los
+ *  vuelve a cero.
+ */
+void reducir_contadores(struct s_analizador*);
+
+/**
+ * descartar_contadores(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Descarta los bytes y paquetes contados desde la ultima vez que se
+ *  imprimieron las clases, en los contadores de los hilos y en las clases,
+ *  por ejemplo si no se pudieron obtener todos los paquetes de un intervalo.
+ */
+void descartar_contadores(struct s_analizador*);
+
+/**
+ * iniciar_cache(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Crea una cache de flujos clasificados para cada hilo de analisis. Los
+ *  paquetes de un mismo flujo (ips, puertos, protocolo y direccion) siempre
+ *  pertenecen a la misma clase, por lo que se clasifican una sola vez.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int iniciar_cache(struct s_analizador*);
+
+/**
+ * invalidar_cache(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Invalida todos los flujos de la cache. Se llama desde compilar_clases(),
+ *  y se debe llamar si se modifican las clases sin volver a compilarlas.
+ */
+void invalidar_cache(struct s_analizador*);
+
+/**
+ * estadisticas_cache(s_analizador, aciertos, fallos)
+ * --------------------------------------------------------------------------
+ *  Obtiene la suma de aciertos y fallos de la cache de flujos de todos los
+ *  hilos.
+ */
+void estadisticas_cache(const struct s_analizador*,
+                        u_int64_t *aciertos,
+                        u_int64_t *fallos);
+
+/**
+ * free_analizador(s_analizador)
+ * --------------------------------------------------------------------------
+ *  Libera la memoria ocupada por las estructuras compiladas del analizador.
+ */
+void free_analizador(struct s_analizador*);
+
+/**
+ * reemplazar_clases(s_analizador, clases, cant_clases, indice)
+ * --------------------------------------------------------------------------
+ *  Reemplaza las clases de trafico del analizador y su indice compilado. Los
+ *  contadores por hilo y los vectores de subredes se vuelven a crear para la
+ *  nueva cantidad de clases y la cache de flujos se invalida. Las clases y
+ *  el indice anteriores no se liberan.
+ *
+ *  Solo se debe llamar cuando ningun hilo analiza paquetes y con los
+ *  contadores ya reducidos.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible. En ese caso
+ *  el analizador no se modifica.
+ */
+int reemplazar_clases(struct s_analizador*, struct clase *clases,
+                      int cant_clases, struct indice *indice);
+
+/**
+ * crear_clases(cant_clases, cant_subredes, cant_puertos, subredes, puertos)
+ * --------------------------------------------------------------------------
+ *  Reserva en un solo bloque un array de *cant_clases* clases en cero, con
+ *  lugar a continuacion para *cant_subredes* subredes y *cant_puertos*
+ *  puertos. En *subredes* y *puertos* se almacena el inicio de cada parte,
+ *  que se reparte entre los arrays de las clases. Las subredes y los puertos
+ *  de todas las clases quedan contiguos y al clasificar se recorren en orden.
+ *
+ *  Las clases se liberan con free_clases().
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct clase* crear_clases(int cant_clases, int cant_subredes,
+                           int cant_puertos, struct subred **subredes,
+                           struct puerto **puertos);
+
+/**
+ * free_clases
+ * --------------------------------------------------------------------------
+ *  Libera las clases creadas con crear_clases() junto con sus subredes y
+ *  puertos.
+ */
+void free_clases(struct clase *clases);
+
 /*
  * MACROS
  * ===========================================================================
@@ -4,6 +4,10 @@
 #include "paquete.h"
 #include "analizador.h"
 
+struct fuente; /* fuente de paquetes (ver fuente.h) */
+
+#define MAX_PARTICIONES 64 /* conexiones de particiones como maximo */
+
 /**
  * bd_conectar()
  * -------------------------------------------------------------------------
@@ -11,6 +15,19 @@
  */
 int bd_conectar();
 
+/**
+ * bd_conectar_particiones(cantidad)
+ * -------------------------------------------------------------------------
+ * Abre *cantidad* conexiones mas con la base de datos (como maximo
+ * MAX_PARTICIONES). Si se abren al menos dos, obtener_paquetes() divide el
+ * intervalo en una particion por conexion y las obtiene en paralelo. La
+ * conexion principal sigue siendo la actual. bd_desconectar() tambien las
+ * cierra.
+ *
+ * Devuelve la cantidad de conexiones abiertas.
+ */
+int bd_conectar_particiones(int cantidad);
+
 /**
  * bd_desconectar()
  * -------------------------------------------------------------------------
@@ -18,6 +35,17 @@ int bd_conectar();
  */
 void bd_desconectar();
 
+/**
+ * bd_reconectar()
+ * -------------------------------------------------------------------------
+ * Prepara las conexiones para reintentar luego de un error: descarta la
+ * transaccion en curso y, si se perdio alguna conexion, vuelve a abrir la
+ * principal y las de las particiones.
+ *
+ * Devuelve 0 si la conexion principal esta abierta, -1 en caso contrario.
+ */
+int bd_reconectar();
+
 /**
  * bd_commit()
  * -------------------------------------------------------------------------
@@ -30,57 +58,97 @@ void bd_commit();
  * -------------------------------------------------------------------------
  * Obtiene los paquetes capturados segun configuracion pasada por parametro y
  * llama a la funcion callback pasada por parametro. Devuelve la cantidad de
- * paquetes analizados
+ * paquetes analizados, o -1 si no se obtuvieron todos los paquetes del
+ * intervalo. En ese caso los contadores tienen solo parte de los paquetes y
+ * se deben descartar (ver descartar_contadores).
+ *
+ * Los paquetes se obtienen de a lotes de analizador->tamanio_lote filas, por
+ * lo que la memoria usada no depende de la cantidad de paquetes capturados.
+ * Si analizador->copia es distinto de cero se obtienen con fuente_copia(),
+ * caso contrario con fuente_bd(). Si se abrieron conexiones de particiones
+ * (ver bd_conectar_particiones) cada particion se obtiene con
+ * fuente_particion() y se analizan en paralelo con analizar_particiones().
  */
 int obtener_paquetes(struct s_analizador* analizador,
                      int (*callback)(const struct s_analizador*,
                                      const struct paquete*));
 
 /**
- * obtener_clases(**clases, *cfg)
- * ---------------------------------------------------------------------------
- *  Obtiene el array de clases de trafico que se utilizara en el analisis.
- *  Devuelve la cantidad de clases que contiene el array
+ * fuente_bd
+ * -------------------------------------------------------------------------
+ * Crea una fuente de paquetes (ver fuente.h) con los paquetes capturados en
+ * el intervalo del analizador. Al abrir la fuente se abre un cursor que se
+ * lee de a lotes de analizador->tamanio_lote filas.
  *
- *  ### Parametros:
- *    * clases: Puntero a un array donde se almacenaran las clases
- *    * cfg: Puntero a la configuracion del analizador que contiene los
- *           parametros por los cuales se seleccionaran las clases.
+ * Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
  */
-int obtener_clases(struct s_analizador*);
+int fuente_bd(struct fuente *fuente);
 
 /**
- * init_clase
- * --------------------------------------------------------------------------
- *  Inicializa una estructura de clase de trafico a valores por defecto
+ * fuente_copia
+ * -------------------------------------------------------------------------
+ * Crea una fuente de paquetes con los mismos paquetes que fuente_bd(), que
+ * se obtienen con COPY ... TO STDOUT WITH (FORMAT binary) en la conexion de
+ * ECPG. Las filas llegan en formato binario y se decodifican con
+ * decodificar_copia() (ver copia.h), sin convertir cada columna de texto a
+ * numero como el cursor.
+ *
+ * Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
  */
-#define init_clase(x) memset(x, 0, sizeof(struct clase));
+int fuente_copia(struct fuente *fuente);
 
 /**
- * free_clase
- * --------------------------------------------------------------------------
- *  Libera memoria ocupada por una clase de trafico
+ * fuente_particion
+ * -------------------------------------------------------------------------
+ * Crea una fuente igual a fuente_copia() con los paquetes de la parte
+ * *particion* del intervalo dividido en *cantidad* partes de igual duracion,
+ * que se obtienen en la conexion de esa particion.
+ *
+ * Devuelve 0 en caso de exito, -1 si la conexion de la particion no existe o
+ * no hay memoria disponible.
  */
-void free_clase(struct clase *clase);
+int fuente_particion(struct fuente *fuente, int particion, int cantidad);
 
 /**
- * obtener_subredes(*clase)
- * ---------------------------------------------------------------------------
- *  Obtiene el array de subredes que componen la clase de trafico.
- *  Devuelve la cantidad de subredes que contiene el array
+ * avanzar_marca
+ * -------------------------------------------------------------------------
+ * Establece el intervalo del siguiente tick del modo demonio. El inicio es el
+ * fin del tick anterior (o la hora de captura del ultimo paquete si es el
+ * primero) y el fin es la hora de captura del ultimo paquete capturado.
  *
- *  El grupo puede ser 'a' o 'b'
+ * Devuelve 1 si hay paquetes nuevos en el intervalo, 0 en caso contrario o
+ * -1 si fallo la consulta.
  */
-int obtener_subredes(struct clase*, char grupo);
+int avanzar_marca(struct s_analizador* analizador);
 
 /**
- * obtener_puertos(*clase)
+ * obtener_clases(**clases, *cfg)
  * ---------------------------------------------------------------------------
- *  Obtiene el array de puertos que componen la clase de trafico.
- *  Devuelve la cantidad de puertos que contiene el array
+ *  Obtiene el array de clases de trafico que se utilizara en el analisis.
+ *  Devuelve la cantidad de clases que contiene el array, o -1 si fallo
+ *  alguna consulta o no hay memoria disponible.
  *
- *  El grupo puede ser 'a' o 'b'
+ *  ### Parametros:
+ *    * clases: Puntero a un array donde se almacenaran las clases
+ *    * cfg: Puntero a la configuracion del analizador que contiene los
+ *           parametros por los cuales se seleccionaran las clases.
  */
-int obtener_puertos(struct clase* clase, char grupo);
+int obtener_clases(struct s_analizador*);
+
+/**
+ * obtener_firma_clases()
+ * ---------------------------------------------------------------------------
+ *  Obtiene una firma de las clases de trafico activas que cambia cada vez que
+ *  se modifica alguna clase, subred o puerto. Devuelve cero si fallo la
+ *  consulta.
+ */
+u_int64_t obtener_firma_clases();
+
+/**
+ * init_clase
+ * --------------------------------------------------------------------------
+ *  Inicializa una estructura de clase de trafico a valores por defecto
+ */
+#define init_clase(x) memset(x, 0, sizeof(struct clase));
 
 #endif /* DB_H */
@@ -0,0 +1,572 @@
+#define _POSIX_C_SOURCE 200809L /* mmap, posix_madvise, strdup, opendir */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include "captura.h"
+#include "vivo.h"
+#include "fuente.h"
+
+/* numeros magicos de los formatos de captura */
+#define MAGIA_PCAP 0xa1b2c3d4 /* pcap con marcas de tiempo en microsegundos */
+#define MAGIA_PCAP_NS 0xa1b23c4d /* pcap con tiempos en nanosegundos */
+#define MAGIA_PCAPNG 0x0a0d0d0a /* tipo del bloque de cabecera de seccion */
+#define MAGIA_ORDEN_PCAPNG 0x1a2b3c4d /* orden de bytes de la seccion */
+
+/* tamaños de las cabeceras de los formatos */
+#define CABECERA_PCAP 24
+#define REGISTRO_PCAP 16
+
+/* bloques de pcapng */
+#define BLOQUE_INTERFAZ 1
+#define BLOQUE_PAQUETE_OBSOLETO 2
+#define BLOQUE_PAQUETE_SIMPLE 3
+#define BLOQUE_PAQUETE_EXTENDIDO 6
+
+/* tipos de protocolo de red */
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_VLAN 0x8100
+#define ETHERTYPE_QINQ 0x88a8
+
+#define MAX_INTERFACES 64 /* interfaces por seccion de pcapng */
+
+/*
+ * struct archivo_captura
+ * ---------------------------------------------------------------------------
+ * Archivo de captura mapeado en memoria y posicion de lectura.
+ */
+struct archivo_captura {
+    const u_int8_t *datos;
+    size_t tamanio;
+    size_t posicion;
+    int pcapng; /* si es cero el formato es pcap */
+    int invertido; /* el archivo tiene el orden de bytes opuesto al host */
+    int enlace; /* tipo de enlace de pcap */
+    int cant_interfaces; /* interfaces de la seccion actual de pcapng */
+    int enlaces[MAX_INTERFACES]; /* tipo de enlace de cada interfaz */
+};
+
+/*
+ * leer16 / leer32
+ * ---------------------------------------------------------------------------
+ *  Leen un entero sin alinear en el orden de bytes del host, invirtiendolo si
+ *  el archivo tiene el orden opuesto.
+ */
+static u_int16_t leer16(const u_int8_t *p, int invertido)
+{
+    u_int16_t v;
+    memcpy(&v, p, sizeof(v));
+    return invertido ? (u_int16_t) ((v >> 8) | (v << 8)) : v;
+}
+
+static u_int32_t leer32(const u_int8_t *p, int invertido)
+{
+    u_int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return invertido ? __builtin_bswap32(v) : v;
+}
+
+/* leen un entero en orden de red */
+#define RED16(p) ((u_int16_t) (((p)[0] << 8) | (p)[1]))
+
+/**
+ * decodificar_paquete(trama, largo, enlace, lan, paquete)
+ * ---------------------------------------------------------------------------
+ *  Salta la cabecera de enlace (incluidas las etiquetas VLAN) y decodifica
+ *  las cabeceras IPv4 y TCP/UDP.
+ *
+ *  Devuelve 0 en caso de exito, -1 si la trama se descarta.
+ */
+int decodificar_paquete(const u_int8_t *trama, u_int32_t largo, int enlace,
+                        const struct subred *lan, struct paquete *paquete)
+{
+    const u_int8_t *ip, *transporte;
+    u_int32_t inicio = 0, largo_ip, largo_cabecera;
+    u_int16_t tipo = ETHERTYPE_IPV4;
+    int origen_lan, destino_lan;
+
+    /* cabecera de enlace */
+    switch (enlace) {
+        case ENLACE_ETHERNET:
+            if (largo < 14)
+                return -1;
+            tipo = RED16(trama + 12);
+            inicio = 14;
+            while ((tipo == ETHERTYPE_VLAN || tipo == ETHERTYPE_QINQ) &&
+                   largo >= inicio + 4) {
+                tipo = RED16(trama + inicio + 2);
+                inicio += 4;
+            }
+            break;
+        case ENLACE_LINUX_SLL:
+            if (largo < 16)
+                return -1;
+            tipo = RED16(trama + 14);
+            inicio = 16;
+            break;
+        case ENLACE_LINUX_SLL2:
+            if (largo < 20)
+                return -1;
+            tipo = RED16(trama);
+            inicio = 20;
+            break;
+        case ENLACE_NULL:
+            inicio = 4;
+            break;
+        case ENLACE_RAW:
+        case ENLACE_RAW_BSD:
+        case ENLACE_RAW_OPENBSD:
+            break;
+        default:
+            return -1;
+    }
+    if (tipo != ETHERTYPE_IPV4 || largo < inicio + 20)
+        return -1;
+
+    /* cabecera IPv4 */
+    ip = trama + inicio;
+    largo_cabecera = (ip[0] & 0x0f) * 4;
+    if ((ip[0] >> 4) != 4 || largo_cabecera < 20 ||
+            largo < inicio + largo_cabecera)
+        return -1;
+    largo_ip = RED16(ip + 2);
+    memcpy(&(paquete->ip_origen.s_addr), ip + 12, 4);
+    memcpy(&(paquete->ip_destino.s_addr), ip + 16, 4);
+    paquete->protocolo = ip[9];
+    paquete->bytes = largo_ip;
+    paquete->cantidad = 1;
+    paquete->puerto_origen = 0;
+    paquete->puerto_destino = 0;
+
+    /* puertos, salvo en los fragmentos que no son el primero */
+    transporte = ip + largo_cabecera;
+    if ((paquete->protocolo == IPPROTO_TCP ||
+         paquete->protocolo == IPPROTO_UDP) &&
+        (RED16(ip + 6) & 0x1fff) == 0 &&
+        largo >= inicio + largo_cabecera + 4) {
+        paquete->puerto_origen = RED16(transporte);
+        paquete->puerto_destino = RED16(transporte + 2);
+    }
+
+    /* direccion segun la red local */
+    origen_lan = en_subred(paquete->ip_origen, lan);
+    destino_lan = en_subred(paquete->ip_destino, lan);
+    if (origen_lan == destino_lan)
+        return -1;
+    paquete->direccion = origen_lan ? SALIENTE : ENTRANTE;
+    return 0;
+}
+
+/*
+ * abrir_archivo
+ * ---------------------------------------------------------------------------
+ *  Mapea el archivo en memoria y reconoce su formato. Devuelve -1 si no se
+ *  puede leer o no es un archivo pcap ni pcapng.
+ */
+static int abrir_archivo(struct archivo_captura *archivo, const char *ruta)
+{
+    struct stat st;
+    u_int32_t magia;
+    void *datos;
+    int fd;
+
+    memset(archivo, 0, sizeof(struct archivo_captura));
+    fd = open(ruta, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || st.st_size < CABECERA_PCAP) {
+        close(fd);
+        return -1;
+    }
+    datos = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datos == MAP_FAILED)
+        return -1;
+    /* el archivo se lee una sola vez de principio a fin */
+    posix_madvise(datos, st.st_size, POSIX_MADV_SEQUENTIAL);
+    archivo->datos = datos;
+    archivo->tamanio = st.st_size;
+
+    magia = leer32(archivo->datos, 0);
+    if (magia == MAGIA_PCAP || magia == MAGIA_PCAP_NS ||
+        __builtin_bswap32(magia) == MAGIA_PCAP ||
+        __builtin_bswap32(magia) == MAGIA_PCAP_NS) {
+        archivo->invertido = magia != MAGIA_PCAP && magia != MAGIA_PCAP_NS;
+        archivo->enlace = leer32(archivo->datos + 20, archivo->invertido) &
+                          0xffff;
+        archivo->posicion = CABECERA_PCAP;
+        return 0;
+    }
+    if (magia == MAGIA_PCAPNG) {
+        /* las secciones se leen al recorrer los bloques */
+        archivo->pcapng = 1;
+        archivo->posicion = 0;
+        return 0;
+    }
+    munmap((void *) archivo->datos, archivo->tamanio);
+    return -1;
+}
+
+/*
+ * cerrar_archivo
+ * ---------------------------------------------------------------------------
+ *  Desmapea el archivo de captura.
+ */
+static void cerrar_archivo(struct archivo_captura *archivo)
+{
+    munmap((void *) archivo->datos, archivo->tamanio);
+    archivo->datos = NULL;
+}
+
+/*
+ * siguiente_trama
+ * ---------------------------------------------------------------------------
+ *  Obtiene la siguiente trama del archivo sin copiarla y el segundo en que
+ *  se capturo. Los paquetes simples de pcapng no tienen marca de tiempo, por
+ *  lo que *segundos* no se modifica. En pcapng se asume la resolucion por
+ *  defecto de microsegundos.
+ *
+ *  Devuelve 1 si se obtuvo una trama, 0 al llegar al final del archivo o si
+ *  el resto del archivo esta truncado o tiene un bloque de largo invalido.
+ */
+static int siguiente_trama(struct archivo_captura *archivo,
+                           const u_int8_t **trama, u_int32_t *largo,
+                           int *enlace, time_t *segundos)
+{
+    const u_int8_t *bloque;
+    u_int32_t tipo, largo_bloque, interfaz;
+    size_t resto;
+
+    if (!archivo->pcapng) {
+        resto = archivo->tamanio - archivo->posicion;
+        if (resto < REGISTRO_PCAP)
+            return 0;
+        bloque = archivo->datos + archivo->posicion;
+        *largo = leer32(bloque + 8, archivo->invertido);
+        if (*largo > resto - REGISTRO_PCAP)
+            return 0;
+        *trama = bloque + REGISTRO_PCAP;
+        *enlace = archivo->enlace;
+        *segundos = leer32(bloque, archivo->invertido);
+        archivo->posicion += REGISTRO_PCAP + *largo;
+        return 1;
+    }
+
+    /* pcapng: salteo los bloques que no contienen paquetes */
+    while (archivo->tamanio - archivo->posicion >= 12) {
+        bloque = archivo->datos + archivo->posicion;
+        resto = archivo->tamanio - archivo->posicion;
+        tipo = leer32(bloque, archivo->invertido);
+        if (tipo == MAGIA_PCAPNG) {
+            /* nueva seccion: puede cambiar el orden de bytes */
+            archivo->invertido =
+                leer32(bloque + 8, 0) != MAGIA_ORDEN_PCAPNG;
+            archivo->cant_interfaces = 0;
+        }
+        largo_bloque = leer32(bloque + 4, archivo->invertido);
+        /* el largo de los bloques es multiplo de 4, si no lo es el
+         * archivo esta corrupto y el siguiente bloque no se puede ubicar */
+        if (largo_bloque < 12 || largo_bloque > resto || largo_bloque % 4)
+            return 0;
+        archivo->posicion += largo_bloque;
+        switch (tipo) {
+            case BLOQUE_INTERFAZ:
+                if (archivo->cant_interfaces < MAX_INTERFACES &&
+                        largo_bloque >= 16)
+                    archivo->enlaces[archivo->cant_interfaces++] =
+                        leer16(bloque + 8, archivo->invertido);
+                break;
+            case BLOQUE_PAQUETE_EXTENDIDO:
+            case BLOQUE_PAQUETE_OBSOLETO:
+                if (largo_bloque < 32)
+                    break;
+                interfaz = tipo == BLOQUE_PAQUETE_EXTENDIDO ?
+                           leer32(bloque + 8, archivo->invertido) :
+                           leer16(bloque + 8, archivo->invertido);
+                *largo = leer32(bloque + 20, archivo->invertido);
+                if (interfaz >= (u_int32_t) archivo->cant_interfaces ||
+                        *largo > largo_bloque - 32)
+                    break;
+                *trama = bloque + 28;
+                *enlace = archivo->enlaces[interfaz];
+                *segundos = (((u_int64_t) leer32(bloque + 12,
+                                                 archivo->invertido) << 32) |
+                             leer32(bloque + 16, archivo->invertido)) /
+                            1000000;
+                return 1;
+            case BLOQUE_PAQUETE_SIMPLE:
+                if (largo_bloque < 16 || archivo->cant_interfaces == 0)
+                    break;
+                *largo = leer32(bloque + 8, archivo->invertido);
+                if (*largo > largo_bloque - 16)
+                    *largo = largo_bloque - 16;
+                *trama = bloque + 12;
+                *enlace = archivo->enlaces[0];
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * comparar_nombres
+ * ---------------------------------------------------------------------------
+ *  Compara dos nombres de archivo para ordenarlos alfabeticamente.
+ */
+static int comparar_nombres(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/*
+ * listar_archivos
+ * ---------------------------------------------------------------------------
+ *  Obtiene las rutas de los archivos a leer: la ruta pasada por parametro si
+ *  no es un directorio, o los archivos del directorio en orden alfabetico,
+ *  como los que genera la rotacion de capturas. Las rutas se deben liberar
+ *  con free().
+ *
+ *  Devuelve la cantidad de rutas o -1 si no se pudo leer el directorio.
+ */
+static int listar_archivos(const char *ruta, char ***archivos)
+{
+    struct stat st;
+    struct dirent *entrada;
+    DIR *dir;
+    char **nombres = NULL, *archivo;
+    int cant_nombres = 0, capacidad = 0;
+
+    if (stat(ruta, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        nombres = malloc(sizeof(char *));
+        if (nombres == NULL || (nombres[0] = strdup(ruta)) == NULL) {
+            syslog(LOG_ERR, "No hay memoria disponible para leer %s", ruta);
+            exit(EXIT_FAILURE);
+        }
+        *archivos = nombres;
+        return 1;
+    }
+    dir = opendir(ruta);
+    if (dir == NULL)
+        return -1;
+    while ((entrada = readdir(dir)) != NULL) {
+        if (entrada->d_name[0] == '.')
+            continue;
+        if (cant_nombres == capacidad) {
+            capacidad = capacidad ? capacidad * 2 : 16;
+            nombres = realloc(nombres, sizeof(char *) * capacidad);
+        }
+        archivo = nombres == NULL ? NULL :
+                  malloc(strlen(ruta) + strlen(entrada->d_name) + 2);
+        if (archivo == NULL) {
+            syslog(LOG_ERR, "No hay memoria disponible para listar %s",
+                   ruta);
+            exit(EXIT_FAILURE);
+        }
+        sprintf(archivo, "%s/%s", ruta, entrada->d_name);
+        nombres[cant_nombres++] = archivo;
+    }
+    closedir(dir);
+    qsort(nombres, cant_nombres, sizeof(char *), comparar_nombres);
+    *archivos = nombres;
+    return cant_nombres;
+}
+
+/*
+ * struct datos_captura
+ * ---------------------------------------------------------------------------
+ * Estado de la fuente de paquetes de archivos de captura.
+ */
+struct datos_captura {
+    char *ruta; /* archivo o directorio */
+    const struct subred *lan;
+    char **archivos; /* rutas de los archivos a leer */
+    int cant_archivos;
+    int siguiente; /* siguiente archivo a abrir */
+    int abierto; /* si es distinto de cero *archivo* esta abierto */
+    struct archivo_captura archivo;
+};
+
+/*
+ * abrir_siguiente
+ * ---------------------------------------------------------------------------
+ *  Abre el siguiente archivo que se pueda leer. Devuelve 0 si no quedan
+ *  archivos.
+ */
+static int abrir_siguiente(struct datos_captura *datos)
+{
+    while (datos->siguiente < datos->cant_archivos) {
+        datos->abierto = abrir_archivo(&(datos->archivo),
+                                       datos->archivos[datos->siguiente]) == 0;
+        if (!datos->abierto)
+            syslog(LOG_WARNING, "No se pudo leer la captura %s",
+                   datos->archivos[datos->siguiente]);
+        datos->siguiente++;
+        if (datos->abierto)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * abrir_captura
+ * ---------------------------------------------------------------------------
+ *  Lista los archivos y abre el primero. Devuelve -1 si ningun archivo puede
+ *  leerse.
+ */
+static int abrir_captura(struct fuente *fuente,
+                         const struct s_analizador *analizador)
+{
+    struct datos_captura *datos = fuente->datos;
+    (void) analizador;
+    datos->cant_archivos = listar_archivos(datos->ruta, &(datos->archivos));
+    if (datos->cant_archivos < 0)
+        return -1;
+    return abrir_siguiente(datos) ? 0 : -1;
+}
+
+/*
+ * siguiente_lote_captura
+ * ---------------------------------------------------------------------------
+ *  Decodifica las tramas de los archivos en el lote hasta llenarlo. Las
+ *  tramas que no se pueden decodificar se descartan.
+ */
+static int siguiente_lote_captura(struct fuente *fuente,
+                                  struct paquete *lote, int tamanio)
+{
+    struct datos_captura *datos = fuente->datos;
+    const u_int8_t *trama;
+    u_int32_t largo;
+    time_t segundos;
+    int enlace, cantidad = 0;
+
+    while (cantidad < tamanio && datos->abierto) {
+        if (!siguiente_trama(&(datos->archivo), &trama, &largo, &enlace,
+                             &segundos)) {
+            cerrar_archivo(&(datos->archivo));
+            datos->abierto = 0;
+            abrir_siguiente(datos);
+            continue;
+        }
+        if (decodificar_paquete(trama, largo, enlace, datos->lan,
+                                lote + cantidad) == 0)
+            cantidad++;
+    }
+    return cantidad;
+}
+
+/*
+ * cerrar_captura
+ * ---------------------------------------------------------------------------
+ *  Cierra el archivo abierto y libera el estado de la fuente.
+ */
+static void cerrar_captura(struct fuente *fuente)
+{
+    struct datos_captura *datos = fuente->datos;
+    int i;
+    if (datos->abierto)
+        cerrar_archivo(&(datos->archivo));
+    for (i = 0; i < datos->cant_archivos; i++)
+        free(datos->archivos[i]);
+    free(datos->archivos);
+    free(datos->ruta);
+    free(datos);
+    fuente->datos = NULL;
+}
+
+/**
+ * fuente_captura(fuente, ruta, lan)
+ * ---------------------------------------------------------------------------
+ *  Crea una fuente con los paquetes de un archivo de captura o de todos los
+ *  archivos de un directorio.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int fuente_captura(struct fuente *fuente, const char *ruta,
+                   const struct subred *lan)
+{
+    struct datos_captura *datos = calloc(1, sizeof(struct datos_captura));
+    if (datos == NULL)
+        return -1;
+    datos->ruta = strdup(ruta);
+    if (datos->ruta == NULL) {
+        free(datos);
+        return -1;
+    }
+    datos->lan = lan;
+    fuente->abrir = abrir_captura;
+    fuente->siguiente_lote = siguiente_lote_captura;
+    fuente->siguiente_columnas = NULL;
+    fuente->cerrar = cerrar_captura;
+    fuente->datos = datos;
+    return 0;
+}
+
+/**
+ * analizar_captura(s_analizador, ruta, lan, callback)
+ * ---------------------------------------------------------------------------
+ *  Analiza un archivo de captura o todos los archivos de un directorio con
+ *  analizar_fuente().
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si ningun archivo pudo
+ *  leerse.
+ */
+int analizar_captura(struct s_analizador *analizador, const char *ruta,
+                     const struct subred *lan,
+                     int (*callback)(const struct s_analizador*,
+                                     const struct paquete*))
+{
+    struct fuente fuente;
+    if (fuente_captura(&fuente, ruta, lan) < 0) {
+        syslog(LOG_ERR, "No hay memoria disponible para leer %s", ruta);
+        return -1;
+    }
+    return analizar_fuente(analizador, &fuente, callback);
+}
+
+/**
+ * reproducir_captura(vivo, ruta)
+ * ---------------------------------------------------------------------------
+ *  Agrega las tramas de los archivos con su marca de tiempo y cierra el
+ *  ultimo intervalo.
+ *
+ *  Devuelve la cantidad de tramas leidas o -1 si ningun archivo pudo leerse.
+ */
+int reproducir_captura(struct vivo *vivo, const char *ruta)
+{
+    struct archivo_captura archivo;
+    const u_int8_t *trama;
+    u_int32_t largo;
+    time_t segundos = 0;
+    char **archivos;
+    int cant_archivos, enlace, i, total = -1;
+
+    cant_archivos = listar_archivos(ruta, &archivos);
+    if (cant_archivos < 0)
+        return -1;
+    for (i = 0; i < cant_archivos; i++) {
+        if (abrir_archivo(&archivo, archivos[i]) < 0) {
+            syslog(LOG_WARNING, "No se pudo leer la captura %s",
+                   archivos[i]);
+        } else {
+            if (total < 0)
+                total = 0;
+            while (siguiente_trama(&archivo, &trama, &largo, &enlace,
+                                   &segundos)) {
+                agregar_trama(vivo, segundos, trama, largo, enlace);
+                total++;
+            }
+            cerrar_archivo(&archivo);
+        }
+        free(archivos[i]);
+    }
+    free(archivos);
+    if (total > 0)
+        cerrar_intervalo(vivo);
+    return total;
+}
@@ -0,0 +1,95 @@
+/**
+ * captura.h
+ * ==========================================================================
+ * Este modulo obtiene los paquetes de archivos de captura en formato pcap o
+ * pcapng en lugar de la base de datos, para analizar capturas historicas sin
+ * cargarlas en PostgreSQL.
+ *
+ * Los archivos se mapean en memoria y se recorren sin copiar las tramas. De
+ * cada trama se decodifican las cabeceras IPv4 y TCP/UDP en un struct
+ * paquete. La direccion del paquete se obtiene de la red local: los paquetes
+ * con origen en la red local son salientes y los que tienen destino en la
+ * red local son entrantes. El resto (trafico interno o ajeno a la red local)
+ * se descarta.
+ */
+#ifndef CAPTURA_H
+#define CAPTURA_H
+
+#include <sys/types.h>
+#include "analizador.h"
+
+struct vivo; /* estado del analisis por intervalos (ver vivo.h) */
+struct fuente; /* fuente de paquetes (ver fuente.h) */
+
+/* tipos de enlace soportados (ver http://www.tcpdump.org/linktypes.html) */
+#define ENLACE_NULL 0 /* loopback de BSD */
+#define ENLACE_ETHERNET 1
+#define ENLACE_RAW_BSD 12 /* IP sin cabecera de enlace (DLT_RAW) */
+#define ENLACE_RAW_OPENBSD 14
+#define ENLACE_RAW 101
+#define ENLACE_LINUX_SLL 113 /* captura de Linux en cualquier interfaz */
+#define ENLACE_LINUX_SLL2 276
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * decodificar_paquete(trama, largo, enlace, lan, paquete)
+ * ---------------------------------------------------------------------------
+ *  Decodifica una trama capturada del tipo de enlace pasado por parametro.
+ *  Los bytes del paquete son el largo total del datagrama IP. Los paquetes
+ *  que no son TCP ni UDP, o que son fragmentos sin cabecera de transporte,
+ *  tienen los puertos en cero.
+ *
+ *  Devuelve 0 en caso de exito, -1 si la trama no es IPv4, esta truncada o
+ *  ninguna o ambas direcciones pertenecen a la red local *lan*.
+ */
+int decodificar_paquete(const u_int8_t *trama, u_int32_t largo, int enlace,
+                        const struct subred *lan, struct paquete *paquete);
+
+/**
+ * fuente_captura(fuente, ruta, lan)
+ * ---------------------------------------------------------------------------
+ *  Crea una fuente de paquetes (ver fuente.h) con las tramas del archivo de
+ *  captura pcap o pcapng, o de todos los archivos del directorio en orden
+ *  alfabetico. Las tramas que no se pueden decodificar se descartan. Al
+ *  abrir la fuente falla si ningun archivo puede leerse.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int fuente_captura(struct fuente *fuente, const char *ruta,
+                   const struct subred *lan);
+
+/**
+ * analizar_captura(s_analizador, ruta, lan, callback)
+ * ---------------------------------------------------------------------------
+ *  Analiza los paquetes del archivo de captura pcap o pcapng pasado por
+ *  parametro. Si la ruta es un directorio se analizan todos sus archivos en
+ *  orden alfabetico, como los que genera la rotacion de capturas.
+ *
+ *  Los paquetes se obtienen con fuente_captura() y se analizan en paralelo
+ *  con analizar_fuente().
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si ningun archivo pudo
+ *  leerse.
+ */
+int analizar_captura(struct s_analizador *analizador, const char *ruta,
+                     const struct subred *lan,
+                     int (*callback)(const struct s_analizador*,
+                                     const struct paquete*));
+
+/**
+ * reproducir_captura(vivo, ruta)
+ * ---------------------------------------------------------------------------
+ *  Reproduce el archivo de captura, o los archivos del directorio, como si
+ *  sus tramas se capturaran en vivo: cada trama se agrega con su marca de
+ *  tiempo (ver agregar_trama) y los totales se escriben al final de cada
+ *  intervalo de la captura. Al terminar se cierra el ultimo intervalo.
+ *
+ *  Devuelve la cantidad de tramas leidas o -1 si ningun archivo pudo leerse.
+ */
+int reproducir_captura(struct vivo *vivo, const char *ruta);
+
+#endif /* CAPTURA_H */
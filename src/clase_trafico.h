@@ -16,10 +16,11 @@
  * ===========================================================================
  */
 #define LONG_NOMBRE 32 /* Longitud maxima del nombre de clase de trafico */
-#define LONG_DESCRIPCION 160 /* Longitud maxima de la descripcion de trafico.
+#define LONG_DESCRIPCION 136 /* Longitud maxima de la descripcion de trafico.
                               * Se modifica esta cantidad para que el tamaño de
                               * la estructura de clase de trafico sea potencia
-                              * de dos.
+                              * de dos: con los contadores de 64 bits y
+                              * punteros de 64 bits ocupa 256 bytes.
                               */
 #define MASCARA_HOST htonl(0xffffffff) /* Mascara de subred para hosts con
                                          * todos los bits en uno.
@@ -51,6 +52,10 @@ struct subred {
                          * cero)
                          */
     u_int32_t mascara; /* Mascara de subred en formato hexadecimal */
+    int prefijo; /* Cantidad de bits de la mascara. Es el puntaje de la
+                  * coincidencia con la subred y se calcula una sola vez al
+                  * cargarla (ver prefijo()).
+                  */
 };
 
 /**
@@ -72,10 +77,12 @@ struct puerto {
  *
  * ### Bytes de subida y de bajada
  * Posee 2 campos que son la sumatoria de bytes separados en trafico de subida
- * y bajada. Entiendase como paquete de subida todo aquel paquete con dirección
- * INBOUND (ver paquete.h), es decir que tiene origen en la LAN y como destino
- * una dirección en Internet. El paquete de bajada por el contrario tiene
- * origen en una dirección de Internet y como destino un equipo en la LAN.
+ * y bajada, y otros 2 con la cantidad de paquetes de cada direccion. Son de 64
+ * bits porque el trafico de una clase en un intervalo puede superar los 2GB.
+ * Entiendase como paquete de subida todo aquel paquete con dirección INBOUND
+ * (ver paquete.h), es decir que tiene origen en la LAN y como destino una
+ * dirección en Internet. El paquete de bajada por el contrario tiene origen
+ * en una dirección de Internet y como destino un equipo en la LAN.
  *
  * ### Grupos outside e inside
  * Las subredes y puertos se dividen en ´outside´ e ´inside.´ Estos la
@@ -86,12 +93,18 @@ struct puerto {
  */
 struct clase {
     int id; /* Identificador de la clase.*/
-    int bytes_subida; /* Sumatoria de bytes de paquetes que aplican a esta
-                       * clase con direccion OUTBOUND
-                       */
-    int bytes_bajada; /* Sumatoria de bytes de paquetes que aplican a esta
-                       * clase con direccion INBOUND
-                       */
+    u_int64_t bytes_subida; /* Sumatoria de bytes de paquetes que aplican a
+                             * esta clase con direccion OUTBOUND
+                             */
+    u_int64_t bytes_bajada; /* Sumatoria de bytes de paquetes que aplican a
+                             * esta clase con direccion INBOUND
+                             */
+    u_int64_t paquetes_subida; /* Cantidad de paquetes que aplican a esta
+                                * clase con direccion OUTBOUND
+                                */
+    u_int64_t paquetes_bajada; /* Cantidad de paquetes que aplican a esta
+                                * clase con direccion INBOUND
+                                */
     int cant_puertos_outside; /* Cantidad de puertos que tiene el grupo
                                * outside.
                                */
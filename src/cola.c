@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cola.h"
+
+/**
+ * crear_cola(cola, capacidad)
+ * ---------------------------------------------------------------------------
+ *  La posicion i empieza libre para la vuelta que encola el dato i.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int crear_cola(struct cola *cola, int capacidad)
+{
+    size_t tamanio = 2, i;
+    while (tamanio < (size_t) capacidad)
+        tamanio *= 2;
+    memset(cola, 0, sizeof(struct cola));
+    cola->celdas = malloc(sizeof(struct celda_cola) * tamanio);
+    if (cola->celdas == NULL)
+        return -1;
+    for (i = 0; i < tamanio; i++) {
+        cola->celdas[i].secuencia = i;
+        cola->celdas[i].dato = NULL;
+    }
+    cola->mascara = tamanio - 1;
+    return 0;
+}
+
+/**
+ * encolar(cola, dato)
+ * ---------------------------------------------------------------------------
+ *  Reserva la posicion del siguiente encolado si esta libre en esta vuelta,
+ *  guarda el dato y lo publica con la secuencia del desencolado que lo
+ *  espera.
+ *
+ *  Devuelve 0 en caso de exito, -1 si la cola esta llena.
+ */
+int encolar(struct cola *cola, void *dato)
+{
+    struct celda_cola *celda;
+    size_t posicion, secuencia;
+    posicion = __atomic_load_n(&(cola->encolados), __ATOMIC_RELAXED);
+    while (1) {
+        celda = cola->celdas + (posicion & cola->mascara);
+        secuencia = __atomic_load_n(&(celda->secuencia), __ATOMIC_ACQUIRE);
+        if (secuencia == posicion) {
+            /* si otro hilo reservo la posicion se reintenta con la nueva */
+            if (__atomic_compare_exchange_n(&(cola->encolados), &posicion,
+                                            posicion + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        } else if (secuencia < posicion) {
+            /* la posicion tiene un dato de la vuelta anterior */
+            return -1;
+        } else {
+            posicion = __atomic_load_n(&(cola->encolados), __ATOMIC_RELAXED);
+        }
+    }
+    celda->dato = dato;
+    __atomic_store_n(&(celda->secuencia), posicion + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * desencolar(cola)
+ * ---------------------------------------------------------------------------
+ *  Reserva la posicion del siguiente desencolado si ya tiene su dato, lo
+ *  toma y libera la posicion para la siguiente vuelta.
+ *
+ *  Devuelve el dato o NULL si la cola esta vacia.
+ */
+void* desencolar(struct cola *cola)
+{
+    struct celda_cola *celda;
+    size_t posicion, secuencia;
+    void *dato;
+    posicion = __atomic_load_n(&(cola->desencolados), __ATOMIC_RELAXED);
+    while (1) {
+        celda = cola->celdas + (posicion & cola->mascara);
+        secuencia = __atomic_load_n(&(celda->secuencia), __ATOMIC_ACQUIRE);
+        if (secuencia == posicion + 1) {
+            if (__atomic_compare_exchange_n(&(cola->desencolados), &posicion,
+                                            posicion + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        } else if (secuencia < posicion + 1) {
+            /* todavia no se encolo el dato de esta posicion */
+            return NULL;
+        } else {
+            posicion = __atomic_load_n(&(cola->desencolados),
+                                       __ATOMIC_RELAXED);
+        }
+    }
+    dato = celda->dato;
+    __atomic_store_n(&(celda->secuencia), posicion + cola->mascara + 1,
+                     __ATOMIC_RELEASE);
+    return dato;
+}
+
+/**
+ * free_cola(cola)
+ * ---------------------------------------------------------------------------
+ *  Libera el buffer de la cola.
+ */
+void free_cola(struct cola *cola)
+{
+    free(cola->celdas);
+    cola->celdas = NULL;
+}
@@ -0,0 +1,90 @@
+/**
+ * cola.h
+ * ==========================================================================
+ * Este modulo implementa una cola acotada de punteros sin bloqueos, que
+ * varios hilos pueden usar a la vez para encolar y desencolar.
+ *
+ * Cada posicion del buffer circular tiene un numero de secuencia que indica
+ * si esta libre para encolar en la vuelta actual o si tiene un dato para
+ * desencolar. Los hilos reservan una posicion con una comparacion e
+ * intercambio atomico del contador de encolados o desencolados y luego
+ * publican el dato o la posicion libre actualizando la secuencia, por lo que
+ * ningun hilo espera a que otro libere un bloqueo.
+ */
+#ifndef COLA_H
+#define COLA_H
+
+#include <stddef.h>
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct celda_cola
+ * ---------------------------------------------------------------------------
+ * Posicion del buffer circular.
+ */
+struct celda_cola {
+    size_t secuencia; /* vuelta en la que la posicion se encola o desencola */
+    void *dato;
+};
+
+/**
+ * struct cola
+ * ---------------------------------------------------------------------------
+ * Cola acotada. Los contadores estan en lineas de cache distintas para que
+ * los hilos que encolan no invaliden la linea de los que desencolan.
+ */
+struct cola {
+    struct celda_cola *celdas;
+    size_t mascara; /* capacidad - 1, la capacidad es potencia de dos */
+    char relleno1[64];
+    size_t encolados; /* cantidad de datos encolados desde el inicio */
+    char relleno2[64];
+    size_t desencolados; /* cantidad de datos desencolados desde el inicio */
+    char relleno3[64];
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_cola(cola, capacidad)
+ * ---------------------------------------------------------------------------
+ *  Inicia una cola vacia con lugar para al menos *capacidad* datos. La
+ *  capacidad se redondea a la siguiente potencia de dos.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int crear_cola(struct cola *cola, int capacidad);
+
+/**
+ * encolar(cola, dato)
+ * ---------------------------------------------------------------------------
+ *  Agrega el dato al final de la cola.
+ *
+ *  Devuelve 0 en caso de exito, -1 si la cola esta llena.
+ */
+int encolar(struct cola *cola, void *dato);
+
+/**
+ * desencolar(cola)
+ * ---------------------------------------------------------------------------
+ *  Quita el primer dato de la cola.
+ *
+ *  Devuelve el dato o NULL si la cola esta vacia.
+ */
+void* desencolar(struct cola *cola);
+
+/**
+ * free_cola(cola)
+ * ---------------------------------------------------------------------------
+ *  Libera el buffer de la cola. Los datos no se liberan.
+ */
+void free_cola(struct cola *cola);
+
+#endif /* COLA_H */
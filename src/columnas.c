@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include "columnas.h"
+
+/**
+ * crear_lote_columnas(capacidad)
+ * ---------------------------------------------------------------------------
+ *  Reserva cada columna por separado. Se reserva al menos un paquete aunque
+ *  la capacidad sea cero.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct lote_columnas* crear_lote_columnas(int capacidad)
+{
+    struct lote_columnas *lote;
+    size_t n = capacidad > 0 ? capacidad : 1;
+    lote = calloc(1, sizeof(struct lote_columnas));
+    if (lote == NULL)
+        return NULL;
+    lote->capacidad = capacidad;
+    lote->ip_origen = malloc(sizeof(u_int32_t) * n);
+    lote->ip_destino = malloc(sizeof(u_int32_t) * n);
+    lote->puerto_origen = malloc(sizeof(u_int16_t) * n);
+    lote->puerto_destino = malloc(sizeof(u_int16_t) * n);
+    lote->bytes = malloc(sizeof(u_int64_t) * n);
+    lote->protocolo = malloc(sizeof(u_int8_t) * n);
+    lote->direccion = malloc(sizeof(u_int8_t) * n);
+    lote->cantidad = malloc(sizeof(u_int32_t) * n);
+    if (lote->ip_origen == NULL || lote->ip_destino == NULL ||
+            lote->puerto_origen == NULL || lote->puerto_destino == NULL ||
+            lote->bytes == NULL || lote->protocolo == NULL ||
+            lote->direccion == NULL || lote->cantidad == NULL) {
+        free_lote_columnas(lote);
+        return NULL;
+    }
+    return lote;
+}
+
+/**
+ * free_lote_columnas(lote)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por el lote.
+ */
+void free_lote_columnas(struct lote_columnas *lote)
+{
+    if (lote == NULL)
+        return;
+    free(lote->ip_origen);
+    free(lote->ip_destino);
+    free(lote->puerto_origen);
+    free(lote->puerto_destino);
+    free(lote->bytes);
+    free(lote->protocolo);
+    free(lote->direccion);
+    free(lote->cantidad);
+    free(lote);
+}
+
+/**
+ * columna_orden_red(direcciones, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Las direcciones son independientes entre si, por lo que el ciclo se
+ *  vectoriza.
+ */
+void columna_orden_red(u_int32_t *direcciones, int cantidad)
+{
+    int i;
+    #pragma omp simd
+    for (i = 0; i < cantidad; i++)
+        direcciones[i] = htonl(direcciones[i]);
+}
+
+/**
+ * columnas_a_paquetes(lote, inicio, cantidad, paquetes)
+ * ---------------------------------------------------------------------------
+ *  Copia *cantidad* paquetes del lote desde la posicion *inicio* en el array
+ *  de paquetes.
+ */
+void columnas_a_paquetes(const struct lote_columnas *lote, int inicio,
+                         int cantidad, struct paquete *paquetes)
+{
+    int i;
+    for (i = 0; i < cantidad; i++) {
+        paquetes[i].ip_origen.s_addr = lote->ip_origen[inicio + i];
+        paquetes[i].ip_destino.s_addr = lote->ip_destino[inicio + i];
+        paquetes[i].puerto_origen = lote->puerto_origen[inicio + i];
+        paquetes[i].puerto_destino = lote->puerto_destino[inicio + i];
+        paquetes[i].bytes = lote->bytes[inicio + i];
+        paquetes[i].protocolo = lote->protocolo[inicio + i];
+        paquetes[i].direccion = lote->direccion[inicio + i];
+        paquetes[i].cantidad = lote->cantidad[inicio + i];
+    }
+}
+
+/**
+ * paquetes_a_columnas(paquetes, cantidad, lote)
+ * ---------------------------------------------------------------------------
+ *  Reemplaza los paquetes del lote por los del array pasado por parametro.
+ *
+ *  Devuelve la cantidad de paquetes copiados.
+ */
+int paquetes_a_columnas(const struct paquete *paquetes, int cantidad,
+                        struct lote_columnas *lote)
+{
+    int i;
+    if (cantidad > lote->capacidad)
+        cantidad = lote->capacidad;
+    for (i = 0; i < cantidad; i++) {
+        lote->ip_origen[i] = paquetes[i].ip_origen.s_addr;
+        lote->ip_destino[i] = paquetes[i].ip_destino.s_addr;
+        lote->puerto_origen[i] = paquetes[i].puerto_origen;
+        lote->puerto_destino[i] = paquetes[i].puerto_destino;
+        lote->bytes[i] = paquetes[i].bytes;
+        lote->protocolo[i] = paquetes[i].protocolo;
+        lote->direccion[i] = paquetes[i].direccion;
+        lote->cantidad[i] = paquetes[i].cantidad;
+    }
+    lote->filas = cantidad;
+    return cantidad;
+}
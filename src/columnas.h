@@ -0,0 +1,95 @@
+/**
+ * columnas.h
+ * ==========================================================================
+ * Este modulo guarda lotes de paquetes por columnas: cada campo de struct
+ * paquete se guarda en un array contiguo con un elemento por paquete.
+ *
+ * Las fuentes que obtienen los paquetes por columnas (por ejemplo la base de
+ * datos, que devuelve un array por cada columna de la consulta) convierten
+ * cada columna completa de una vez, como el orden de bytes de las
+ * direcciones ip, en lugar de convertir paquete por paquete. El analisis
+ * recorre las columnas que necesita en cada paso, por lo que calcular las
+ * claves de la cache de flujos no lee los bytes ni la direccion de los
+ * paquetes.
+ */
+#ifndef COLUMNAS_H
+#define COLUMNAS_H
+
+#include <sys/types.h>
+#include "paquete.h"
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct lote_columnas
+ * ---------------------------------------------------------------------------
+ * Lote de paquetes por columnas. Cada columna tiene lugar para *capacidad*
+ * paquetes y las direcciones ip estan en orden de red, igual que en struct
+ * paquete.
+ */
+struct lote_columnas {
+    int capacidad; /* cantidad de paquetes que entran en el lote */
+    int filas; /* cantidad de paquetes del lote */
+    u_int32_t *ip_origen;
+    u_int32_t *ip_destino;
+    u_int16_t *puerto_origen;
+    u_int16_t *puerto_destino;
+    u_int64_t *bytes;
+    u_int8_t *protocolo;
+    u_int8_t *direccion; /* ENTRANTE o SALIENTE */
+    u_int32_t *cantidad; /* cantidad de paquetes de cada flujo */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_lote_columnas(capacidad)
+ * ---------------------------------------------------------------------------
+ *  Crea un lote vacio con lugar para *capacidad* paquetes.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct lote_columnas* crear_lote_columnas(int capacidad);
+
+/**
+ * free_lote_columnas(lote)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por el lote.
+ */
+void free_lote_columnas(struct lote_columnas *lote);
+
+/**
+ * columna_orden_red(direcciones, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Convierte una columna de direcciones ip del orden del host al orden de
+ *  red. El compilador convierte varias direcciones por instruccion.
+ */
+void columna_orden_red(u_int32_t *direcciones, int cantidad);
+
+/**
+ * columnas_a_paquetes(lote, inicio, cantidad, paquetes)
+ * ---------------------------------------------------------------------------
+ *  Copia *cantidad* paquetes del lote desde la posicion *inicio* en el array
+ *  de paquetes.
+ */
+void columnas_a_paquetes(const struct lote_columnas *lote, int inicio,
+                         int cantidad, struct paquete *paquetes);
+
+/**
+ * paquetes_a_columnas(paquetes, cantidad, lote)
+ * ---------------------------------------------------------------------------
+ *  Reemplaza los paquetes del lote por los del array pasado por parametro.
+ *
+ *  Devuelve la cantidad de paquetes copiados, que no supera la capacidad del
+ *  lote.
+ */
+int paquetes_a_columnas(const struct paquete *paquetes, int cantidad,
+                        struct lote_columnas *lote);
+
+#endif /* COLUMNAS_H */
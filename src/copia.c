@@ -0,0 +1,95 @@
+#include <string.h>
+#include <arpa/inet.h>
+#include "copia.h"
+
+/* firma de los primeros 11 bytes de la cabecera */
+static const char firma_copia[11] = "PGCOPY\n\377\r\n";
+
+/* bit de las opciones de la cabecera que indica que las filas tienen oid */
+#define COPIA_CON_OID (1 << 16)
+
+/*
+ * entero_copia
+ * ---------------------------------------------------------------------------
+ *  Lee un entero con signo de *largo* bytes en orden de red.
+ */
+static u_int64_t entero_copia(const unsigned char *campo, int largo)
+{
+    u_int64_t valor = 0;
+    int i;
+    for (i = 0; i < largo; i++)
+        valor = valor << 8 | campo[i];
+    /* extiendo el signo de los enteros de menos de 8 bytes */
+    if (largo < 8 && (campo[0] & 0x80))
+        valor |= ~(u_int64_t) 0 << (8 * largo);
+    return valor;
+}
+
+/**
+ * decodificar_copia(lector, datos, largo, lote)
+ * ---------------------------------------------------------------------------
+ *  Recorre las filas comprobando que cada largo entre en los datos antes de
+ *  leerlo, por lo que los datos invalidos nunca se leen fuera del buffer.
+ *
+ *  Devuelve la cantidad de filas agregadas o -1 en caso de error.
+ */
+int decodificar_copia(struct lector_copia *lector, const char *datos,
+                      int largo, struct lote_columnas *lote)
+{
+    const unsigned char *p = (const unsigned char *) datos;
+    const unsigned char *fin = p + largo;
+    u_int64_t valores[COPIA_CAMPOS];
+    int32_t largo_campo, extension;
+    int16_t campos;
+    int filas = 0, fila, i;
+
+    if (!lector->cabecera) {
+        if (largo < COPIA_CABECERA ||
+                memcmp(p, firma_copia, sizeof(firma_copia)) != 0 ||
+                (entero_copia(p + 11, 4) & COPIA_CON_OID))
+            return -1;
+        extension = (int32_t) entero_copia(p + 15, 4);
+        if (extension < 0 || extension > largo - COPIA_CABECERA)
+            return -1;
+        p += COPIA_CABECERA + extension;
+        lector->cabecera = 1;
+    }
+    while (p < fin) {
+        if (lector->terminado || fin - p < 2)
+            return -1;
+        campos = (int16_t) entero_copia(p, 2);
+        p += 2;
+        if (campos == -1) {
+            lector->terminado = 1;
+            continue;
+        }
+        if (campos != COPIA_CAMPOS || lote->filas >= lote->capacidad)
+            return -1;
+        for (i = 0; i < COPIA_CAMPOS; i++) {
+            if (fin - p < 4)
+                return -1;
+            largo_campo = (int32_t) entero_copia(p, 4);
+            p += 4;
+            if (largo_campo == -1) {
+                valores[i] = 0;
+                continue;
+            }
+            if ((largo_campo != 2 && largo_campo != 4 && largo_campo != 8) ||
+                    fin - p < largo_campo)
+                return -1;
+            valores[i] = entero_copia(p, largo_campo);
+            p += largo_campo;
+        }
+        fila = lote->filas++;
+        lote->ip_origen[fila] = htonl((u_int32_t) valores[0]);
+        lote->ip_destino[fila] = htonl((u_int32_t) valores[1]);
+        lote->puerto_origen[fila] = valores[2];
+        lote->puerto_destino[fila] = valores[3];
+        lote->protocolo[fila] = valores[4];
+        lote->bytes[fila] = valores[5];
+        lote->direccion[fila] = valores[6];
+        lote->cantidad[fila] = valores[7];
+        filas++;
+    }
+    return filas;
+}
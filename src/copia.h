@@ -0,0 +1,61 @@
+/**
+ * copia.h
+ * ==========================================================================
+ * Este modulo decodifica las filas de paquetes que la base de datos envia
+ * con COPY ... TO STDOUT WITH (FORMAT binary).
+ *
+ * En el formato binario cada fila tiene la cantidad de campos y cada campo
+ * su largo seguido del valor entero en orden de red, por lo que los paquetes
+ * se copian en las columnas de un lote (ver columnas.h) sin convertir texto
+ * a numeros. El flujo empieza con una cabecera y termina con una fila de -1
+ * campos.
+ *
+ * Las filas tienen los campos de la consulta de paquetes en el mismo orden
+ * que el cursor de la base de datos: ip origen, ip destino, puerto origen,
+ * puerto destino, protocolo, bytes, direccion y cantidad de paquetes. Cada
+ * campo puede ser de 2, 4 u 8 bytes (smallint, int o bigint).
+ */
+#ifndef COPIA_H
+#define COPIA_H
+
+#include "columnas.h"
+
+#define COPIA_CAMPOS 8 /* campos de cada fila de paquetes */
+#define COPIA_CABECERA 19 /* largo de la cabecera sin la extension */
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct lector_copia
+ * ---------------------------------------------------------------------------
+ * Estado de la decodificacion de un flujo de COPY binario.
+ */
+struct lector_copia {
+    int cabecera; /* si es distinto de cero ya se leyo la cabecera */
+    int terminado; /* si es distinto de cero ya se leyo la fila final */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * decodificar_copia(lector, datos, largo, lote)
+ * ---------------------------------------------------------------------------
+ *  Agrega al final del lote las filas completas de *datos*. Si el lector no
+ *  leyo la cabecera, *datos* debe empezar con ella. libpq entrega una fila
+ *  por llamada a PQgetCopyData(), pero se aceptan varias filas juntas.
+ *
+ *  Los campos NULL se guardan como cero.
+ *
+ *  Devuelve la cantidad de filas agregadas, o -1 si los datos no tienen el
+ *  formato esperado o las filas no entran en el lote.
+ */
+int decodificar_copia(struct lector_copia *lector, const char *datos,
+                      int largo, struct lote_columnas *lote);
+
+#endif /* COPIA_H */
@@ -0,0 +1,554 @@
+#define _POSIX_C_SOURCE 199309L /* nanosleep */
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sched.h>
+#include <time.h>
+#include <omp.h>
+#include "fuente.h"
+#include "columnas.h"
+#include "cola.h"
+#include "metricas.h"
+
+#define PAQUETES_TAREA 256 /* paquetes que analiza cada tarea con
+                            * analizar_lote() */
+#define LOTES_HILO 2 /* lotes en vuelo por hilo en la canalizacion */
+#define VUELTAS_ESPERA 64 /* sched_yield() antes de dormir sin lotes */
+#define ESPERA_MAXIMA 10 /* dormir como maximo 2^10 microsegundos */
+
+/*
+ * struct memoria
+ * ---------------------------------------------------------------------------
+ * Estado de la fuente de paquetes en memoria.
+ */
+struct memoria {
+    const struct paquete *paquetes;
+    int cantidad;
+    int posicion; /* siguiente paquete a entregar */
+};
+
+/*
+ * sin_memoria
+ * ---------------------------------------------------------------------------
+ *  Informa que no hay memoria para los lotes.
+ */
+static void sin_memoria(int tamanio)
+{
+    syslog(LOG_ERR, "No hay memoria disponible para lotes de %d paquetes",
+           tamanio);
+}
+
+/*
+ * obtener_lote
+ * ---------------------------------------------------------------------------
+ *  Obtiene el siguiente lote de la fuente y, si el analizador tiene
+ *  metricas, suma el tiempo y las filas obtenidas.
+ */
+static int obtener_lote(struct s_analizador *analizador,
+                        struct fuente *fuente, struct paquete *lote,
+                        int tamanio)
+{
+    u_int64_t reloj = iniciar_etapa(analizador->metricas);
+    int cantidad = fuente->siguiente_lote(fuente, lote, tamanio);
+    terminar_etapa(analizador->metricas, ETAPA_OBTENCION, reloj);
+    contar_obtenidos(analizador->metricas, cantidad > 0 ? cantidad : 0, 0);
+    return cantidad;
+}
+
+/*
+ * obtener_columnas
+ * ---------------------------------------------------------------------------
+ *  Igual que obtener_lote() con un lote por columnas.
+ */
+static int obtener_columnas(struct s_analizador *analizador,
+                            struct fuente *fuente,
+                            struct lote_columnas *lote)
+{
+    u_int64_t reloj = iniciar_etapa(analizador->metricas);
+    int cantidad = fuente->siguiente_columnas(fuente, lote);
+    terminar_etapa(analizador->metricas, ETAPA_OBTENCION, reloj);
+    contar_obtenidos(analizador->metricas, cantidad > 0 ? cantidad : 0, 0);
+    return cantidad;
+}
+
+/*
+ * analizar_paquetes
+ * ---------------------------------------------------------------------------
+ *  Analiza en paralelo los paquetes de un lote. Se llama desde una region
+ *  single, por lo que los paquetes se reparten en tareas entre los hilos
+ *  libres.
+ *
+ *  Si la funcion es analizar_paquete(), cada tarea analiza PAQUETES_TAREA
+ *  paquetes con analizar_lote(), que da el mismo resultado sin una llamada
+ *  por paquete.
+ */
+static void analizar_paquetes(struct s_analizador *analizador,
+                              int (*callback)(const struct s_analizador*,
+                                              const struct paquete*),
+                              const struct paquete *lote, int cantidad)
+{
+    int i;
+    if (callback == analizar_paquete) {
+        #pragma omp taskloop
+        for (i = 0; i < cantidad; i += PAQUETES_TAREA)
+            analizar_lote(analizador, lote + i,
+                          cantidad - i < PAQUETES_TAREA ?
+                          cantidad - i : PAQUETES_TAREA,
+                          NULL);
+        return;
+    }
+    #pragma omp taskloop
+    for (i = 0; i < cantidad; i++)
+        callback(analizador, lote + i);
+}
+
+/*
+ * analizar_columnas_paralelo
+ * ---------------------------------------------------------------------------
+ *  Igual que analizar_paquetes() con un lote por columnas y
+ *  analizar_columnas().
+ */
+static void analizar_columnas_paralelo(struct s_analizador *analizador,
+                                       const struct lote_columnas *lote)
+{
+    int i;
+    #pragma omp taskloop
+    for (i = 0; i < lote->filas; i += PAQUETES_TAREA)
+        analizar_columnas(analizador, lote, i,
+                          lote->filas - i < PAQUETES_TAREA ?
+                          lote->filas - i : PAQUETES_TAREA,
+                          NULL);
+}
+
+/*
+ * leer_filas
+ * ---------------------------------------------------------------------------
+ *  Obtiene y analiza los lotes de struct paquete de una fuente abierta.
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si no hay memoria
+ *  disponible o si la fuente no pudo obtener algun lote.
+ */
+static int leer_filas(struct s_analizador *analizador, struct fuente *fuente,
+                      int (*callback)(const struct s_analizador*,
+                                      const struct paquete*),
+                      int tamanio)
+{
+    struct paquete *buffers[2]; /* buffers de lotes */
+    int cantidad, siguiente = 0, actual = 0, total = 0;
+
+    buffers[0] = malloc(sizeof(struct paquete) * tamanio);
+    buffers[1] = malloc(sizeof(struct paquete) * tamanio);
+    if (buffers[0] == NULL || buffers[1] == NULL) {
+        free(buffers[0]);
+        free(buffers[1]);
+        sin_memoria(tamanio);
+        return -1;
+    }
+
+    cantidad = obtener_lote(analizador, fuente, buffers[actual], tamanio);
+    #pragma omp parallel
+    #pragma omp single
+    while (cantidad > 0) {
+        #pragma omp task shared(siguiente)
+        siguiente = obtener_lote(analizador, fuente, buffers[1 - actual],
+                                 tamanio);
+        analizar_paquetes(analizador, callback, buffers[actual], cantidad);
+        #pragma omp taskwait
+        total += cantidad;
+        cantidad = siguiente;
+        actual = 1 - actual;
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+    /* el ultimo lote es negativo si la fuente fallo */
+    return cantidad < 0 ? -1 : total;
+}
+
+/*
+ * leer_columnas
+ * ---------------------------------------------------------------------------
+ *  Igual que leer_filas() con lotes por columnas analizados con
+ *  analizar_columnas().
+ */
+static int leer_columnas(struct s_analizador *analizador,
+                         struct fuente *fuente, int tamanio)
+{
+    struct lote_columnas *buffers[2]; /* buffers de lotes */
+    int cantidad, siguiente = 0, actual = 0, total = 0;
+
+    buffers[0] = crear_lote_columnas(tamanio);
+    buffers[1] = crear_lote_columnas(tamanio);
+    if (buffers[0] == NULL || buffers[1] == NULL) {
+        free_lote_columnas(buffers[0]);
+        free_lote_columnas(buffers[1]);
+        sin_memoria(tamanio);
+        return -1;
+    }
+
+    cantidad = obtener_columnas(analizador, fuente, buffers[actual]);
+    #pragma omp parallel
+    #pragma omp single
+    while (cantidad > 0) {
+        #pragma omp task shared(siguiente)
+        siguiente = obtener_columnas(analizador, fuente,
+                                     buffers[1 - actual]);
+        analizar_columnas_paralelo(analizador, buffers[actual]);
+        #pragma omp taskwait
+        total += cantidad;
+        cantidad = siguiente;
+        actual = 1 - actual;
+    }
+
+    free_lote_columnas(buffers[0]);
+    free_lote_columnas(buffers[1]);
+    return cantidad < 0 ? -1 : total;
+}
+
+/*
+ * esperar_lote
+ * ---------------------------------------------------------------------------
+ *  Espera a que otra etapa de la canalizacion devuelva un lote. Las primeras
+ *  VUELTAS_ESPERA vueltas solo ceden el procesador, por si el lote esta por
+ *  llegar; luego duerme el doble en cada vuelta, hasta 2^ESPERA_MAXIMA
+ *  microsegundos, para no ocupar un nucleo mientras la fuente espera a la
+ *  base de datos. *vueltas* se pone en cero al obtener un lote.
+ */
+static void esperar_lote(int *vueltas)
+{
+    struct timespec espera = {0, 0};
+    int exponente;
+    if (++(*vueltas) <= VUELTAS_ESPERA) {
+        sched_yield();
+        return;
+    }
+    exponente = *vueltas - VUELTAS_ESPERA;
+    if (exponente > ESPERA_MAXIMA)
+        exponente = ESPERA_MAXIMA;
+    espera.tv_nsec = 1000L << exponente;
+    nanosleep(&espera, NULL);
+}
+
+/*
+ * producir_lotes
+ * ---------------------------------------------------------------------------
+ *  Etapa de obtencion de la canalizacion: toma lotes vacios, los llena con
+ *  la fuente y los pasa a los hilos que clasifican. Si todos los lotes
+ *  estan llenos clasifica uno, por lo que tambien termina si la region
+ *  paralela tiene un solo hilo. Si la fuente falla se almacena 1 en
+ *  *error*.
+ *
+ *  Devuelve la cantidad de paquetes que clasifico el hilo.
+ */
+static int producir_lotes(struct s_analizador *analizador,
+                          struct fuente *fuente, struct cola *vacios,
+                          struct cola *llenos, int *terminado, int *error)
+{
+    struct lote_columnas *lote;
+    int total = 0, cantidad, vueltas = 0;
+    while (1) {
+        while ((lote = desencolar(vacios)) == NULL) {
+            lote = desencolar(llenos);
+            if (lote != NULL) {
+                analizar_columnas(analizador, lote, 0, lote->filas, NULL);
+                total += lote->filas;
+                break;
+            }
+            esperar_lote(&vueltas);
+        }
+        vueltas = 0;
+        cantidad = obtener_columnas(analizador, fuente, lote);
+        if (cantidad <= 0) {
+            *error = cantidad < 0;
+            encolar(vacios, lote);
+            break;
+        }
+        /* hay lugar para todos los lotes, por lo que nunca esta llena */
+        encolar(llenos, lote);
+    }
+    __atomic_store_n(terminado, 1, __ATOMIC_RELEASE);
+    return total;
+}
+
+/*
+ * consumir_lotes
+ * ---------------------------------------------------------------------------
+ *  Etapa de clasificacion de la canalizacion: cada hilo clasifica lotes
+ *  completos con sus contadores y devuelve los lotes vacios a la etapa de
+ *  obtencion, hasta que no quedan lotes y la fuente termino. Sin lotes
+ *  llenos el hilo espera con esperar_lote().
+ *
+ *  Devuelve la cantidad de paquetes que clasifico el hilo.
+ */
+static int consumir_lotes(struct s_analizador *analizador,
+                          struct cola *vacios, struct cola *llenos,
+                          int *terminado)
+{
+    struct lote_columnas *lote;
+    int total = 0, vueltas = 0;
+    while (1) {
+        lote = desencolar(llenos);
+        if (lote == NULL) {
+            /* el ultimo lote se encola antes de marcar el fin */
+            if (!__atomic_load_n(terminado, __ATOMIC_ACQUIRE)) {
+                esperar_lote(&vueltas);
+                continue;
+            }
+            lote = desencolar(llenos);
+            if (lote == NULL)
+                break;
+        }
+        vueltas = 0;
+        analizar_columnas(analizador, lote, 0, lote->filas, NULL);
+        total += lote->filas;
+        encolar(vacios, lote);
+    }
+    return total;
+}
+
+/*
+ * canalizar_columnas
+ * ---------------------------------------------------------------------------
+ *  Igual que leer_columnas() con una canalizacion: un hilo obtiene lotes de
+ *  la fuente sin esperar a la clasificacion y el resto clasifica cada uno un
+ *  lote completo. Las etapas se comunican con dos colas sin bloqueos de
+ *  LOTES_HILO lotes por hilo: la de lotes llenos y la de lotes vacios para
+ *  volver a llenar. El hilo que obtiene los lotes clasifica al terminar la
+ *  fuente.
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si no hay memoria
+ *  disponible o si la fuente no pudo obtener algun lote.
+ */
+static int canalizar_columnas(struct s_analizador *analizador,
+                              struct fuente *fuente, int tamanio, int hilos)
+{
+    struct lote_columnas *lote;
+    struct cola vacios, llenos;
+    int terminado = 0, total = 0, error = 0, fallo = 0, i;
+
+    if (crear_cola(&vacios, LOTES_HILO * hilos) < 0 ||
+            crear_cola(&llenos, LOTES_HILO * hilos) < 0) {
+        free_cola(&vacios);
+        sin_memoria(tamanio);
+        return -1;
+    }
+    for (i = 0; i < LOTES_HILO * hilos && !error; i++) {
+        lote = crear_lote_columnas(tamanio);
+        if (lote == NULL || encolar(&vacios, lote) < 0) {
+            free_lote_columnas(lote);
+            sin_memoria(tamanio);
+            error = 1;
+        }
+    }
+
+    if (!error) {
+        #pragma omp parallel num_threads(hilos) reduction(+:total)
+        {
+            if (omp_get_thread_num() == 0)
+                total += producir_lotes(analizador, fuente, &vacios,
+                                        &llenos, &terminado, &fallo);
+            total += consumir_lotes(analizador, &vacios, &llenos,
+                                    &terminado);
+        }
+    }
+
+    while ((lote = desencolar(&vacios)) != NULL)
+        free_lote_columnas(lote);
+    free_cola(&vacios);
+    free_cola(&llenos);
+    return error || fallo ? -1 : total;
+}
+
+/**
+ * analizar_fuente(s_analizador, fuente, callback)
+ * ---------------------------------------------------------------------------
+ *  Se usan dos buffers: un hilo obtiene el siguiente lote mientras el resto
+ *  analiza el lote actual, por lo que la memoria usada no depende de la
+ *  cantidad de paquetes de la fuente. Los lotes por columnas con mas de un
+ *  hilo se analizan con canalizar_columnas().
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si no se pudo abrir la
+ *  fuente, si fallo la obtencion de algun lote o si no hay memoria
+ *  disponible.
+ */
+int analizar_fuente(struct s_analizador *analizador, struct fuente *fuente,
+                    int (*callback)(const struct s_analizador*,
+                                    const struct paquete*))
+{
+    int tamanio; /* cantidad de paquetes de cada lote */
+    int hilos = omp_get_max_threads();
+    int total;
+
+    tamanio = analizador->tamanio_lote > 0 ?
+              analizador->tamanio_lote :
+              TAMANIO_LOTE;
+    if (fuente->abrir(fuente, analizador) < 0) {
+        fuente->cerrar(fuente);
+        return -1;
+    }
+    if (fuente->siguiente_columnas == NULL || callback != analizar_paquete)
+        total = leer_filas(analizador, fuente, callback, tamanio);
+    else if (hilos > 1)
+        total = canalizar_columnas(analizador, fuente, tamanio, hilos);
+    else
+        total = leer_columnas(analizador, fuente, tamanio);
+    fuente->cerrar(fuente);
+    return total;
+}
+
+/*
+ * leer_particion
+ * ---------------------------------------------------------------------------
+ *  Obtiene y analiza los lotes de una fuente abierta en el hilo actual, sin
+ *  crear otra region paralela: el hilo usa sus propios contadores y su cache
+ *  de flujos, por lo que varios hilos leen particiones a la vez.
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si no hay memoria
+ *  disponible o si la fuente no pudo obtener algun lote.
+ */
+static int leer_particion(struct s_analizador *analizador,
+                          struct fuente *fuente,
+                          int (*callback)(const struct s_analizador*,
+                                          const struct paquete*),
+                          int tamanio)
+{
+    struct lote_columnas *columnas;
+    struct paquete *lote;
+    int cantidad, total = 0, i;
+
+    if (fuente->siguiente_columnas != NULL && callback == analizar_paquete) {
+        columnas = crear_lote_columnas(tamanio);
+        if (columnas == NULL) {
+            sin_memoria(tamanio);
+            return -1;
+        }
+        while ((cantidad = obtener_columnas(analizador, fuente,
+                                            columnas)) > 0) {
+            analizar_columnas(analizador, columnas, 0, cantidad, NULL);
+            total += cantidad;
+        }
+        free_lote_columnas(columnas);
+        return cantidad < 0 ? -1 : total;
+    }
+    lote = malloc(sizeof(struct paquete) * tamanio);
+    if (lote == NULL) {
+        sin_memoria(tamanio);
+        return -1;
+    }
+    while ((cantidad = obtener_lote(analizador, fuente, lote,
+                                    tamanio)) > 0) {
+        if (callback == analizar_paquete)
+            analizar_lote(analizador, lote, cantidad, NULL);
+        else
+            for (i = 0; i < cantidad; i++)
+                callback(analizador, lote + i);
+        total += cantidad;
+    }
+    free(lote);
+    return cantidad < 0 ? -1 : total;
+}
+
+/**
+ * analizar_particiones(s_analizador, fuentes, cantidad, callback)
+ * ---------------------------------------------------------------------------
+ *  Reparte las fuentes entre los hilos de a una. Cada hilo abre su fuente,
+ *  la lee y la analiza de principio a fin y la cierra antes de tomar la
+ *  siguiente, por lo que una fuente lenta no detiene a las demas.
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si alguna fuente no se
+ *  pudo abrir o leer.
+ */
+int analizar_particiones(struct s_analizador *analizador,
+                         struct fuente *fuentes, int cantidad,
+                         int (*callback)(const struct s_analizador*,
+                                         const struct paquete*))
+{
+    int tamanio; /* cantidad de paquetes de cada lote */
+    int total = 0, error = 0, i, leidos;
+
+    tamanio = analizador->tamanio_lote > 0 ?
+              analizador->tamanio_lote :
+              TAMANIO_LOTE;
+    #pragma omp parallel for schedule(dynamic, 1) private(leidos) \
+                             reduction(+:total) reduction(|:error)
+    for (i = 0; i < cantidad; i++) {
+        if (fuentes[i].abrir(fuentes + i, analizador) < 0) {
+            fuentes[i].cerrar(fuentes + i);
+            error = 1;
+            continue;
+        }
+        leidos = leer_particion(analizador, fuentes + i, callback, tamanio);
+        if (leidos < 0)
+            error = 1;
+        else
+            total += leidos;
+        fuentes[i].cerrar(fuentes + i);
+    }
+    return error ? -1 : total;
+}
+
+/*
+ * abrir_memoria
+ * ---------------------------------------------------------------------------
+ *  Vuelve a entregar los paquetes desde el primero.
+ */
+static int abrir_memoria(struct fuente *fuente,
+                         const struct s_analizador *analizador)
+{
+    (void) analizador;
+    ((struct memoria *) fuente->datos)->posicion = 0;
+    return 0;
+}
+
+/*
+ * siguiente_lote_memoria
+ * ---------------------------------------------------------------------------
+ *  Copia los siguientes paquetes del array en el lote.
+ */
+static int siguiente_lote_memoria(struct fuente *fuente,
+                                  struct paquete *lote, int tamanio)
+{
+    struct memoria *memoria = fuente->datos;
+    int cantidad = memoria->cantidad - memoria->posicion;
+    if (cantidad > tamanio)
+        cantidad = tamanio;
+    memcpy(lote, memoria->paquetes + memoria->posicion,
+           sizeof(struct paquete) * cantidad);
+    memoria->posicion += cantidad;
+    return cantidad;
+}
+
+/*
+ * cerrar_memoria
+ * ---------------------------------------------------------------------------
+ *  Libera el estado de la fuente. El array de paquetes no se libera.
+ */
+static void cerrar_memoria(struct fuente *fuente)
+{
+    free(fuente->datos);
+    fuente->datos = NULL;
+}
+
+/**
+ * fuente_memoria(fuente, paquetes, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Crea una fuente que entrega los paquetes del array pasado por parametro.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int fuente_memoria(struct fuente *fuente, const struct paquete *paquetes,
+                   int cantidad)
+{
+    struct memoria *memoria = malloc(sizeof(struct memoria));
+    if (memoria == NULL)
+        return -1;
+    memoria->paquetes = paquetes;
+    memoria->cantidad = cantidad;
+    memoria->posicion = 0;
+    fuente->abrir = abrir_memoria;
+    fuente->siguiente_lote = siguiente_lote_memoria;
+    fuente->siguiente_columnas = NULL;
+    fuente->cerrar = cerrar_memoria;
+    fuente->datos = memoria;
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * fuente.h
+ * ==========================================================================
+ * Este modulo define la interfaz de las fuentes de paquetes y el analisis en
+ * lotes de los paquetes de cualquier fuente.
+ *
+ * Una fuente entrega los paquetes de a lotes de struct paquete ya
+ * convertidos, sin importar de donde se obtienen: la base de datos (ver
+ * fuente_bd), archivos de captura (ver fuente_captura) o un array en memoria
+ * (ver fuente_memoria). analizar_fuente() obtiene los lotes y los analiza en
+ * paralelo, por lo que todas las fuentes se analizan y se miden con el mismo
+ * codigo.
+ *
+ * Las fuentes que obtienen los paquetes por columnas, como la base de datos,
+ * pueden entregar ademas lotes por columnas (ver columnas.h), que se
+ * analizan sin convertirlos en struct paquete.
+ */
+#ifndef FUENTE_H
+#define FUENTE_H
+
+#include "analizador.h"
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct fuente
+ * ---------------------------------------------------------------------------
+ * Fuente de paquetes. Cada implementacion completa las funciones y su estado
+ * propio en *datos*.
+ *
+ * siguiente_lote() y siguiente_columnas() se pueden llamar desde cualquier
+ * hilo, pero nunca desde dos hilos a la vez. siguiente_columnas() es NULL si
+ * la fuente no entrega lotes por columnas.
+ */
+struct fuente {
+    /* prepara la fuente para el analisis. Devuelve -1 en caso de error */
+    int (*abrir)(struct fuente*, const struct s_analizador*);
+    /* copia hasta *tamanio* paquetes en el lote. Devuelve la cantidad de
+     * paquetes copiados, 0 al terminar la fuente o -1 en caso de error */
+    int (*siguiente_lote)(struct fuente*, struct paquete *lote, int tamanio);
+    /* reemplaza los paquetes del lote por columnas por hasta
+     * lote->capacidad paquetes. Devuelve lo mismo que siguiente_lote() */
+    int (*siguiente_columnas)(struct fuente*, struct lote_columnas *lote);
+    /* libera los recursos de la fuente, incluido su estado */
+    void (*cerrar)(struct fuente*);
+    void *datos; /* estado propio de la fuente */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * analizar_fuente(s_analizador, fuente, callback)
+ * ---------------------------------------------------------------------------
+ *  Abre la fuente, analiza todos sus paquetes con la funcion callback y la
+ *  cierra. Los paquetes se obtienen de a lotes de analizador->tamanio_lote y
+ *  mientras se analiza un lote en paralelo se obtiene el siguiente.
+ *
+ *  Si la funcion es analizar_paquete() y la fuente entrega lotes por
+ *  columnas, los lotes se obtienen por columnas y se analizan con
+ *  analizar_columnas().
+ *
+ *  La fuente se cierra aunque no se pueda abrir.
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si no se pudo abrir la
+ *  fuente, si fallo la obtencion de algun lote o si no hay memoria
+ *  disponible. En caso de error los contadores pueden tener parte de los
+ *  paquetes, por lo que el resultado no se debe informar.
+ */
+int analizar_fuente(struct s_analizador *analizador, struct fuente *fuente,
+                    int (*callback)(const struct s_analizador*,
+                                    const struct paquete*));
+
+/**
+ * analizar_particiones(s_analizador, fuentes, cantidad, callback)
+ * ---------------------------------------------------------------------------
+ *  Analiza varias fuentes independientes en paralelo, por ejemplo partes de
+ *  un intervalo obtenidas cada una con su propia conexion a la base de datos.
+ *  Cada fuente se abre, se lee y se analiza en un solo hilo con la funcion
+ *  callback, y los hilos analizan fuentes distintas a la vez. Los bytes de
+ *  cada hilo se suman en sus contadores, que se combinan al final con
+ *  reducir_contadores().
+ *
+ *  Todas las fuentes se cierran, aunque no se puedan abrir.
+ *
+ *  Devuelve la cantidad de paquetes analizados o -1 si alguna fuente no se
+ *  pudo abrir o leer o no hay memoria disponible. En caso de error los
+ *  contadores tienen los paquetes de las demas fuentes, por lo que el
+ *  resultado no se debe informar.
+ */
+int analizar_particiones(struct s_analizador *analizador,
+                         struct fuente *fuentes, int cantidad,
+                         int (*callback)(const struct s_analizador*,
+                                         const struct paquete*));
+
+/**
+ * fuente_memoria(fuente, paquetes, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Crea una fuente que entrega los paquetes del array pasado por parametro.
+ *  Se usa para medir el analisis con paquetes sinteticos. El array no se
+ *  copia y debe existir hasta cerrar la fuente.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int fuente_memoria(struct fuente *fuente, const struct paquete *paquetes,
+                   int cantidad);
+
+#endif /* FUENTE_H */
@@ -0,0 +1,572 @@
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include "indice.h"
+#include "analizador.h"
+
+/*
+ * par_subred
+ * ---------------------------------------------------------------------------
+ *  Estructura auxiliar que se usa durante la compilacion del indice. Relaciona
+ *  una subred con la clase que la define.
+ */
+struct par_subred {
+    int nodo; /* posicion del nodo de la subred en el arbol */
+    int clase;
+};
+
+/*
+ * par_puerto
+ * ---------------------------------------------------------------------------
+ *  Estructura auxiliar que se usa durante la compilacion del indice. Relaciona
+ *  un puerto con la clase que lo define.
+ */
+struct par_puerto {
+    int numero;
+    int protocolo;
+    int clase;
+};
+
+/*
+ * MACROS
+ * ===========================================================================
+ */
+
+/* agrega la clase *i* al conjunto */
+#define SET_BIT(conjunto, i) ((conjunto)[(i) / BITS_PALABRA] |= \
+                              (u_int64_t) 1 << ((i) % BITS_PALABRA))
+
+/* mascara de subred en orden de host a partir de la longitud del prefijo */
+#define MASCARA_HOST_ORDEN(n) ((n) == 0 ? 0 : 0xffffffff << (32 - (n)))
+
+/*
+ * comparar_par_puerto
+ * ---------------------------------------------------------------------------
+ *  Ordena pares de puertos por numero y protocolo.
+ */
+static int comparar_par_puerto(const void *a, const void *b)
+{
+    const struct par_puerto *x = a, *y = b;
+    if (x->numero != y->numero)
+        return x->numero < y->numero ? -1 : 1;
+    if (x->protocolo != y->protocolo)
+        return x->protocolo < y->protocolo ? -1 : 1;
+    return 0;
+}
+
+/*
+ * insertar_subred
+ * ---------------------------------------------------------------------------
+ *  Inserta una subred en el arbol sin comprimir creando los nodos
+ *  intermedios. Devuelve la posicion del nodo de la subred o -1 en caso de no
+ *  haber memoria disponible.
+ */
+static int insertar_subred(struct nodo_trie **arbol, int *cantidad,
+                           int *capacidad, u_int32_t red, int prefijo)
+{
+    struct nodo_trie *nodo;
+    int n = 0, b, bit;
+    for (b = 0; b < prefijo; b++) {
+        bit = (red >> (31 - b)) & 1;
+        if ((*arbol)[n].hijos[bit] < 0) {
+            if (*cantidad == *capacidad) {
+                *capacidad *= 2;
+                nodo = realloc(*arbol, sizeof(struct nodo_trie) * *capacidad);
+                if (nodo == NULL)
+                    return -1;
+                *arbol = nodo;
+            }
+            nodo = *arbol + *cantidad;
+            memset(nodo, 0, sizeof(struct nodo_trie));
+            nodo->prefijo = b + 1;
+            nodo->mascara = MASCARA_HOST_ORDEN(b + 1);
+            nodo->red = red & nodo->mascara;
+            nodo->hijos[0] = nodo->hijos[1] = -1;
+            (*arbol)[n].hijos[bit] = (*cantidad)++;
+        }
+        n = (*arbol)[n].hijos[bit];
+    }
+    return n;
+}
+
+/*
+ * comprimir
+ * ---------------------------------------------------------------------------
+ *  Copia el subarbol del nodo *n* al indice salteando los nodos sin clases que
+ *  tienen un solo hijo. Devuelve la posicion del nodo copiado o -1 si el
+ *  subarbol no tiene clases.
+ */
+static int comprimir(const struct nodo_trie *arbol, int n,
+                     struct dimension_subred *dim)
+{
+    int nuevo;
+    if (n < 0)
+        return -1;
+    while (arbol[n].cantidad == 0 &&
+           (arbol[n].hijos[0] < 0) != (arbol[n].hijos[1] < 0))
+        n = arbol[n].hijos[arbol[n].hijos[0] < 0];
+    if (arbol[n].cantidad == 0 &&
+        arbol[n].hijos[0] < 0 && arbol[n].hijos[1] < 0)
+        return -1;
+    nuevo = dim->cant_nodos++;
+    dim->nodos[nuevo] = arbol[n];
+    dim->nodos[nuevo].hijos[0] = comprimir(arbol, arbol[n].hijos[0], dim);
+    dim->nodos[nuevo].hijos[1] = comprimir(arbol, arbol[n].hijos[1], dim);
+    return nuevo;
+}
+
+/*
+ * compilar_subredes
+ * ---------------------------------------------------------------------------
+ *  Compila las subredes del grupo pasado por parametro de todas las clases en
+ *  un arbol de prefijos. Devuelve -1 en caso de no haber memoria disponible.
+ */
+static int compilar_subredes(struct dimension_subred *dim,
+                             const struct clase *clases, int cantidad,
+                             int palabras, int grupo)
+{
+    const struct subred *subredes;
+    struct par_subred *pares = NULL;
+    struct nodo_trie *arbol = NULL;
+    int cant_subredes, cant_pares = 0, cant_nodos = 1, capacidad = 64;
+    int i, j, p, ret = -1;
+
+    dim->raiz = -1;
+    dim->comodin = calloc(palabras, sizeof(u_int64_t));
+    if (dim->comodin == NULL)
+        return -1;
+
+    /* cuento la cantidad de subredes de todas las clases */
+    for (i = 1; i < cantidad; i++)
+        cant_pares += grupo == GRUPO_OUTSIDE ?
+                      clases[i].cant_subredes_outside :
+                      clases[i].cant_subredes_inside;
+
+    pares = malloc(sizeof(struct par_subred) * (cant_pares + 1));
+    arbol = malloc(sizeof(struct nodo_trie) * capacidad);
+    if (pares == NULL || arbol == NULL)
+        goto fin;
+    memset(arbol, 0, sizeof(struct nodo_trie));
+    arbol->hijos[0] = arbol->hijos[1] = -1;
+
+    /* la clase por defecto (indice 0) no participa del indice */
+    cant_pares = 0;
+    for (i = 1; i < cantidad; i++) {
+        subredes = grupo == GRUPO_OUTSIDE ?
+                   clases[i].subredes_outside :
+                   clases[i].subredes_inside;
+        cant_subredes = grupo == GRUPO_OUTSIDE ?
+                        clases[i].cant_subredes_outside :
+                        clases[i].cant_subredes_inside;
+        /* si la clase no define subredes coincide con cualquier ip */
+        if (cant_subredes == 0)
+            SET_BIT(dim->comodin, i);
+        for (j = 0; j < cant_subredes; j++) {
+            /* las subredes /0 no suman puntos, por lo que nunca coinciden */
+            p = subredes[j].prefijo;
+            if (p <= 0)
+                continue;
+            pares[cant_pares].nodo = insertar_subred(
+                    &arbol, &cant_nodos, &capacidad,
+                    ntohl(subredes[j].red.s_addr), p);
+            if (pares[cant_pares].nodo < 0)
+                goto fin;
+            pares[cant_pares].clase = i;
+            arbol[pares[cant_pares].nodo].cantidad++;
+            cant_pares++;
+        }
+    }
+
+    /* ubico las clases de cada nodo en un unico array */
+    dim->clases = malloc(sizeof(int) * (cant_pares + 1));
+    dim->nodos = malloc(sizeof(struct nodo_trie) * cant_nodos);
+    if (dim->clases == NULL || dim->nodos == NULL)
+        goto fin;
+    for (i = 0, j = 0; i < cant_nodos; i++) {
+        arbol[i].inicio = j;
+        j += arbol[i].cantidad;
+        arbol[i].cantidad = 0;
+    }
+    for (i = 0; i < cant_pares; i++) {
+        p = pares[i].nodo;
+        dim->clases[arbol[p].inicio + arbol[p].cantidad++] = pares[i].clase;
+    }
+
+    dim->raiz = comprimir(arbol, 0, dim);
+    ret = 0;
+fin:
+    free(pares);
+    free(arbol);
+    return ret;
+}
+
+/*
+ * agregar_conjunto
+ * ---------------------------------------------------------------------------
+ *  Agrega un conjunto de clases a la dimension de puertos si no existe uno
+ *  igual. Los conjuntos se buscan en una tabla hash con direccionamiento
+ *  abierto. Devuelve la posicion del conjunto o -1 si no hay lugar.
+ */
+static int agregar_conjunto(struct dimension_puerto *dim,
+                            const u_int64_t *conjunto, int palabras,
+                            int *hash, int tam_hash, int capacidad)
+{
+    u_int64_t h = 14695981039346656037ULL; /* FNV-1a */
+    int i, pos;
+    for (i = 0; i < palabras; i++)
+        h = (h ^ conjunto[i]) * 1099511628211ULL;
+    pos = h & (tam_hash - 1);
+    while (hash[pos] >= 0) {
+        if (memcmp(dim->conjuntos + (size_t) hash[pos] * palabras,
+                   conjunto, sizeof(u_int64_t) * palabras) == 0)
+            return hash[pos];
+        pos = (pos + 1) & (tam_hash - 1);
+    }
+    if (dim->cant_conjuntos == capacidad)
+        return -1;
+    memcpy(dim->conjuntos + (size_t) dim->cant_conjuntos * palabras,
+           conjunto, sizeof(u_int64_t) * palabras);
+    hash[pos] = dim->cant_conjuntos;
+    return dim->cant_conjuntos++;
+}
+
+/*
+ * compilar_puertos
+ * ---------------------------------------------------------------------------
+ *  Compila los puertos del grupo pasado por parametro de todas las clases en
+ *  una tabla por protocolo. Devuelve -1 en caso de no haber memoria
+ *  disponible.
+ */
+static int compilar_puertos(struct dimension_puerto *dim,
+                            const struct clase *clases, int cantidad,
+                            int palabras, int grupo)
+{
+    const struct puerto *puertos;
+    struct par_puerto *pares = NULL;
+    u_int64_t *conjunto = NULL;
+    int *hash = NULL;
+    int protocolos[CANT_PROTOCOLOS]; /* protocolo de cada ranura */
+    int cant_puertos, cant_pares = 0, distintos = 0, capacidad;
+    int tam_hash = 1;
+    int i, j, k, r, id, ret = -1;
+
+    dim->comodin = calloc(palabras, sizeof(u_int64_t));
+    if (dim->comodin == NULL)
+        return -1;
+
+    for (i = 1; i < cantidad; i++)
+        cant_pares += grupo == GRUPO_OUTSIDE ?
+                      clases[i].cant_puertos_outside :
+                      clases[i].cant_puertos_inside;
+
+    pares = malloc(sizeof(struct par_puerto) * (cant_pares + 1));
+    if (pares == NULL)
+        return -1;
+
+    cant_pares = 0;
+    for (i = 1; i < cantidad; i++) {
+        puertos = grupo == GRUPO_OUTSIDE ?
+                  clases[i].puertos_outside :
+                  clases[i].puertos_inside;
+        cant_puertos = grupo == GRUPO_OUTSIDE ?
+                       clases[i].cant_puertos_outside :
+                       clases[i].cant_puertos_inside;
+        /* si la clase no define puertos coincide con cualquier puerto */
+        if (cant_puertos == 0)
+            SET_BIT(dim->comodin, i);
+        for (j = 0; j < cant_puertos; j++) {
+            /* ningun paquete puede coincidir con puertos fuera de rango */
+            if (puertos[j].numero < 0 || puertos[j].numero >= CANT_PUERTOS)
+                continue;
+            pares[cant_pares].numero = puertos[j].numero;
+            pares[cant_pares].protocolo = puertos[j].protocolo;
+            pares[cant_pares].clase = i;
+            cant_pares++;
+        }
+    }
+    qsort(pares, cant_pares, sizeof(struct par_puerto), comparar_par_puerto);
+
+    /* asigno una ranura a cada protocolo. La ranura cero es para los
+     * protocolos que no define ninguna clase. */
+    dim->cant_ranuras = 1;
+    protocolos[0] = 0;
+    for (i = 0; i < cant_pares; i++) {
+        r = pares[i].protocolo;
+        if (r > 0 && r < CANT_PROTOCOLOS && dim->ranura[r] == 0) {
+            dim->ranura[r] = dim->cant_ranuras;
+            protocolos[dim->cant_ranuras++] = r;
+        }
+        if (i == 0 || pares[i].numero != pares[i - 1].numero)
+            distintos++;
+    }
+
+    /* a lo sumo hay un conjunto por puerto y ranura, mas el comodin */
+    capacidad = distintos * dim->cant_ranuras + 1;
+    if (capacidad > CANT_PUERTOS)
+        capacidad = CANT_PUERTOS;
+    while (tam_hash < 2 * capacidad)
+        tam_hash *= 2;
+    hash = malloc(sizeof(int) * tam_hash);
+    conjunto = malloc(sizeof(u_int64_t) * palabras);
+    dim->conjuntos = malloc(sizeof(u_int64_t) * palabras * capacidad);
+    dim->tablas = calloc((size_t) dim->cant_ranuras * CANT_PUERTOS,
+                         sizeof(u_int16_t));
+    if (hash == NULL || conjunto == NULL || dim->conjuntos == NULL ||
+        dim->tablas == NULL)
+        goto fin;
+    memset(hash, -1, sizeof(int) * tam_hash);
+
+    /* el conjunto cero contiene solamente al comodin. Es el que corresponde
+     * a los puertos que no define ninguna clase. */
+    agregar_conjunto(dim, dim->comodin, palabras, hash, tam_hash, capacidad);
+
+    for (i = 0; i < cant_pares; i = k) {
+        k = i;
+        while (k < cant_pares && pares[k].numero == pares[i].numero)
+            k++;
+        for (r = 0; r < dim->cant_ranuras; r++) {
+            memcpy(conjunto, dim->comodin, sizeof(u_int64_t) * palabras);
+            /* el protocolo cero es comodin */
+            for (j = i; j < k; j++)
+                if (pares[j].protocolo == 0 ||
+                    (r > 0 && pares[j].protocolo == protocolos[r]))
+                    SET_BIT(conjunto, pares[j].clase);
+            id = agregar_conjunto(dim, conjunto, palabras, hash, tam_hash,
+                                  capacidad);
+            if (id < 0) {
+                syslog(LOG_ERR, "Demasiadas combinaciones de puertos");
+                goto fin;
+            }
+            dim->tablas[r * CANT_PUERTOS + pares[i].numero] = id;
+        }
+    }
+    ret = 0;
+fin:
+    free(pares);
+    free(hash);
+    free(conjunto);
+    return ret;
+}
+
+/**
+ * crear_indice(clases, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Compila el array de clases de trafico en un indice. Devuelve NULL en caso
+ *  de no haber memoria disponible.
+ */
+struct indice* crear_indice(const struct clase *clases, int cantidad)
+{
+    struct indice *indice = calloc(1, sizeof(struct indice));
+    if (indice == NULL)
+        return NULL;
+    indice->cant_clases = cantidad;
+    indice->palabras = cantidad / BITS_PALABRA + 1;
+
+    if (compilar_subredes(&(indice->subredes_outside), clases, cantidad,
+                          indice->palabras, GRUPO_OUTSIDE) ||
+        compilar_subredes(&(indice->subredes_inside), clases, cantidad,
+                          indice->palabras, GRUPO_INSIDE) ||
+        compilar_puertos(&(indice->puertos_outside), clases, cantidad,
+                         indice->palabras, GRUPO_OUTSIDE) ||
+        compilar_puertos(&(indice->puertos_inside), clases, cantidad,
+                         indice->palabras, GRUPO_INSIDE)) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para indexar %d clases",
+               cantidad);
+        free_indice(indice);
+        return NULL;
+    }
+    return indice;
+}
+
+/*
+ * free_dimension_subred
+ * ---------------------------------------------------------------------------
+ *  Libera memoria ocupada por el indice de subredes de un grupo.
+ */
+static void free_dimension_subred(struct dimension_subred *dim)
+{
+    free(dim->nodos);
+    free(dim->clases);
+    free(dim->comodin);
+}
+
+/**
+ * free_indice(indice)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por el indice.
+ */
+void free_indice(struct indice *indice)
+{
+    if (indice == NULL)
+        return;
+    if (indice->externo) {
+        free(indice);
+        return;
+    }
+    free_dimension_subred(&(indice->subredes_outside));
+    free_dimension_subred(&(indice->subredes_inside));
+    free(indice->puertos_outside.comodin);
+    free(indice->puertos_outside.conjuntos);
+    free(indice->puertos_outside.tablas);
+    free(indice->puertos_inside.comodin);
+    free(indice->puertos_inside.conjuntos);
+    free(indice->puertos_inside.tablas);
+    free(indice);
+}
+
+/*
+ * candidatos_subred
+ * ---------------------------------------------------------------------------
+ *  Escribe en *conjunto* las clases que coinciden con la ip en esta dimension
+ *  y en *puntos* el prefijo mas largo con el que coincide cada una. Las
+ *  posiciones de *puntos* de las clases que no estan en el conjunto no se
+ *  modifican.
+ */
+static void candidatos_subred(const struct dimension_subred *dim,
+                              struct in_addr ip, int palabras,
+                              u_int64_t *conjunto, int *puntos)
+{
+    const struct nodo_trie *nodo;
+    u_int32_t red = ntohl(ip.s_addr);
+    int n = dim->raiz, i;
+    memcpy(conjunto, dim->comodin, sizeof(u_int64_t) * palabras);
+    while (n >= 0) {
+        nodo = dim->nodos + n;
+        if ((red & nodo->mascara) != nodo->red)
+            break;
+        /* al descender el prefijo es cada vez mas largo */
+        for (i = nodo->inicio; i < nodo->inicio + nodo->cantidad; i++) {
+            SET_BIT(conjunto, dim->clases[i]);
+            puntos[dim->clases[i]] = nodo->prefijo;
+        }
+        if (nodo->prefijo == 32)
+            break;
+        n = nodo->hijos[(red >> (31 - nodo->prefijo)) & 1];
+    }
+}
+
+/*
+ * candidatos_puerto
+ * ---------------------------------------------------------------------------
+ *  Devuelve el conjunto de clases que coinciden con el puerto y protocolo en
+ *  esta dimension.
+ */
+static inline const u_int64_t* candidatos_puerto(
+        const struct dimension_puerto *dim, int puerto, int protocolo,
+        int palabras)
+{
+    int r = protocolo > 0 && protocolo < CANT_PROTOCOLOS ?
+            dim->ranura[protocolo] : 0;
+    return dim->conjuntos +
+           (size_t) dim->tablas[r * CANT_PUERTOS + puerto] * palabras;
+}
+
+/**
+ * indice_anticipar(indice, paquete)
+ * ---------------------------------------------------------------------------
+ *  Las tablas de puertos ocupan 128KB por protocolo y grupo, por lo que sus
+ *  posiciones casi nunca estan en la cache del procesador. Los conjuntos y
+ *  el arbol de subredes son pequeños y no se anticipan.
+ */
+void indice_anticipar(const struct indice *indice,
+                      const struct paquete *paquete)
+{
+    const struct dimension_puerto *dim;
+    int r;
+    dim = &(indice->puertos_outside);
+    r = paquete->protocolo > 0 && paquete->protocolo < CANT_PROTOCOLOS ?
+        dim->ranura[paquete->protocolo] : 0;
+    __builtin_prefetch(dim->tablas + r * CANT_PUERTOS +
+                       puerto_grupo(paquete, GRUPO_OUTSIDE));
+    dim = &(indice->puertos_inside);
+    r = paquete->protocolo > 0 && paquete->protocolo < CANT_PROTOCOLOS ?
+        dim->ranura[paquete->protocolo] : 0;
+    __builtin_prefetch(dim->tablas + r * CANT_PUERTOS +
+                       puerto_grupo(paquete, GRUPO_INSIDE));
+}
+
+/* devuelve 1 si la clase *i* pertenece al conjunto */
+#define GET_BIT(conjunto, i) (((conjunto)[(i) / BITS_PALABRA] >> \
+                               ((i) % BITS_PALABRA)) & 1)
+
+/*
+ * buscar_candidatas
+ * ---------------------------------------------------------------------------
+ *  Intersecta los conjuntos de clases de las cuatro dimensiones y guarda en
+ *  *puntos_outside* y *puntos_inside* el prefijo de cada clase que contiene
+ *  a las ips del paquete.
+ */
+static inline void buscar_candidatas(const struct indice *indice,
+                                     const struct paquete *paquete,
+                                     u_int64_t *candidatos,
+                                     u_int64_t *conjunto,
+                                     int *puntos_outside,
+                                     int *puntos_inside)
+{
+    const u_int64_t *puertos_outside, *puertos_inside;
+    int i;
+    candidatos_subred(&(indice->subredes_outside),
+                      ip_grupo(paquete, GRUPO_OUTSIDE),
+                      indice->palabras, candidatos, puntos_outside);
+    candidatos_subred(&(indice->subredes_inside),
+                      ip_grupo(paquete, GRUPO_INSIDE),
+                      indice->palabras, conjunto, puntos_inside);
+    puertos_outside = candidatos_puerto(&(indice->puertos_outside),
+                                        puerto_grupo(paquete, GRUPO_OUTSIDE),
+                                        paquete->protocolo, indice->palabras);
+    puertos_inside = candidatos_puerto(&(indice->puertos_inside),
+                                       puerto_grupo(paquete, GRUPO_INSIDE),
+                                       paquete->protocolo, indice->palabras);
+    for (i = 0; i < indice->palabras; i++)
+        candidatos[i] &= conjunto[i] & puertos_outside[i] & puertos_inside[i];
+}
+
+/**
+ * indice_mejor_clase(indice, paquete, puntaje, candidatas)
+ * ---------------------------------------------------------------------------
+ *  Busca la clase con mejor coincidencia con el paquete. Las candidatas se
+ *  recorren en el mismo orden que el array de clases, por lo que ante un
+ *  empate se elige la misma clase que en la comparacion contra todas las
+ *  clases. Si *candidatas* no es NULL, las candidatas quedan en el.
+ *
+ *  Devuelve la posicion de la clase en el array de clases o 0 (la clase por
+ *  defecto) si el paquete no coincide con ninguna.
+ */
+int indice_mejor_clase(const struct indice *indice,
+                       const struct paquete *paquete,
+                       int *puntaje,
+                       u_int64_t *candidatas)
+{
+    int palabras = indice->palabras;
+    u_int64_t propias[palabras], conjunto[palabras], palabra;
+    u_int64_t *candidatos = candidatas != NULL ? candidatas : propias;
+    int puntos_outside[indice->cant_clases], puntos_inside[indice->cant_clases];
+    int mejor = 0, actual, i, c;
+
+    *puntaje = 0;
+    buscar_candidatas(indice, paquete, candidatos, conjunto, puntos_outside,
+                      puntos_inside);
+
+    /* puntuo las candidatas igual que coincide() */
+    for (i = 0; i < palabras; i++) {
+        palabra = candidatos[i];
+        while (palabra) {
+            c = i * BITS_PALABRA + __builtin_ctzll(palabra);
+            palabra &= palabra - 1;
+            actual = GET_BIT(indice->subredes_outside.comodin, c) ?
+                     1 : puntos_outside[c];
+            actual += GET_BIT(indice->subredes_inside.comodin, c) ?
+                      1 : puntos_inside[c];
+            actual += GET_BIT(indice->puertos_outside.comodin, c) ?
+                      1 : 1 + PUNTOS_COINCIDENCIA_PUERTO;
+            actual += GET_BIT(indice->puertos_inside.comodin, c) ?
+                      1 : 1 + PUNTOS_COINCIDENCIA_PUERTO;
+            if (actual > *puntaje) {
+                *puntaje = actual;
+                mejor = c;
+            }
+        }
+    }
+    return mejor;
+}
@@ -0,0 +1,161 @@
+/**
+ * indice.h
+ * ==========================================================================
+ * Este modulo compila las clases de trafico instaladas en un indice por
+ * dimension (subredes outside, subredes inside, puertos outside y puertos
+ * inside).
+ *
+ * Cada dimension devuelve, para un paquete, el conjunto de clases que
+ * coinciden en esa dimension. Los conjuntos se representan como mapas de bits
+ * donde el bit *i* corresponde a la clase *i* del array de clases del
+ * analizador. La interseccion de las cuatro dimensiones son las clases
+ * candidatas, que son las unicas que se deben puntuar.
+ *
+ * Las dimensiones de subredes ademas devuelven el prefijo mas largo con el que
+ * coincide cada clase, por lo que el puntaje de las candidatas se calcula sin
+ * volver a recorrer sus subredes.
+ */
+#ifndef INDICE_H
+#define INDICE_H
+
+#include <sys/types.h>
+#include "paquete.h"
+#include "clase_trafico.h"
+
+/* cantidad de bits que contiene una palabra de un conjunto de clases */
+#define BITS_PALABRA 64
+/* cantidad de numeros de puerto posibles */
+#define CANT_PUERTOS 65536
+/* cantidad de numeros de protocolo posibles */
+#define CANT_PROTOCOLOS 256
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct nodo_trie
+ * ---------------------------------------------------------------------------
+ * Nodo del arbol de prefijos (trie binario con compresion de caminos) que
+ * indexa las subredes de todas las clases. Cada nodo representa el prefijo
+ * red/prefijo y guarda las clases que definen exactamente esa subred.
+ *
+ * Los nodos sin clases con un solo hijo se eliminan al comprimir el arbol, por
+ * lo que al descender se debe comprobar que la ip pertenezca al prefijo del
+ * nodo.
+ */
+struct nodo_trie {
+    u_int32_t red; /* direccion de red en orden de host */
+    u_int32_t mascara; /* mascara de subred en orden de host */
+    int prefijo; /* longitud del prefijo */
+    int hijos[2]; /* posicion de los hijos (bit en cero y en uno) o -1 */
+    int inicio; /* posicion de la primer clase del nodo */
+    int cantidad; /* cantidad de clases del nodo */
+};
+
+/**
+ * struct dimension_subred
+ * ---------------------------------------------------------------------------
+ * Indice de subredes de un grupo (outside o inside). Una busqueda recorre a lo
+ * sumo 33 nodos y devuelve todas las clases con alguna subred que contenga a
+ * la ip junto con su prefijo mas largo.
+ */
+struct dimension_subred {
+    int raiz; /* posicion del nodo raiz o -1 si no hay subredes */
+    int cant_nodos;
+    struct nodo_trie *nodos;
+    int *clases; /* clases de todos los nodos */
+    u_int64_t *comodin; /* clases que coinciden siempre en esta dimension */
+};
+
+/**
+ * struct dimension_puerto
+ * ---------------------------------------------------------------------------
+ * Indice de puertos de un grupo (outside o inside).
+ *
+ * Por cada protocolo que usan las clases hay una tabla de 65536 posiciones
+ * indexada por numero de puerto que contiene la posicion del conjunto de
+ * clases que coinciden con ese puerto y protocolo. Las tablas ya incluyen las
+ * clases que definen el puerto con protocolo comodin y las clases que no
+ * definen puertos, por lo que obtener las clases de un puerto es un solo
+ * acceso a memoria.
+ *
+ * La ranura cero se usa para los protocolos que ninguna clase define.
+ */
+struct dimension_puerto {
+    int cant_ranuras; /* cantidad de tablas */
+    u_int8_t ranura[CANT_PROTOCOLOS]; /* ranura de cada protocolo */
+    u_int16_t *tablas; /* cant_ranuras tablas de CANT_PUERTOS posiciones */
+    int cant_conjuntos; /* cantidad de conjuntos distintos */
+    u_int64_t *conjuntos; /* conjuntos de clases referenciados por las tablas*/
+    u_int64_t *comodin; /* clases que coinciden siempre en esta dimension */
+};
+
+/**
+ * struct indice
+ * ---------------------------------------------------------------------------
+ * Indice compilado de las clases de trafico.
+ */
+struct indice {
+    int cant_clases; /* cantidad de clases indexadas */
+    int palabras; /* cantidad de palabras de cada conjunto de clases */
+    struct dimension_subred subredes_outside;
+    struct dimension_subred subredes_inside;
+    struct dimension_puerto puertos_outside;
+    struct dimension_puerto puertos_inside;
+    int externo; /* si es distinto de cero los arrays de las dimensiones
+                  * pertenecen a una instantanea (ver instantanea.h) y no se
+                  * liberan con el indice */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_indice(clases, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Compila el array de clases de trafico en un indice. Devuelve NULL en caso
+ *  de no haber memoria disponible.
+ */
+struct indice* crear_indice(const struct clase *clases, int cantidad);
+
+/**
+ * free_indice(indice)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por el indice.
+ */
+void free_indice(struct indice *indice);
+
+/**
+ * indice_mejor_clase(indice, paquete, puntaje, candidatas)
+ * ---------------------------------------------------------------------------
+ *  Busca la clase con mejor coincidencia con el paquete. El puntaje es el
+ *  mismo que devuelve coincide() y ante un empate se elige la clase que esta
+ *  primero en el array de clases.
+ *
+ *  Si *candidatas* no es NULL, se guarda en el el conjunto de clases que
+ *  coinciden con el paquete, entre las que se eligio la mejor. Debe tener
+ *  lugar para un bit por clase en palabras de 64 bits.
+ *
+ *  Devuelve la posicion de la clase en el array de clases o 0 (la clase por
+ *  defecto) si el paquete no coincide con ninguna. En *puntaje* se almacena el
+ *  puntaje de la clase elegida.
+ */
+int indice_mejor_clase(const struct indice *indice,
+                       const struct paquete *paquete,
+                       int *puntaje,
+                       u_int64_t *candidatas);
+
+/**
+ * indice_anticipar(indice, paquete)
+ * ---------------------------------------------------------------------------
+ *  Anticipa la lectura de las posiciones de las tablas de puertos que usara
+ *  indice_mejor_clase() con el paquete. No modifica el indice.
+ */
+void indice_anticipar(const struct indice *indice,
+                      const struct paquete *paquete);
+
+#endif /* INDICE_H */
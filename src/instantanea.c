@@ -0,0 +1,592 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "instantanea.h"
+#include "indice.h"
+
+/*
+ * ESTRUCTURAS DEL ARCHIVO
+ * ===========================================================================
+ * El archivo empieza con una cabecera seguida por las secciones, cada una
+ * alineada a una linea de cache. Las secciones son arrays con el mismo
+ * formato que tienen en memoria.
+ */
+
+/*
+ * struct seccion
+ * ---------------------------------------------------------------------------
+ * Ubicacion de un array dentro del archivo.
+ */
+struct seccion {
+    u_int64_t inicio; /* posicion en bytes desde el inicio del archivo */
+    u_int64_t tamanio; /* tamaño en bytes */
+};
+
+/*
+ * struct cabecera_subred
+ * ---------------------------------------------------------------------------
+ * Dimension de subredes del indice (ver struct dimension_subred).
+ */
+struct cabecera_subred {
+    int32_t raiz;
+    int32_t cant_nodos;
+    struct seccion nodos;
+    struct seccion clases;
+    struct seccion comodin;
+};
+
+/*
+ * struct cabecera_puerto
+ * ---------------------------------------------------------------------------
+ * Dimension de puertos del indice (ver struct dimension_puerto).
+ */
+struct cabecera_puerto {
+    int32_t cant_ranuras;
+    int32_t cant_conjuntos;
+    u_int8_t ranura[CANT_PROTOCOLOS];
+    struct seccion tablas;
+    struct seccion conjuntos;
+    struct seccion comodin;
+};
+
+/*
+ * struct cabecera
+ * ---------------------------------------------------------------------------
+ * Cabecera del archivo de instantanea.
+ *
+ * Las subredes y los puertos de todas las clases estan en un solo array cada
+ * uno, en el orden de las clases y primero los del grupo outside.
+ */
+struct cabecera {
+    char magia[8]; /* MAGIA_INSTANTANEA */
+    u_int32_t version; /* VERSION_INSTANTANEA */
+    u_int32_t tamanio_clase; /* sizeof(struct clase) al crearla */
+    u_int64_t firma; /* firma de las clases en la base de datos */
+    u_int64_t tamanio; /* tamaño del archivo en bytes */
+    int32_t cant_clases;
+    int32_t palabras; /* palabras de los conjuntos de clases del indice */
+    struct seccion clases;
+    struct seccion subredes;
+    struct seccion puertos;
+    struct cabecera_subred subredes_outside;
+    struct cabecera_subred subredes_inside;
+    struct cabecera_puerto puertos_outside;
+    struct cabecera_puerto puertos_inside;
+};
+
+/* redondea *n* al multiplo siguiente del tamaño de linea de cache */
+#define ALINEAR(n) (((n) + LINEA_CACHE - 1) & ~(u_int64_t) (LINEA_CACHE - 1))
+
+/*
+ * ubicar
+ * ---------------------------------------------------------------------------
+ *  Ubica una seccion del tamaño pasado por parametro a continuacion de la
+ *  posicion *fin* y avanza *fin* al final de la seccion.
+ */
+static void ubicar(struct seccion *seccion, u_int64_t tamanio, u_int64_t *fin)
+{
+    seccion->inicio = ALINEAR(*fin);
+    seccion->tamanio = tamanio;
+    *fin = seccion->inicio + tamanio;
+}
+
+/*
+ * escribir
+ * ---------------------------------------------------------------------------
+ *  Escribe *tamanio* bytes en la posicion *inicio* del archivo. Devuelve -1
+ *  en caso de error.
+ */
+static int escribir(FILE *file, u_int64_t inicio, const void *datos,
+                    u_int64_t tamanio)
+{
+    if (fseek(file, (long) inicio, SEEK_SET) != 0)
+        return -1;
+    if (tamanio > 0 && fwrite(datos, tamanio, 1, file) != 1)
+        return -1;
+    return 0;
+}
+
+/*
+ * cant_clases_subred
+ * ---------------------------------------------------------------------------
+ *  Devuelve la cantidad de posiciones del array de clases de una dimension de
+ *  subredes.
+ */
+static int cant_clases_subred(const struct dimension_subred *dim)
+{
+    int i, cantidad = 0;
+    for (i = 0; i < dim->cant_nodos; i++)
+        if (dim->nodos[i].inicio + dim->nodos[i].cantidad > cantidad)
+            cantidad = dim->nodos[i].inicio + dim->nodos[i].cantidad;
+    return cantidad;
+}
+
+/*
+ * ubicar_subred / ubicar_puerto
+ * ---------------------------------------------------------------------------
+ *  Completan la cabecera de una dimension del indice y ubican sus arrays.
+ */
+static void ubicar_subred(struct cabecera_subred *cab,
+                          const struct dimension_subred *dim, int palabras,
+                          u_int64_t *fin)
+{
+    cab->raiz = dim->raiz;
+    cab->cant_nodos = dim->cant_nodos;
+    ubicar(&(cab->nodos), sizeof(struct nodo_trie) * dim->cant_nodos, fin);
+    ubicar(&(cab->clases), sizeof(int) * cant_clases_subred(dim), fin);
+    ubicar(&(cab->comodin), sizeof(u_int64_t) * palabras, fin);
+}
+
+static void ubicar_puerto(struct cabecera_puerto *cab,
+                          const struct dimension_puerto *dim, int palabras,
+                          u_int64_t *fin)
+{
+    cab->cant_ranuras = dim->cant_ranuras;
+    cab->cant_conjuntos = dim->cant_conjuntos;
+    memcpy(cab->ranura, dim->ranura, CANT_PROTOCOLOS);
+    ubicar(&(cab->tablas),
+           sizeof(u_int16_t) * CANT_PUERTOS * dim->cant_ranuras, fin);
+    ubicar(&(cab->conjuntos),
+           sizeof(u_int64_t) * palabras * dim->cant_conjuntos, fin);
+    ubicar(&(cab->comodin), sizeof(u_int64_t) * palabras, fin);
+}
+
+/*
+ * escribir_clases
+ * ---------------------------------------------------------------------------
+ *  Escribe las clases sin punteros ni contadores, y las subredes y puertos de
+ *  todas las clases.
+ */
+static int escribir_clases(FILE *file, const struct cabecera *cab,
+                           const struct s_analizador *analizador)
+{
+    const struct clase *clase;
+    struct clase copia;
+    u_int64_t subredes = cab->subredes.inicio, puertos = cab->puertos.inicio;
+    u_int64_t tamanio;
+    int i;
+    for (i = 0; i < analizador->cant_clases; i++) {
+        clase = analizador->clases + i;
+        copia = *clase;
+        copia.subredes_outside = NULL;
+        copia.subredes_inside = NULL;
+        copia.puertos_outside = NULL;
+        copia.puertos_inside = NULL;
+        copia.bytes_subida = 0;
+        copia.bytes_bajada = 0;
+        copia.paquetes_subida = 0;
+        copia.paquetes_bajada = 0;
+        if (escribir(file, cab->clases.inicio + i * sizeof(struct clase),
+                     &copia, sizeof(struct clase)))
+            return -1;
+        tamanio = sizeof(struct subred) * clase->cant_subredes_outside;
+        if (escribir(file, subredes, clase->subredes_outside, tamanio))
+            return -1;
+        subredes += tamanio;
+        tamanio = sizeof(struct subred) * clase->cant_subredes_inside;
+        if (escribir(file, subredes, clase->subredes_inside, tamanio))
+            return -1;
+        subredes += tamanio;
+        tamanio = sizeof(struct puerto) * clase->cant_puertos_outside;
+        if (escribir(file, puertos, clase->puertos_outside, tamanio))
+            return -1;
+        puertos += tamanio;
+        tamanio = sizeof(struct puerto) * clase->cant_puertos_inside;
+        if (escribir(file, puertos, clase->puertos_inside, tamanio))
+            return -1;
+        puertos += tamanio;
+    }
+    return 0;
+}
+
+/*
+ * escribir_indice
+ * ---------------------------------------------------------------------------
+ *  Escribe los arrays de las cuatro dimensiones del indice.
+ */
+static int escribir_indice(FILE *file, const struct cabecera *cab,
+                           const struct indice *indice)
+{
+    const struct cabecera_subred *cs[] = {&(cab->subredes_outside),
+                                          &(cab->subredes_inside)};
+    const struct dimension_subred *ds[] = {&(indice->subredes_outside),
+                                           &(indice->subredes_inside)};
+    const struct cabecera_puerto *cp[] = {&(cab->puertos_outside),
+                                          &(cab->puertos_inside)};
+    const struct dimension_puerto *dp[] = {&(indice->puertos_outside),
+                                           &(indice->puertos_inside)};
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (escribir(file, cs[i]->nodos.inicio, ds[i]->nodos,
+                     cs[i]->nodos.tamanio) ||
+            escribir(file, cs[i]->clases.inicio, ds[i]->clases,
+                     cs[i]->clases.tamanio) ||
+            escribir(file, cs[i]->comodin.inicio, ds[i]->comodin,
+                     cs[i]->comodin.tamanio) ||
+            escribir(file, cp[i]->tablas.inicio, dp[i]->tablas,
+                     cp[i]->tablas.tamanio) ||
+            escribir(file, cp[i]->conjuntos.inicio, dp[i]->conjuntos,
+                     cp[i]->conjuntos.tamanio) ||
+            escribir(file, cp[i]->comodin.inicio, dp[i]->comodin,
+                     cp[i]->comodin.tamanio))
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * guardar_instantanea(archivo, firma, s_analizador)
+ * ---------------------------------------------------------------------------
+ *  Guarda las clases y el indice compilado del analizador en el archivo.
+ *
+ *  Se escribe un archivo temporal en el mismo directorio y luego se renombra,
+ *  por lo que el archivo anterior se reemplaza de forma atomica.
+ *
+ *  Devuelve 0 en caso de exito, -1 en caso de error.
+ */
+int guardar_instantanea(const char *archivo, u_int64_t firma,
+                        const struct s_analizador *analizador)
+{
+    const struct indice *indice = analizador->indice;
+    struct cabecera cab;
+    u_int64_t fin = sizeof(struct cabecera);
+    u_int64_t cant_subredes = 0, cant_puertos = 0;
+    char *temporal;
+    FILE *file;
+    int i, ret = -1;
+
+    if (indice == NULL || indice->cant_clases != analizador->cant_clases)
+        return -1;
+
+    /* ubico las secciones */
+    memset(&cab, 0, sizeof(struct cabecera));
+    memcpy(cab.magia, MAGIA_INSTANTANEA, sizeof(cab.magia));
+    cab.version = VERSION_INSTANTANEA;
+    cab.tamanio_clase = sizeof(struct clase);
+    cab.firma = firma;
+    cab.cant_clases = analizador->cant_clases;
+    cab.palabras = indice->palabras;
+    for (i = 0; i < analizador->cant_clases; i++) {
+        cant_subredes += analizador->clases[i].cant_subredes_outside +
+                         analizador->clases[i].cant_subredes_inside;
+        cant_puertos += analizador->clases[i].cant_puertos_outside +
+                        analizador->clases[i].cant_puertos_inside;
+    }
+    ubicar(&(cab.clases), sizeof(struct clase) * cab.cant_clases, &fin);
+    ubicar(&(cab.subredes), sizeof(struct subred) * cant_subredes, &fin);
+    ubicar(&(cab.puertos), sizeof(struct puerto) * cant_puertos, &fin);
+    ubicar_subred(&(cab.subredes_outside), &(indice->subredes_outside),
+                  indice->palabras, &fin);
+    ubicar_subred(&(cab.subredes_inside), &(indice->subredes_inside),
+                  indice->palabras, &fin);
+    ubicar_puerto(&(cab.puertos_outside), &(indice->puertos_outside),
+                  indice->palabras, &fin);
+    ubicar_puerto(&(cab.puertos_inside), &(indice->puertos_inside),
+                  indice->palabras, &fin);
+    cab.tamanio = fin;
+
+    /* escribo el archivo temporal */
+    temporal = malloc(strlen(archivo) + 5);
+    if (temporal == NULL)
+        return -1;
+    sprintf(temporal, "%s.tmp", archivo);
+    file = fopen(temporal, "wb");
+    if (file == NULL) {
+        syslog(LOG_ERR, "No se pudo crear la instantanea %s", temporal);
+        free(temporal);
+        return -1;
+    }
+    if (escribir(file, 0, &cab, sizeof(struct cabecera)) == 0 &&
+        escribir_clases(file, &cab, analizador) == 0 &&
+        escribir_indice(file, &cab, indice) == 0 &&
+        ftruncate(fileno(file), (off_t) cab.tamanio) == 0 &&
+        fflush(file) == 0)
+        ret = 0;
+    if (fclose(file) != 0)
+        ret = -1;
+    if (ret == 0 && rename(temporal, archivo) != 0)
+        ret = -1;
+    if (ret < 0) {
+        syslog(LOG_ERR, "No se pudo guardar la instantanea %s", archivo);
+        unlink(temporal);
+    }
+    free(temporal);
+    return ret;
+}
+
+/*
+ * seccion_valida
+ * ---------------------------------------------------------------------------
+ *  Devuelve 1 si la seccion esta dentro del archivo y tiene el tamaño
+ *  esperado.
+ */
+static int seccion_valida(const struct seccion *seccion, u_int64_t tamanio,
+                          u_int64_t tamanio_archivo)
+{
+    return seccion->tamanio == tamanio &&
+           seccion->inicio <= tamanio_archivo &&
+           seccion->tamanio <= tamanio_archivo - seccion->inicio;
+}
+
+/*
+ * conjuntos_validos
+ * ---------------------------------------------------------------------------
+ *  Devuelve 1 si ningun conjunto tiene bits de clases mayores o iguales a
+ *  *cant_clases* en la ultima palabra, 0 en caso contrario.
+ */
+static int conjuntos_validos(const u_int64_t *conjuntos, int cantidad,
+                             int palabras, int cant_clases)
+{
+    u_int64_t sobrantes = ~(u_int64_t) 0 << (cant_clases % BITS_PALABRA);
+    int i;
+    for (i = 0; i < cantidad; i++)
+        if (conjuntos[(size_t) i * palabras + palabras - 1] & sobrantes)
+            return 0;
+    return 1;
+}
+
+/*
+ * cargar_subred / cargar_puerto
+ * ---------------------------------------------------------------------------
+ *  Apuntan los arrays de una dimension del indice al archivo mapeado.
+ *  Devuelven -1 si las secciones no son validas.
+ */
+static int cargar_subred(struct dimension_subred *dim,
+                         const struct cabecera_subred *cab,
+                         char *memoria, u_int64_t tamanio, int palabras,
+                         int cant_clases)
+{
+    const struct nodo_trie *nodos;
+    const int *clases;
+    u_int64_t cant_posiciones;
+    int i;
+    if (cab->cant_nodos < 0 || cab->raiz < -1 ||
+        cab->raiz >= cab->cant_nodos ||
+        !seccion_valida(&(cab->nodos),
+                        sizeof(struct nodo_trie) * cab->cant_nodos,
+                        tamanio) ||
+        !seccion_valida(&(cab->clases), cab->clases.tamanio, tamanio) ||
+        !seccion_valida(&(cab->comodin), sizeof(u_int64_t) * palabras,
+                        tamanio))
+        return -1;
+    /* los nodos, las clases y los conjuntos se recorren sin comprobar
+     * posiciones al clasificar, por lo que se comprueban al cargarlos */
+    nodos = (const struct nodo_trie *) (memoria + cab->nodos.inicio);
+    clases = (const int *) (memoria + cab->clases.inicio);
+    cant_posiciones = cab->clases.tamanio / sizeof(int);
+    for (i = 0; i < cab->cant_nodos; i++) {
+        if (nodos[i].hijos[0] < -1 || nodos[i].hijos[1] < -1 ||
+            nodos[i].hijos[0] >= cab->cant_nodos ||
+            nodos[i].hijos[1] >= cab->cant_nodos ||
+            nodos[i].prefijo < 0 || nodos[i].prefijo > 32 ||
+            nodos[i].inicio < 0 || nodos[i].cantidad < 0 ||
+            (u_int64_t) nodos[i].inicio + nodos[i].cantidad >
+                cant_posiciones)
+            return -1;
+    }
+    for (i = 0; (u_int64_t) i < cant_posiciones; i++)
+        if (clases[i] < 0 || clases[i] >= cant_clases)
+            return -1;
+    if (!conjuntos_validos((const u_int64_t *) (memoria +
+                                                cab->comodin.inicio),
+                           1, palabras, cant_clases))
+        return -1;
+    dim->raiz = cab->raiz;
+    dim->cant_nodos = cab->cant_nodos;
+    dim->nodos = (struct nodo_trie *) (memoria + cab->nodos.inicio);
+    dim->clases = (int *) (memoria + cab->clases.inicio);
+    dim->comodin = (u_int64_t *) (memoria + cab->comodin.inicio);
+    return 0;
+}
+
+static int cargar_puerto(struct dimension_puerto *dim,
+                         const struct cabecera_puerto *cab,
+                         char *memoria, u_int64_t tamanio, int palabras,
+                         int cant_clases)
+{
+    const u_int16_t *tablas;
+    size_t i;
+    if (cab->cant_ranuras <= 0 || cab->cant_conjuntos <= 0 ||
+        !seccion_valida(&(cab->tablas),
+                        sizeof(u_int16_t) * CANT_PUERTOS * cab->cant_ranuras,
+                        tamanio) ||
+        !seccion_valida(&(cab->conjuntos),
+                        sizeof(u_int64_t) * palabras * cab->cant_conjuntos,
+                        tamanio) ||
+        !seccion_valida(&(cab->comodin), sizeof(u_int64_t) * palabras,
+                        tamanio))
+        return -1;
+    for (i = 0; i < CANT_PROTOCOLOS; i++)
+        if (cab->ranura[i] >= cab->cant_ranuras)
+            return -1;
+    tablas = (const u_int16_t *) (memoria + cab->tablas.inicio);
+    for (i = 0; i < (size_t) CANT_PUERTOS * cab->cant_ranuras; i++)
+        if (tablas[i] >= cab->cant_conjuntos)
+            return -1;
+    if (!conjuntos_validos((const u_int64_t *) (memoria +
+                                                cab->conjuntos.inicio),
+                           cab->cant_conjuntos, palabras, cant_clases) ||
+        !conjuntos_validos((const u_int64_t *) (memoria +
+                                                cab->comodin.inicio),
+                           1, palabras, cant_clases))
+        return -1;
+    dim->cant_ranuras = cab->cant_ranuras;
+    dim->cant_conjuntos = cab->cant_conjuntos;
+    memcpy(dim->ranura, cab->ranura, CANT_PROTOCOLOS);
+    dim->tablas = (u_int16_t *) (memoria + cab->tablas.inicio);
+    dim->conjuntos = (u_int64_t *) (memoria + cab->conjuntos.inicio);
+    dim->comodin = (u_int64_t *) (memoria + cab->comodin.inicio);
+    return 0;
+}
+
+/*
+ * cargar_clases
+ * ---------------------------------------------------------------------------
+ *  Apunta los arrays de subredes y puertos de cada clase al archivo mapeado.
+ *  Devuelve -1 si las clases no coinciden con las secciones del archivo.
+ */
+static int cargar_clases(struct clase *clases, const struct cabecera *cab,
+                         char *memoria)
+{
+    struct subred *subredes = (struct subred *) (memoria +
+                                                 cab->subredes.inicio);
+    struct puerto *puertos = (struct puerto *) (memoria +
+                                                cab->puertos.inicio);
+    u_int64_t cant_subredes = cab->subredes.tamanio / sizeof(struct subred);
+    u_int64_t cant_puertos = cab->puertos.tamanio / sizeof(struct puerto);
+    struct clase *clase;
+    int i;
+    for (i = 0; i < cab->cant_clases; i++) {
+        clase = clases + i;
+        if (clase->cant_subredes_outside < 0 ||
+            clase->cant_subredes_inside < 0 ||
+            clase->cant_puertos_outside < 0 ||
+            clase->cant_puertos_inside < 0 ||
+            (u_int64_t) clase->cant_subredes_outside +
+                clase->cant_subredes_inside > cant_subredes ||
+            (u_int64_t) clase->cant_puertos_outside +
+                clase->cant_puertos_inside > cant_puertos)
+            return -1;
+        clase->subredes_outside = subredes;
+        subredes += clase->cant_subredes_outside;
+        clase->subredes_inside = subredes;
+        subredes += clase->cant_subredes_inside;
+        cant_subredes -= clase->cant_subredes_outside +
+                         clase->cant_subredes_inside;
+        clase->puertos_outside = puertos;
+        puertos += clase->cant_puertos_outside;
+        clase->puertos_inside = puertos;
+        puertos += clase->cant_puertos_inside;
+        cant_puertos -= clase->cant_puertos_outside +
+                        clase->cant_puertos_inside;
+    }
+    return cant_subredes == 0 && cant_puertos == 0 ? 0 : -1;
+}
+
+/**
+ * cargar_instantanea(archivo, firma, s_analizador, instantanea)
+ * ---------------------------------------------------------------------------
+ *  Mapea el archivo en memoria de forma privada y apunta las clases y el
+ *  indice del analizador al archivo mapeado.
+ *
+ *  Devuelve 0 en caso de exito, -1 si el archivo no existe, no es valido o su
+ *  firma es distinta a la pasada por parametro.
+ */
+int cargar_instantanea(const char *archivo, u_int64_t firma,
+                       struct s_analizador *analizador,
+                       struct instantanea *instantanea)
+{
+    const struct cabecera *cab;
+    struct indice *indice;
+    struct stat st;
+    char *memoria;
+    u_int64_t tamanio;
+    int fd;
+
+    fd = open(archivo, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || (u_int64_t) st.st_size <
+            sizeof(struct cabecera)) {
+        close(fd);
+        return -1;
+    }
+    tamanio = st.st_size;
+    /* las paginas que se modifican (punteros y contadores de las clases) son
+     * privadas del proceso, el resto se comparte con el cache del sistema */
+    memoria = mmap(NULL, tamanio, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (memoria == MAP_FAILED)
+        return -1;
+    cab = (const struct cabecera *) memoria;
+    indice = calloc(1, sizeof(struct indice));
+    if (indice == NULL ||
+        memcmp(cab->magia, MAGIA_INSTANTANEA, sizeof(cab->magia)) != 0 ||
+        cab->version != VERSION_INSTANTANEA ||
+        cab->tamanio_clase != sizeof(struct clase) ||
+        cab->tamanio != tamanio ||
+        cab->firma != firma ||
+        cab->cant_clases <= 0 ||
+        cab->palabras != cab->cant_clases / BITS_PALABRA + 1 ||
+        !seccion_valida(&(cab->clases),
+                        sizeof(struct clase) * cab->cant_clases, tamanio) ||
+        !seccion_valida(&(cab->subredes), cab->subredes.tamanio, tamanio) ||
+        !seccion_valida(&(cab->puertos), cab->puertos.tamanio, tamanio) ||
+        cargar_subred(&(indice->subredes_outside), &(cab->subredes_outside),
+                      memoria, tamanio, cab->palabras, cab->cant_clases) ||
+        cargar_subred(&(indice->subredes_inside), &(cab->subredes_inside),
+                      memoria, tamanio, cab->palabras, cab->cant_clases) ||
+        cargar_puerto(&(indice->puertos_outside), &(cab->puertos_outside),
+                      memoria, tamanio, cab->palabras, cab->cant_clases) ||
+        cargar_puerto(&(indice->puertos_inside), &(cab->puertos_inside),
+                      memoria, tamanio, cab->palabras, cab->cant_clases) ||
+        cargar_clases((struct clase *) (memoria + cab->clases.inicio), cab,
+                      memoria)) {
+        syslog(LOG_INFO, "Se descarta la instantanea %s", archivo);
+        free(indice);
+        munmap(memoria, tamanio);
+        return -1;
+    }
+    indice->cant_clases = cab->cant_clases;
+    indice->palabras = cab->palabras;
+    indice->externo = 1;
+
+    /* reemplazo el indice del analizador */
+    free_indice(analizador->indice);
+    analizador->indice = indice;
+    analizador->clases = (struct clase *) (memoria + cab->clases.inicio);
+    analizador->cant_clases = cab->cant_clases;
+    invalidar_cache(analizador);
+    instantanea->memoria = memoria;
+    instantanea->tamanio = tamanio;
+    syslog(LOG_INFO,
+           "Se cargaron %d clases de la instantanea %s",
+           cab->cant_clases - 1,
+           archivo);
+    return 0;
+}
+
+/**
+ * cerrar_instantanea(s_analizador, instantanea)
+ * ---------------------------------------------------------------------------
+ *  Libera el indice del analizador y desmapea el archivo.
+ */
+void cerrar_instantanea(struct s_analizador *analizador,
+                        struct instantanea *instantanea)
+{
+    if (instantanea->memoria == NULL)
+        return;
+    free_indice(analizador->indice);
+    analizador->indice = NULL;
+    analizador->clases = NULL;
+    analizador->cant_clases = 0;
+    munmap(instantanea->memoria, instantanea->tamanio);
+    instantanea->memoria = NULL;
+    instantanea->tamanio = 0;
+}
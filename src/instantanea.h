@@ -0,0 +1,88 @@
+/**
+ * instantanea.h
+ * ==========================================================================
+ * Este modulo guarda las clases de trafico compiladas en un archivo binario
+ * (instantanea) y las vuelve a cargar sin consultar la base de datos.
+ *
+ * El archivo contiene las clases, sus subredes y puertos, y los arrays del
+ * indice compilado (ver indice.h) en el mismo formato que tienen en memoria.
+ * Al cargarlo se mapea en memoria y las clases y el indice apuntan
+ * directamente al archivo mapeado, por lo que no se copian ni se vuelven a
+ * compilar. Solo se modifican los punteros de las clases y sus contadores,
+ * que quedan en paginas privadas del proceso.
+ *
+ * La instantanea guarda una firma de las clases de la base de datos (ver
+ * obtener_firma_clases) y solo se carga si coincide con la firma actual. El
+ * formato depende de la arquitectura y de la version del programa, por lo
+ * que una instantanea de otra version se descarta y se vuelve a generar.
+ */
+#ifndef INSTANTANEA_H
+#define INSTANTANEA_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "analizador.h"
+
+#define MAGIA_INSTANTANEA "NETCOPCL" /* primeros 8 bytes del archivo */
+#define VERSION_INSTANTANEA 2 /* se incrementa al modificar el formato */
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct instantanea
+ * ---------------------------------------------------------------------------
+ * Instantanea cargada en memoria.
+ */
+struct instantanea {
+    void *memoria; /* archivo mapeado o NULL si no hay instantanea cargada */
+    size_t tamanio; /* tamaño del archivo mapeado */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * guardar_instantanea(archivo, firma, s_analizador)
+ * ---------------------------------------------------------------------------
+ *  Guarda las clases y el indice compilado del analizador en el archivo. Las
+ *  clases se deben compilar antes de guardarlas. El archivo se reemplaza de
+ *  forma atomica, por lo que otro proceso nunca lee una instantanea a medio
+ *  escribir.
+ *
+ *  Devuelve 0 en caso de exito, -1 en caso de error.
+ */
+int guardar_instantanea(const char *archivo, u_int64_t firma,
+                        const struct s_analizador *analizador);
+
+/**
+ * cargar_instantanea(archivo, firma, s_analizador, instantanea)
+ * ---------------------------------------------------------------------------
+ *  Carga las clases y el indice compilado del archivo en el analizador. La
+ *  memoria de las clases pertenece a la instantanea y se debe liberar con
+ *  cerrar_instantanea() en lugar de free_clases().
+ *
+ *  Antes de usar el archivo se comprueban las secciones y cada posicion del
+ *  indice que se usa al clasificar, por lo que un archivo corrupto no lleva
+ *  a accesos fuera de la memoria mapeada.
+ *
+ *  Devuelve 0 en caso de exito, -1 si el archivo no existe, no es valido o su
+ *  firma es distinta a la pasada por parametro.
+ */
+int cargar_instantanea(const char *archivo, u_int64_t firma,
+                       struct s_analizador *analizador,
+                       struct instantanea *instantanea);
+
+/**
+ * cerrar_instantanea(s_analizador, instantanea)
+ * ---------------------------------------------------------------------------
+ *  Libera el indice y las clases del analizador cargados de la instantanea.
+ */
+void cerrar_instantanea(struct s_analizador *analizador,
+                        struct instantanea *instantanea);
+
+#endif /* INSTANTANEA_H */
@@ -0,0 +1,148 @@
+#define _DEFAULT_SOURCE /* u_char de sys/types.h, usado por pcap.h */
+#include <time.h>
+#include <signal.h>
+#include <syslog.h>
+#include <pcap.h>
+#include "interfaz.h"
+
+/* interfaz que se esta capturando, para detenerla desde un manejador de
+ * señales */
+static pcap_t * volatile captura_activa;
+
+/* distinto de cero si se llamo a detener_captura() */
+static volatile sig_atomic_t detenida;
+
+/*
+ * struct captura_interfaz
+ * ---------------------------------------------------------------------------
+ * Datos que recibe procesar_trama() por cada trama capturada.
+ */
+struct captura_interfaz {
+    struct vivo *vivo;
+    int enlace; /* tipo de enlace de la interfaz */
+};
+
+/*
+ * procesar_trama
+ * ---------------------------------------------------------------------------
+ *  Agrega al analisis en vivo una trama entregada por pcap_dispatch(). La
+ *  trama apunta al buffer circular y se decodifica sin copiarla.
+ */
+static void procesar_trama(u_char *usuario,
+                           const struct pcap_pkthdr *cabecera,
+                           const u_char *trama)
+{
+    struct captura_interfaz *captura = (struct captura_interfaz *) usuario;
+    agregar_trama(captura->vivo, cabecera->ts.tv_sec, trama,
+                  cabecera->caplen, captura->enlace);
+}
+
+/*
+ * abrir_interfaz
+ * ---------------------------------------------------------------------------
+ *  Abre y activa la interfaz con el buffer y el filtro de captura.
+ *
+ *  Devuelve NULL en caso de error.
+ */
+static pcap_t* abrir_interfaz(const char *interfaz)
+{
+    char error[PCAP_ERRBUF_SIZE];
+    struct bpf_program filtro;
+    pcap_t *pcap;
+    int estado;
+
+    pcap = pcap_create(interfaz, error);
+    if (pcap == NULL) {
+        syslog(LOG_ERR, "No se pudo abrir la interfaz %s: %s", interfaz,
+               error);
+        return NULL;
+    }
+    pcap_set_snaplen(pcap, LARGO_CAPTURA);
+    pcap_set_promisc(pcap, 1);
+    pcap_set_timeout(pcap, ESPERA_CAPTURA);
+    pcap_set_buffer_size(pcap, BUFFER_CAPTURA);
+    estado = pcap_activate(pcap);
+    if (estado < 0) {
+        syslog(LOG_ERR, "No se pudo activar la interfaz %s: %s", interfaz,
+               pcap_geterr(pcap));
+        pcap_close(pcap);
+        return NULL;
+    }
+    if (estado > 0)
+        syslog(LOG_WARNING, "Interfaz %s: %s", interfaz, pcap_geterr(pcap));
+    /* sin el filtro se analizan igual los paquetes, pero en espacio de
+     * usuario */
+    if (pcap_compile(pcap, &filtro, FILTRO_CAPTURA, 1,
+                     PCAP_NETMASK_UNKNOWN) == 0) {
+        if (pcap_setfilter(pcap, &filtro) != 0)
+            syslog(LOG_WARNING, "No se pudo aplicar el filtro: %s",
+                   pcap_geterr(pcap));
+        pcap_freecode(&filtro);
+    }
+    return pcap;
+}
+
+/**
+ * capturar_interfaz(vivo, interfaz)
+ * ---------------------------------------------------------------------------
+ *  Lee los bloques del buffer circular a medida que se llenan o vence la
+ *  espera. Luego de cada lectura se avanza el reloj para cerrar el intervalo
+ *  si no llegaron tramas, y al cerrar un intervalo se informan las tramas
+ *  descartadas por falta de espacio en el buffer.
+ *
+ *  Devuelve 0 si se detuvo con detener_captura(), -1 si no se pudo abrir la
+ *  interfaz o si fallo la captura.
+ */
+int capturar_interfaz(struct vivo *vivo, const char *interfaz)
+{
+    struct captura_interfaz captura;
+    struct pcap_stat estadisticas;
+    pcap_t *pcap;
+    time_t fin;
+    int estado = -1, leidas;
+
+    pcap = abrir_interfaz(interfaz);
+    if (pcap == NULL)
+        return -1;
+    captura_activa = pcap;
+    captura.vivo = vivo;
+    captura.enlace = pcap_datalink(pcap);
+    syslog(LOG_INFO, "Capturando paquetes de %s", interfaz);
+    /* los intervalos empiezan aunque no se capturen tramas */
+    avanzar_reloj(vivo, time(NULL));
+    while (1) {
+        fin = vivo->fin;
+        leidas = pcap_dispatch(pcap, -1, procesar_trama, (u_char *) &captura);
+        /* pcap_breakloop() puede llegar antes o durante pcap_dispatch() */
+        if (detenida) {
+            estado = 0;
+            break;
+        }
+        if (leidas < 0) {
+            syslog(LOG_ERR, "Error al capturar de %s: %s", interfaz,
+                   pcap_geterr(pcap));
+            break;
+        }
+        avanzar_reloj(vivo, time(NULL));
+        if (fin != vivo->fin && pcap_stats(pcap, &estadisticas) == 0)
+            syslog(LOG_DEBUG, "Interfaz %s: %u tramas descartadas",
+                   interfaz, estadisticas.ps_drop);
+    }
+    captura_activa = NULL;
+    pcap_close(pcap);
+    return estado;
+}
+
+/**
+ * detener_captura()
+ * ---------------------------------------------------------------------------
+ *  pcap_breakloop() solo marca la captura para que pcap_dispatch() vuelva,
+ *  por lo que es seguro llamarla desde un manejador de señales.
+ */
+void detener_captura()
+{
+    pcap_t *pcap = captura_activa;
+    detenida = 1;
+    if (pcap != NULL)
+        pcap_breakloop(pcap);
+}
@@ -0,0 +1,56 @@
+/**
+ * interfaz.h
+ * ==========================================================================
+ * Este modulo captura los paquetes de una interfaz de red con libpcap y los
+ * clasifica en el proceso (ver vivo.h), en lugar de leerlos de la base de
+ * datos despues de que el capturador los inserta.
+ *
+ * En Linux libpcap recibe las tramas del kernel en un buffer circular
+ * compartido (PACKET_MMAP con TPACKET_V3 si el kernel lo soporta), por lo que
+ * las tramas no se copian al leerlas. Solo se capturan las cabeceras de los
+ * paquetes IPv4 y el kernel descarta el resto del trafico con un filtro BPF.
+ */
+#ifndef INTERFAZ_H
+#define INTERFAZ_H
+
+#include "vivo.h"
+
+#define LARGO_CAPTURA 128 /* bytes capturados de cada trama. Alcanzan para
+                           * las cabeceras de enlace, IPv4 con opciones y
+                           * los puertos TCP/UDP.
+                           */
+#define BUFFER_CAPTURA (64 * 1024 * 1024) /* tamaño del buffer circular del
+                                           * kernel en bytes.
+                                           */
+#define ESPERA_CAPTURA 100 /* milisegundos que se espera a que se llene un
+                            * bloque del buffer antes de leerlo.
+                            */
+#define FILTRO_CAPTURA "ip" /* filtro BPF de las tramas capturadas */
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * capturar_interfaz(vivo, interfaz)
+ * ---------------------------------------------------------------------------
+ *  Captura las tramas de la interfaz y las agrega al analisis en vivo. Los
+ *  totales se escriben al final de cada intervalo aunque no se capturen
+ *  tramas. No termina hasta que ocurre un error de captura o se llama a
+ *  detener_captura().
+ *
+ *  Devuelve 0 si se detuvo con detener_captura(), -1 si no se pudo abrir la
+ *  interfaz o si fallo la captura.
+ */
+int capturar_interfaz(struct vivo *vivo, const char *interfaz);
+
+/**
+ * detener_captura()
+ * ---------------------------------------------------------------------------
+ *  Hace que capturar_interfaz() termine luego de procesar las tramas ya
+ *  leidas. Se puede llamar desde un manejador de señales.
+ */
+void detener_captura();
+
+#endif /* INTERFAZ_H */
@@ -4,9 +4,18 @@
 #include <syslog.h>
 #include <time.h>
 #include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
 
 #include "bd.h"
 #include "analizador.h"
+#include "ventana.h"
+#include "instantanea.h"
+#include "recarga.h"
+#include "captura.h"
+#include "vivo.h"
+#include "interfaz.h"
+#include "metricas.h"
 
 #ifndef REVISION
 #define REVISION "DESCONOCIDA"
@@ -31,6 +40,13 @@
 #define DEFAULT_SEGUNDOS 60 /* cantidad de segundos a analizar en caso de que
                              * no se hayan definido parametros.
                              */
+#define DEFAULT_RED_LOCAL "192.168.0.0/16" /* red local para obtener la
+                                          * direccion de los paquetes de
+                                          * archivos de captura.
+                                          */
+#define DEFAULT_VENTANAS "60,300,3600" /* ventanas del modo demonio en
+                                        * segundos si no se configuran otras.
+                                        */
 
 /*
  * terminar()
@@ -55,6 +71,40 @@ void manejar_interrupciones();
  */
 static void argumentos(int argc, const char* argv[], struct s_analizador *cfg);
 
+/*
+ * demonio()
+ * ---------------------------------------------------------------------------
+ *  Analiza los paquetes nuevos cada *periodo* segundos e imprime los totales
+ *  de las ventanas deslizantes. Al recibir una interrupcion termina el tick
+ *  actual y luego el programa.
+ */
+static void demonio();
+
+/*
+ * cargar_clases()
+ * ---------------------------------------------------------------------------
+ *  Obtiene las clases de trafico compiladas de la instantanea si esta
+ *  actualizada, o de la base de datos en caso contrario. Devuelve la firma
+ *  de las clases.
+ */
+static u_int64_t cargar_clases();
+
+/*
+ * en_vivo()
+ * ---------------------------------------------------------------------------
+ *  Clasifica los paquetes capturados de una interfaz, o reproducidos de un
+ *  archivo de captura, e imprime los totales de cada intervalo.
+ */
+static void en_vivo();
+
+/*
+ * informar_metricas()
+ * ---------------------------------------------------------------------------
+ *  Escribe las metricas en la salida de errores en formato JSON y un resumen
+ *  en syslog, si se miden.
+ */
+static void informar_metricas();
+
 /*
  * Configuracion del analizador. Contiene el array de clases de trafico
  * instaladas y la configuracion para la seleccion de paquetes.
@@ -64,9 +114,68 @@ static void argumentos(int argc, const char* argv[], struct s_analizador *cfg);
  */
 static struct s_analizador analizador;
 
+/*
+ * Configuracion del modo demonio. Si el periodo es cero se analiza un solo
+ * intervalo y se termina el programa.
+ */
+static unsigned int periodo;
+static int segundos_ventanas[MAX_VENTANAS];
+static int cant_ventanas;
+/* totales de las ventanas deslizantes del modo demonio */
+static struct ventanas *ventanas;
+
+/*
+ * Archivo de la instantanea de clases compiladas. Si es NULL las clases
+ * siempre se obtienen de la base de datos.
+ */
+static const char *archivo_instantanea;
+static struct instantanea instantanea;
+
+/*
+ * Segundos entre revisiones de las clases de trafico de la base de datos. Si
+ * es cero las clases no se recargan.
+ */
+static unsigned int segundos_recarga;
+static struct recarga *recarga;
+
+/*
+ * Cantidad de conexiones con las que se obtienen en paralelo las partes del
+ * intervalo. Si es menor a dos se usa solo la conexion principal.
+ */
+static unsigned int particiones;
+
+/*
+ * Archivo o directorio de capturas pcap a analizar. Si es NULL los paquetes
+ * se obtienen de la base de datos.
+ */
+static const char *archivo_captura;
+static struct subred red_local;
+
+/*
+ * Interfaz de red de la que se capturan los paquetes en vivo. Si es NULL los
+ * paquetes se obtienen de la base de datos o del archivo de captura.
+ */
+static const char *interfaz_captura;
+
+/*
+ * Señal recibida o cero. El manejador de señales solo la registra y los
+ * modos que no terminan la revisan entre ticks o intervalos, para liberar
+ * los recursos fuera del manejador cuando ningun hilo analiza paquetes.
+ */
+static volatile sig_atomic_t interrupcion;
+/* estado del analisis por intervalos de la captura en vivo */
+static struct vivo *vivo;
+
+/*
+ * Si es distinto de cero se miden las etapas de la ejecucion y se escriben
+ * las metricas al terminar (ver metricas.h).
+ */
+static int medir_metricas;
+
 int main(int argc, const char *argv[])
 {
     int cantidad_paquetes;
+    u_int64_t aciertos, fallos, firma, reloj;
     /* Inicializo logs */
     openlog(PROGRAM, LOG_CONS | LOG_PID, LOG_LOCAL0);
     /* Muestro informacion del build */
@@ -77,16 +186,84 @@ int main(int argc, const char *argv[])
      * liberar recursos. */
     manejar_interrupciones();
     /* Conecto base de datos */
-    bd_conectar();
-    /* obtengo clases */
-    if (obtener_clases(&analizador) < 0) {
-        fprintf(stderr, "Error al obtener las clases de trafico\n");
+    if (bd_conectar() != 0) {
+        fprintf(stderr, "Error al conectar con la base de datos\n");
+        exit(EXIT_FAILURE);
+    }
+    if (particiones > 1 && archivo_captura == NULL &&
+            interfaz_captura == NULL)
+        bd_conectar_particiones(particiones);
+    /* las metricas se crean antes de obtener las clases para medirlo */
+    if (medir_metricas) {
+        analizador.metricas = crear_metricas(0);
+        if (analizador.metricas == NULL) {
+            fprintf(stderr, "Error al crear las metricas\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    /* obtengo clases compiladas */
+    reloj = iniciar_etapa(analizador.metricas);
+    firma = cargar_clases();
+    terminar_etapa(analizador.metricas, ETAPA_CLASES, reloj);
+    if (analizador.metricas != NULL &&
+            reiniciar_clases_metricas(analizador.metricas,
+                                      analizador.cant_clases) < 0) {
+        fprintf(stderr, "Error al crear las metricas\n");
+        exit(EXIT_FAILURE);
+    }
+    /* creo contadores por hilo */
+    if (iniciar_contadores(&analizador) < 0) {
+        fprintf(stderr, "Error al crear los contadores de bytes\n");
         exit(EXIT_FAILURE);
     }
+    /* creo cache de flujos por hilo */
+    if (iniciar_cache(&analizador) < 0) {
+        fprintf(stderr, "Error al crear la cache de flujos\n");
+        exit(EXIT_FAILURE);
+    }
+    /* los modos que no terminan recargan las clases cuando cambian */
+    if (segundos_recarga > 0 && (periodo > 0 || interfaz_captura != NULL)) {
+        recarga = crear_recarga(&analizador,
+                                instantanea.memoria != NULL ?
+                                &instantanea : NULL,
+                                firma, segundos_recarga,
+                                obtener_firma_clases, obtener_clases,
+                                archivo_instantanea);
+        if (recarga == NULL) {
+            fprintf(stderr, "Error al crear la recarga de clases\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    /* la captura en vivo, o su reproduccion, analiza por intervalos */
+    if (interfaz_captura != NULL || (archivo_captura != NULL && periodo > 0))
+        en_vivo();
+    /* en modo demonio se analizan los paquetes nuevos periodicamente */
+    if (periodo > 0)
+        demonio();
     /* analizo paquetes */
-    cantidad_paquetes = obtener_paquetes(&analizador, analizar_paquete);
+    reloj = iniciar_etapa(analizador.metricas);
+    if (archivo_captura != NULL) {
+        cantidad_paquetes = analizar_captura(&analizador, archivo_captura,
+                                             &red_local, analizar_paquete);
+        if (cantidad_paquetes < 0) {
+            fprintf(stderr, "Error al leer la captura %s\n",
+                    archivo_captura);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        cantidad_paquetes = obtener_paquetes(&analizador, analizar_paquete);
+        /* el resultado incompleto no se imprime */
+        if (cantidad_paquetes < 0) {
+            fprintf(stderr, "Error al obtener los paquetes\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    reducir_contadores(&analizador);
+    terminar_etapa(analizador.metricas, ETAPA_ANALISIS, reloj);
     /* imprimo resultado */
+    reloj = iniciar_etapa(analizador.metricas);
     imprimir(&analizador);
+    terminar_etapa(analizador.metricas, ETAPA_ESCRITURA, reloj);
 
 #ifdef DEBUG
     printf("Se analizaron %d paquetes con %d clases\n",
@@ -98,10 +275,190 @@ int main(int argc, const char *argv[])
            "Se analizaron %d paquetes con %d clases",
            cantidad_paquetes,
            analizador.cant_clases);
+    estadisticas_cache(&analizador, &aciertos, &fallos);
+    syslog(LOG_DEBUG,
+           "Cache de flujos: %" PRIu64 " aciertos, %" PRIu64 " fallos",
+           aciertos,
+           fallos);
     terminar();
     return EXIT_SUCCESS;
 }
 
+/*
+ * cargar_clases()
+ * ---------------------------------------------------------------------------
+ *  Si se configuro una instantanea y su firma coincide con la de las clases
+ *  de la base de datos, se cargan las clases compiladas de la instantanea.
+ *  Caso contrario se obtienen las clases de la base de datos, se compilan y
+ *  se actualiza la instantanea para la siguiente ejecucion.
+ *
+ *  Devuelve la firma de las clases, o cero si no se necesita porque no hay
+ *  instantanea ni recarga de clases.
+ */
+static u_int64_t cargar_clases()
+{
+    u_int64_t firma = 0;
+    if (archivo_instantanea != NULL || segundos_recarga > 0)
+        firma = obtener_firma_clases();
+    if (archivo_instantanea != NULL &&
+            cargar_instantanea(archivo_instantanea, firma, &analizador,
+                               &instantanea) == 0)
+        return firma;
+    /* obtengo clases */
+    if (obtener_clases(&analizador) < 0) {
+        fprintf(stderr, "Error al obtener las clases de trafico\n");
+        exit(EXIT_FAILURE);
+    }
+    /* compilo clases */
+    if (compilar_clases(&analizador) < 0) {
+        fprintf(stderr, "Error al compilar las clases de trafico\n");
+        exit(EXIT_FAILURE);
+    }
+    /* actualizo la instantanea, si falla solo se pierde la optimizacion */
+    if (archivo_instantanea != NULL &&
+            guardar_instantanea(archivo_instantanea, firma, &analizador) == 0)
+        syslog(LOG_INFO, "Se actualizo la instantanea %s",
+               archivo_instantanea);
+    return firma;
+}
+
+/*
+ * demonio()
+ * ---------------------------------------------------------------------------
+ *  Analiza los paquetes nuevos cada *periodo* segundos. La conexion con la
+ *  base de datos y las clases compiladas se mantienen entre ticks y cada tick
+ *  solo obtiene los paquetes capturados luego del tick anterior (ver
+ *  avanzar_marca).
+ *
+ *  Los bytes de cada tick se agregan a las ventanas deslizantes, que se
+ *  imprimen en la salida estandar al final del tick. Si no se obtuvieron
+ *  todos los paquetes del tick se descartan sus bytes, la marca no avanza y
+ *  el siguiente tick vuelve a obtener el intervalo. Los errores de la base
+ *  de datos no terminan el demonio: se reconecta si se perdio la conexion y
+ *  se reintenta en el siguiente tick. Entre dos ticks ningun hilo analiza
+ *  paquetes, por lo que ahi se instalan las clases recargadas.
+ */
+static void demonio()
+{
+    time_t siguiente = time(NULL);
+    time_t ahora;
+    u_int64_t reloj;
+    int cantidad_paquetes, nuevos;
+    ventanas = crear_ventanas(analizador.cant_clases, periodo,
+                              segundos_ventanas, cant_ventanas);
+    if (ventanas == NULL) {
+        fprintf(stderr, "Error al crear las ventanas deslizantes\n");
+        exit(EXIT_FAILURE);
+    }
+    /* la primer marca es el ultimo paquete capturado. Si no se obtiene, se
+     * vuelve a buscar en el primer tick */
+    analizador.inicio[0] = '\0';
+    analizador.fin[0] = '\0';
+    if (avanzar_marca(&analizador) < 0)
+        bd_reconectar();
+    syslog(LOG_INFO, "Modo demonio iniciado con ticks de %u segundos",
+           periodo);
+    while (!interrupcion) {
+        /* espero al siguiente tick, la interrupcion corta la espera */
+        siguiente += periodo;
+        ahora = time(NULL);
+        if (siguiente > ahora)
+            sleep(siguiente - ahora);
+        if (interrupcion)
+            break;
+        /* analizo los paquetes nuevos */
+        cantidad_paquetes = 0;
+        reloj = iniciar_etapa(analizador.metricas);
+        nuevos = avanzar_marca(&analizador);
+        if (nuevos > 0) {
+            cantidad_paquetes = obtener_paquetes(&analizador,
+                                                 analizar_paquete);
+            reducir_contadores(&analizador);
+        }
+        terminar_etapa(analizador.metricas, ETAPA_ANALISIS, reloj);
+        if (nuevos < 0 || cantidad_paquetes < 0) {
+            /* descarto el tick y el siguiente vuelve a obtener el mismo
+             * intervalo desde la marca */
+            syslog(LOG_WARNING, "Se descarto el tick hasta %s, se "
+                   "reintentara en el siguiente", analizador.fin);
+            descartar_contadores(&analizador);
+            strcpy(analizador.fin, analizador.inicio);
+            if (bd_reconectar() < 0)
+                syslog(LOG_ERR, "No se pudo reconectar con la base de "
+                       "datos, se reintentara en el siguiente tick");
+            continue;
+        }
+        avanzar_ventanas(ventanas, analizador.clases);
+        /* imprimo resultado */
+        reloj = iniciar_etapa(analizador.metricas);
+        ventanas_to_file(stdout, ventanas, analizador.clases);
+        fflush(stdout);
+        terminar_etapa(analizador.metricas, ETAPA_ESCRITURA, reloj);
+        /* las metricas se acumulan desde el inicio del demonio */
+        informar_metricas();
+        syslog(LOG_DEBUG,
+               "Se analizaron %d paquetes hasta %s",
+               cantidad_paquetes,
+               analizador.fin);
+        /* las clases nuevas se usan desde el siguiente tick */
+        if (recarga != NULL) {
+            revisar_clases(recarga, time(NULL));
+            instalar_recarga(recarga, &analizador, ventanas);
+        }
+    }
+    terminar();
+}
+
+/*
+ * en_vivo()
+ * ---------------------------------------------------------------------------
+ *  Clasifica los paquetes a medida que se capturan de la interfaz, sin
+ *  pasar por la base de datos, e imprime los totales de las clases al final
+ *  de cada intervalo de *periodo* segundos (o DEFAULT_SEGUNDOS si no se
+ *  configuro). Con un archivo de captura los intervalos se calculan con la
+ *  marca de tiempo de los paquetes, lo que permite probar la captura en vivo
+ *  sin una interfaz.
+ */
+static void en_vivo()
+{
+    unsigned int intervalo = periodo > 0 ? periodo : DEFAULT_SEGUNDOS;
+    vivo = crear_vivo(&analizador, &red_local, intervalo, stdout,
+                      analizar_paquete);
+    if (vivo == NULL) {
+        fprintf(stderr, "Error al crear el analisis en vivo\n");
+        exit(EXIT_FAILURE);
+    }
+    vivo->recarga = recarga;
+    if (interfaz_captura != NULL) {
+        /* solo termina en caso de error o de interrupcion */
+        if (capturar_interfaz(vivo, interfaz_captura) < 0) {
+            fprintf(stderr, "Error al capturar de %s\n", interfaz_captura);
+            exit(EXIT_FAILURE);
+        }
+        terminar();
+    }
+    if (reproducir_captura(vivo, archivo_captura) < 0) {
+        fprintf(stderr, "Error al leer la captura %s\n", archivo_captura);
+        exit(EXIT_FAILURE);
+    }
+    terminar();
+}
+
+/*
+ * informar_metricas()
+ * ---------------------------------------------------------------------------
+ *  Escribe las metricas en la salida de errores, para no mezclarlas con el
+ *  JSON de las clases de la salida estandar, y un resumen en syslog.
+ */
+static void informar_metricas()
+{
+    if (analizador.metricas == NULL)
+        return;
+    metricas_to_file(stderr, analizador.metricas, &analizador);
+    fflush(stderr);
+    metricas_syslog(analizador.metricas);
+}
+
 /*
  * terminar()
  * ---------------------------------------------------------------------------
@@ -109,23 +466,47 @@ int main(int argc, const char *argv[])
  */
 static void terminar()
 {
+    if (interrupcion)
+        syslog(LOG_WARNING, "Interrupción recibida %d", interrupcion);
+    /* el modo demonio informa las metricas en cada tick */
+    if (periodo == 0 || interfaz_captura != NULL || archivo_captura != NULL)
+        informar_metricas();
     bd_desconectar();
     closelog();
-    for(int i = 0; i < analizador.cant_clases; i++)
-        free_clase(analizador.clases + i);
-    free(analizador.clases);
+    free_ventanas(ventanas);
+    free_vivo(vivo);
+    if (recarga != NULL) {
+        /* las clases pertenecen a la recarga */
+        free_recarga(recarga, &analizador);
+    } else if (instantanea.memoria != NULL) {
+        /* las clases pertenecen a la instantanea */
+        cerrar_instantanea(&analizador, &instantanea);
+    } else {
+        /* las subredes y puertos estan en el bloque de las clases */
+        free_clases(analizador.clases);
+    }
+    free_analizador(&analizador);
+    free_metricas(analizador.metricas);
+    analizador.metricas = NULL;
     exit(EXIT_SUCCESS);
 }
 
 /*
  * handle
  * --------------------------------------------------------------------------
- * Maneja interrupciones
+ * Maneja interrupciones. Solo usa funciones seguras dentro de un manejador
+ * de señales: registra la señal y detiene la captura de la interfaz, y el
+ * programa termina con terminar() al volver al ciclo del modo demonio o de la
+ * captura. Los analisis de un solo intervalo terminan al imprimir el
+ * resultado. Una segunda interrupcion termina el programa sin esperar.
  */
 static void handle (int signum)
 {
-    syslog(LOG_WARNING, "Interrupción recibida %d\n", signum);
-    terminar();
+    if (interrupcion)
+        _exit(EXIT_FAILURE);
+    interrupcion = signum;
+    if (interfaz_captura != NULL)
+        detener_captura();
 }
 
 /*
@@ -147,7 +528,7 @@ void manejar_interrupciones()
  *  Muestra mensaje de ayuda
  */
 static void ayuda() {
-    printf("Uso: %s [-h] | [-v] | [segundos] | [inicio fin]\n\n"
+    printf("Uso: %s [-h] | [-v] | [opciones] [segundos | inicio fin]\n\n"
            "Este programa compara las clases de trafico intaladas con "
            "los paquetes capturados en un intervalo de tiempo especifico. "
            "Si no se especifica ningun parametro, se analizaran los paquetes "
@@ -160,9 +541,157 @@ static void ayuda() {
                                      "analizarán los paquetes\n"
            "  inicio fin             Intervalo de tiempo en los que se "
                                      "analizaran los paquetes en formato "
-                                     "ISO8601."
+                                     "ISO8601.\n"
+           "\n"
+           "Opciones:\n"
+           "  -l, --lote N           Cantidad de paquetes que se obtienen "
+                                     "de la base de datos por lote "
+                                     "(por defecto %u).\n"
+           "  -g, --agrupar          Agrupa los paquetes por flujo en la "
+                                     "base de datos y analiza cada flujo "
+                                     "una sola vez.\n"
+           "  -b, --binario          Obtiene los paquetes de la base de "
+                                     "datos con COPY binario en lugar de "
+                                     "un cursor.\n"
+           "  -p, --particiones N    Divide el intervalo en N partes que "
+                                     "se obtienen en paralelo, cada una "
+                                     "con su propia conexion y COPY "
+                                     "binario.\n"
+           "  -d, --demonio N        No termina y cada N segundos analiza "
+                                     "los paquetes nuevos e imprime los "
+                                     "totales de las ventanas.\n"
+           "  -w, --ventanas LISTA   Duracion en segundos de las ventanas "
+                                     "del modo demonio separadas por coma "
+                                     "(por defecto %s).\n"
+           "  -a, --archivo RUTA     Analiza los paquetes de un archivo "
+                                     "pcap o pcapng, o de todos los archivos "
+                                     "de un directorio, en lugar de la base "
+                                     "de datos.\n"
+           "  -r, --red-local CIDR   Red local para obtener la direccion "
+                                     "de los paquetes de los archivos "
+                                     "(por defecto %s).\n"
+           "  -c, --capturar INTERFAZ\n"
+           "                         Captura los paquetes de la interfaz y "
+                                     "los clasifica sin la base de datos. "
+                                     "Imprime los totales cada N segundos "
+                                     "de -d (por defecto %u). Con -a y -d "
+                                     "reproduce el archivo de la misma "
+                                     "forma.\n"
+           "  -i, --instantanea ARCHIVO\n"
+           "                         Guarda las clases compiladas en el "
+                                     "archivo y las carga de alli mientras "
+                                     "no cambien en la base de datos.\n"
+           "  -n, --recargar N       Con -d o -c revisa cada N segundos si "
+                                     "cambiaron las clases en la base de "
+                                     "datos y las recarga sin reiniciar.\n"
+           "  -m, --metricas         Mide el tiempo de cada etapa, las "
+                                     "filas por segundo y las comparaciones "
+                                     "por clase, y las escribe en JSON en "
+                                     "la salida de errores y en syslog.\n"
            "\n%s\n"
-           , PROGRAM, DEFAULT_SEGUNDOS, COPYLEFT);
+           , PROGRAM, DEFAULT_SEGUNDOS, TAMANIO_LOTE, DEFAULT_VENTANAS,
+           DEFAULT_RED_LOCAL, DEFAULT_SEGUNDOS, COPYLEFT);
+}
+
+/*
+ * es_opcion()
+ * --------------------------------------------------------------------------
+ *  Devuelve 1 si el argumento es la opcion corta o la opcion larga.
+ */
+static int es_opcion(const char *arg, const char *corta, const char *larga)
+{
+    return strncmp(arg, corta, ARGV_LENGHT) == 0 ||
+           strncmp(arg, larga, ARGV_LENGHT) == 0;
+}
+
+/*
+ * valor_numerico()
+ * --------------------------------------------------------------------------
+ *  Obtiene el valor numerico positivo de la opcion que esta en la posicion
+ *  *i* de argv y avanza *i* al valor. Termina el programa si el valor no es
+ *  valido.
+ */
+static unsigned int valor_numerico(int argc, const char* argv[], int *i)
+{
+    unsigned int valor;
+    if (*i + 1 >= argc || sscanf(argv[*i + 1], "%u", &valor) != 1 ||
+            valor == 0) {
+        fprintf(stderr, "%s: Se esperaba un valor numerico\n", argv[*i]);
+        ayuda();
+        exit(EXIT_FAILURE);
+    }
+    (*i)++;
+    return valor;
+}
+
+/*
+ * lista_ventanas()
+ * --------------------------------------------------------------------------
+ *  Obtiene la duracion de las ventanas del modo demonio de una lista de
+ *  segundos separados por coma. Termina el programa si la lista no es valida.
+ */
+static void lista_ventanas(const char *valor)
+{
+    const char *lista = valor;
+    int consumidos;
+    cant_ventanas = 0;
+    while (cant_ventanas < MAX_VENTANAS &&
+           sscanf(lista, "%d%n", segundos_ventanas + cant_ventanas,
+                  &consumidos) == 1 &&
+           segundos_ventanas[cant_ventanas] > 0) {
+        cant_ventanas++;
+        lista += consumidos;
+        /* una coma final queda sin consumir y la lista no es valida */
+        if (*lista != ',' || lista[1] == '\0')
+            break;
+        lista++;
+    }
+    if (cant_ventanas == 0 || *lista != '\0') {
+        fprintf(stderr, "%s: Lista de ventanas no valida\n", valor);
+        ayuda();
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * valor_texto()
+ * --------------------------------------------------------------------------
+ *  Obtiene el valor de la opcion que esta en la posicion *i* de argv y avanza
+ *  *i* al valor. Termina el programa si falta el valor.
+ */
+static const char* valor_texto(int argc, const char* argv[], int *i)
+{
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "%s: Se esperaba un valor\n", argv[*i]);
+        ayuda();
+        exit(EXIT_FAILURE);
+    }
+    (*i)++;
+    return argv[*i];
+}
+
+/*
+ * cidr()
+ * --------------------------------------------------------------------------
+ *  Obtiene la subred de una cadena en formato direccion/prefijo. Termina el
+ *  programa si la cadena no es valida.
+ */
+static void cidr(const char *valor, struct subred *subred)
+{
+    char direccion[INET_ADDRSTRLEN];
+    int bits;
+    if (sscanf(valor, "%15[0-9.]/%d", direccion, &bits) != 2 ||
+            bits < 0 || bits > 32 ||
+            inet_pton(AF_INET, direccion, &(subred->red)) != 1) {
+        fprintf(stderr, "%s: Red no valida\n", valor);
+        ayuda();
+        exit(EXIT_FAILURE);
+    }
+    subred->mascara = bits == 32 ? MASCARA_HOST :
+                      bits == 0 ? 0 :
+                      GET_MASCARA(bits);
+    subred->red.s_addr &= subred->mascara;
+    subred->prefijo = bits;
 }
 
 /*
@@ -174,6 +703,18 @@ static void ayuda() {
  *  ### Posibles parametros
  *   * -h --help
  *   * -v --version
+ *   * -l --lote: cantidad de paquetes por lote
+ *   * -g --agrupar: agrupa los paquetes por flujo en la base de datos
+ *   * -b --binario: obtiene los paquetes con COPY binario
+ *   * -p --particiones: conexiones con las que se obtiene el intervalo
+ *   * -d --demonio: periodo en segundos del modo demonio
+ *   * -w --ventanas: duracion de las ventanas del modo demonio
+ *   * -i --instantanea: archivo de instantanea de clases compiladas
+ *   * -n --recargar: segundos entre revisiones de las clases
+ *   * -a --archivo: archivo o directorio de capturas pcap
+ *   * -r --red-local: red local de las capturas
+ *   * -c --capturar: interfaz de la captura en vivo
+ *   * -m --metricas: mide las etapas de la ejecucion
  *   * sin parametros: analiza los paquetes recibidos luego de DEFAULT_SEGUNDOS
  *   * un parametro numerico: se crea intervalo entre la cantidad segundos
  *                            pasada por parametro y el tiempo actual
@@ -182,37 +723,99 @@ static void ayuda() {
 static void argumentos(int argc, const char* argv[], struct s_analizador *cfg)
 {
     unsigned int aux;
+    const char *posicionales[2]; /* parametros que no son opciones */
+    int cant_posicionales = 0;
     /* inicio los valores por defecto */
     memset(cfg, 0, sizeof(struct s_analizador));
     cfg->tiempo_inicio = time(NULL) - DEFAULT_SEGUNDOS;
     cfg->tiempo_fin = time(NULL);
-    if (argc == 2) {
+    lista_ventanas(DEFAULT_VENTANAS);
+    cidr(DEFAULT_RED_LOCAL, &red_local);
+    for (int i = 1; i < argc; i++) {
         /* -h --help */
-        if(strncmp(argv[1], "-h", ARGV_LENGHT) == 0 ||
-                strncmp(argv[1], "--help", ARGV_LENGHT) == 0) {
+        if (es_opcion(argv[i], "-h", "--help")) {
             ayuda();
             exit(EXIT_SUCCESS);
         }
-
         /* -v --version */
-        if(strncmp(argv[1], "-v", ARGV_LENGHT) == 0 ||
-                strncmp(argv[1], "--version", ARGV_LENGHT) == 0) {
+        else if (es_opcion(argv[i], "-v", "--version")) {
             printf("%s - %s - %s\n", PROGRAM, REVISION, BUILD_MODE);
             exit(EXIT_SUCCESS);
         }
+        /* -l --lote */
+        else if (es_opcion(argv[i], "-l", "--lote")) {
+            cfg->tamanio_lote = valor_numerico(argc, argv, &i);
+        }
+        /* -g --agrupar */
+        else if (es_opcion(argv[i], "-g", "--agrupar")) {
+            cfg->agrupar = 1;
+        }
+        /* -b --binario */
+        else if (es_opcion(argv[i], "-b", "--binario")) {
+            cfg->copia = 1;
+        }
+        /* -p --particiones */
+        else if (es_opcion(argv[i], "-p", "--particiones")) {
+            particiones = valor_numerico(argc, argv, &i);
+        }
+        /* -d --demonio */
+        else if (es_opcion(argv[i], "-d", "--demonio")) {
+            periodo = valor_numerico(argc, argv, &i);
+        }
+        /* -w --ventanas */
+        else if (es_opcion(argv[i], "-w", "--ventanas")) {
+            lista_ventanas(valor_texto(argc, argv, &i));
+        }
+        /* -i --instantanea */
+        else if (es_opcion(argv[i], "-i", "--instantanea")) {
+            archivo_instantanea = valor_texto(argc, argv, &i);
+        }
+        /* -n --recargar */
+        else if (es_opcion(argv[i], "-n", "--recargar")) {
+            segundos_recarga = valor_numerico(argc, argv, &i);
+        }
+        /* -a --archivo */
+        else if (es_opcion(argv[i], "-a", "--archivo")) {
+            archivo_captura = valor_texto(argc, argv, &i);
+        }
+        /* -r --red-local */
+        else if (es_opcion(argv[i], "-r", "--red-local")) {
+            cidr(valor_texto(argc, argv, &i), &red_local);
+        }
+        /* -c --capturar */
+        else if (es_opcion(argv[i], "-c", "--capturar")) {
+            interfaz_captura = valor_texto(argc, argv, &i);
+        }
+        /* -m --metricas */
+        else if (es_opcion(argv[i], "-m", "--metricas")) {
+            medir_metricas = 1;
+        }
+        else if (cant_posicionales < 2) {
+            posicionales[cant_posicionales++] = argv[i];
+        }
+        else {
+            ayuda();
+        }
+    }
 
+    if (interfaz_captura != NULL && archivo_captura != NULL) {
+        fprintf(stderr, "No se puede capturar de una interfaz y un archivo "
+                        "al mismo tiempo\n");
+        ayuda();
+        exit(EXIT_FAILURE);
+    }
+
+    if (cant_posicionales == 1) {
         /* cantidad de segundos a analizar */
-        if(sscanf(argv[1], "%u", &(aux)) != 1) {
-            fprintf(stderr, "%s: Parámetro desconocido\n", argv[1]);
+        if(sscanf(posicionales[0], "%u", &(aux)) != 1) {
+            fprintf(stderr, "%s: Parámetro desconocido\n", posicionales[0]);
             ayuda();
             exit(EXIT_FAILURE);
         }
         cfg->tiempo_inicio = time(NULL) - aux;
-    } else if (argc == 3) {
+    } else if (cant_posicionales == 2) {
         /* intervalo ISO8601 */
-        strncpy(cfg->inicio, argv[1], LEN_ISO8601);
-        strncpy(cfg->fin, argv[2], LEN_ISO8601);
-    } else if (argc > 3) {
-        ayuda();
+        strncpy(cfg->inicio, posicionales[0], LEN_ISO8601);
+        strncpy(cfg->fin, posicionales[1], LEN_ISO8601);
     }
 }
@@ -0,0 +1,348 @@
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/resource.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "metricas.h"
+
+#ifdef _OPENMP
+#define HILO_ACTUAL omp_get_thread_num()
+#define MAX_HILOS omp_get_max_threads()
+#else
+#define HILO_ACTUAL 0
+#define MAX_HILOS 1
+#endif
+
+/* nombres de las etapas en el JSON y en syslog */
+static const char *nombres_etapas[CANT_ETAPAS] = {
+    "clases", "analisis", "obtencion", "conversion", "clasificacion",
+    "escritura"
+};
+
+/*
+ * segundos
+ * ---------------------------------------------------------------------------
+ *  Convierte nanosegundos a segundos.
+ */
+static double segundos(u_int64_t nanosegundos)
+{
+    return nanosegundos / 1e9;
+}
+
+/*
+ * memoria_maxima
+ * ---------------------------------------------------------------------------
+ *  Devuelve la memoria residente maxima del proceso en kilobytes, o cero si
+ *  no se puede obtener.
+ */
+static long memoria_maxima()
+{
+    struct rusage uso;
+    if (getrusage(RUSAGE_SELF, &uso) < 0)
+        return 0;
+    return uso.ru_maxrss;
+}
+
+/*
+ * clasificados
+ * ---------------------------------------------------------------------------
+ *  Obtiene los paquetes y el tiempo de clasificacion de todos los hilos, y
+ *  el mayor de los paquetes de un hilo.
+ */
+static void clasificados(const struct metricas *metricas,
+                         u_int64_t *paquetes, u_int64_t *nanosegundos,
+                         u_int64_t *maximo)
+{
+    int i;
+    *paquetes = 0;
+    *nanosegundos = 0;
+    *maximo = 0;
+    for (i = 0; i < metricas->cant_hilos; i++) {
+        *paquetes += metricas->hilos[i].paquetes;
+        *nanosegundos += metricas->hilos[i].nanosegundos;
+        if (metricas->hilos[i].paquetes > *maximo)
+            *maximo = metricas->hilos[i].paquetes;
+    }
+}
+
+/*
+ * desbalance
+ * ---------------------------------------------------------------------------
+ *  Devuelve la relacion entre los paquetes del hilo que mas clasifico y el
+ *  promedio de todos los hilos: 1 si todos clasificaron lo mismo y la
+ *  cantidad de hilos si uno solo clasifico todo.
+ */
+static double desbalance(const struct metricas *metricas, u_int64_t paquetes,
+                         u_int64_t maximo)
+{
+    if (paquetes == 0)
+        return 1;
+    return (double) maximo * metricas->cant_hilos / paquetes;
+}
+
+/**
+ * crear_metricas(cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Las metricas de los hilos se alinean al inicio de una linea de cache.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct metricas* crear_metricas(int cant_clases)
+{
+    struct metricas *metricas = calloc(1, sizeof(struct metricas));
+    if (metricas == NULL)
+        return NULL;
+    metricas->cant_hilos = MAX_HILOS;
+    metricas->memoria_hilos = calloc(1, sizeof(struct metrica_hilo) *
+                                        metricas->cant_hilos + LINEA_CACHE);
+    if (metricas->memoria_hilos == NULL ||
+            reiniciar_clases_metricas(metricas, cant_clases) < 0) {
+        free_metricas(metricas);
+        return NULL;
+    }
+    metricas->hilos = (struct metrica_hilo *)
+        (((uintptr_t) metricas->memoria_hilos + LINEA_CACHE - 1) &
+         ~(uintptr_t) (LINEA_CACHE - 1));
+    metricas->inicio = reloj_metricas();
+    return metricas;
+}
+
+/**
+ * reiniciar_clases_metricas(metricas, cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Las comparaciones de cada hilo ocupan lineas de cache completas, igual
+ *  que los contadores de bytes (ver iniciar_contadores). Como struct
+ *  metrica_clase solo tiene contadores de 64 bits, cualquier multiplo de
+ *  LINEA_CACHE / 8 clases ocupa lineas completas.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int reiniciar_clases_metricas(struct metricas *metricas, int cant_clases)
+{
+    int por_linea = LINEA_CACHE / sizeof(u_int64_t);
+    int por_hilo = (cant_clases + por_linea - 1) / por_linea * por_linea;
+    free(metricas->clases);
+    metricas->cant_clases = 0;
+    metricas->clases = calloc((size_t) por_hilo * metricas->cant_hilos + 1,
+                              sizeof(struct metrica_clase));
+    if (metricas->clases == NULL) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para las metricas de %d clases",
+               cant_clases);
+        return -1;
+    }
+    metricas->cant_clases = cant_clases;
+    metricas->clases_hilo = por_hilo;
+    return 0;
+}
+
+/**
+ * reloj_metricas()
+ * ---------------------------------------------------------------------------
+ *  Usa CLOCK_MONOTONIC, que no cambia si se ajusta la hora del sistema.
+ */
+u_int64_t reloj_metricas()
+{
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return (u_int64_t) ahora.tv_sec * 1000000000 + ahora.tv_nsec;
+}
+
+/**
+ * iniciar_etapa(metricas)
+ * ---------------------------------------------------------------------------
+ *  Devuelve el reloj al empezar una etapa, o cero si *metricas* es NULL.
+ */
+u_int64_t iniciar_etapa(const struct metricas *metricas)
+{
+    return metricas != NULL ? reloj_metricas() : 0;
+}
+
+/**
+ * terminar_etapa(metricas, etapa, inicio)
+ * ---------------------------------------------------------------------------
+ *  Suma el tiempo de forma atomica, porque varios hilos pueden obtener
+ *  lotes a la vez (ver analizar_particiones).
+ */
+void terminar_etapa(struct metricas *metricas, enum etapa etapa,
+                    u_int64_t inicio)
+{
+    if (metricas == NULL)
+        return;
+    __atomic_add_fetch(metricas->nanosegundos + etapa,
+                       reloj_metricas() - inicio, __ATOMIC_RELAXED);
+}
+
+/**
+ * terminar_clasificacion(metricas, inicio, paquetes)
+ * ---------------------------------------------------------------------------
+ *  Cada hilo solo suma en sus propios contadores, por lo que no es necesaria
+ *  la sincronizacion.
+ */
+void terminar_clasificacion(struct metricas *metricas, u_int64_t inicio,
+                            int paquetes)
+{
+    struct metrica_hilo *hilo;
+    if (metricas == NULL || HILO_ACTUAL >= metricas->cant_hilos)
+        return;
+    hilo = metricas->hilos + HILO_ACTUAL;
+    hilo->paquetes += paquetes;
+    hilo->nanosegundos += reloj_metricas() - inicio;
+}
+
+/**
+ * contar_obtenidos(metricas, filas, bytes)
+ * ---------------------------------------------------------------------------
+ *  Suma las filas y los bytes de forma atomica.
+ */
+void contar_obtenidos(struct metricas *metricas, int filas, size_t bytes)
+{
+    if (metricas == NULL)
+        return;
+    __atomic_add_fetch(&(metricas->filas), filas, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(metricas->bytes), bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * metricas_clases_hilo(metricas, cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Devuelve las comparaciones por clase del hilo actual, o NULL si no se
+ *  cuentan o si se crearon para otra cantidad de clases.
+ */
+struct metrica_clase* metricas_clases_hilo(const struct metricas *metricas,
+                                           int cant_clases)
+{
+    int hilo = HILO_ACTUAL;
+    if (metricas == NULL || metricas->clases == NULL ||
+            metricas->cant_clases != cant_clases ||
+            hilo >= metricas->cant_hilos)
+        return NULL;
+    return metricas->clases + hilo * metricas->clases_hilo;
+}
+
+/**
+ * metricas_to_file(file, metricas, s_analizador)
+ * ---------------------------------------------------------------------------
+ *  Escribe un objeto JSON con el tiempo de cada etapa en segundos, las filas
+ *  y bytes obtenidos, las filas por segundo del analisis, la memoria maxima
+ *  en kilobytes, los paquetes y segundos de clasificacion de cada hilo y las
+ *  comparaciones, elecciones y aciertos de la cache de cada clase.
+ */
+int metricas_to_file(FILE *file, const struct metricas *metricas,
+                     const struct s_analizador *analizador)
+{
+    struct metrica_clase total;
+    u_int64_t paquetes, nanosegundos, maximo, etapa;
+    double analisis;
+    int i, j;
+
+    clasificados(metricas, &paquetes, &nanosegundos, &maximo);
+    analisis = segundos(metricas->nanosegundos[ETAPA_ANALISIS]);
+    fprintf(file, "{\n  \"segundos\": %.6f,\n  \"etapas\": {",
+            segundos(reloj_metricas() - metricas->inicio));
+    for (i = 0; i < CANT_ETAPAS; i++) {
+        /* la clasificacion se suma en los contadores de cada hilo */
+        etapa = i == ETAPA_CLASIFICACION ? nanosegundos :
+                metricas->nanosegundos[i];
+        fprintf(file, "%s\n    \"%s\": %.6f", i > 0 ? "," : "",
+                nombres_etapas[i], segundos(etapa));
+    }
+    fprintf(file, "\n  },\n"
+                  "  \"filas\": %" PRIu64 ",\n"
+                  "  \"bytes\": %" PRIu64 ",\n"
+                  "  \"filas_por_segundo\": %.1f,\n"
+                  "  \"memoria_maxima_kb\": %ld,\n"
+                  "  \"desbalance\": %.3f,\n"
+                  "  \"hilos\": [",
+            metricas->filas,
+            metricas->bytes,
+            analisis > 0 ? metricas->filas / analisis : 0,
+            memoria_maxima(),
+            desbalance(metricas, paquetes, maximo));
+    for (i = 0; i < metricas->cant_hilos; i++)
+        fprintf(file, "%s\n    {\"paquetes\": %" PRIu64 ", "
+                      "\"segundos\": %.6f}",
+                i > 0 ? "," : "",
+                metricas->hilos[i].paquetes,
+                segundos(metricas->hilos[i].nanosegundos));
+    fprintf(file, "\n  ],\n  \"clases\": [");
+    /* las comparaciones solo corresponden a las clases instaladas */
+    for (j = 0; metricas->clases != NULL &&
+                metricas->cant_clases == analizador->cant_clases &&
+                j < metricas->cant_clases; j++) {
+        memset(&total, 0, sizeof(struct metrica_clase));
+        for (i = 0; i < metricas->cant_hilos; i++) {
+            total.intentos += metricas->clases[i * metricas->clases_hilo +
+                                               j].intentos;
+            total.aciertos += metricas->clases[i * metricas->clases_hilo +
+                                               j].aciertos;
+            total.cache += metricas->clases[i * metricas->clases_hilo +
+                                            j].cache;
+        }
+        fprintf(file, "%s\n    {\"id\": %d, \"intentos\": %" PRIu64 ", "
+                      "\"aciertos\": %" PRIu64 ", \"cache\": %" PRIu64 "}",
+                j > 0 ? "," : "",
+                analizador->clases[j].id,
+                total.intentos,
+                total.aciertos,
+                total.cache);
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return 0;
+}
+
+/**
+ * metricas_syslog(metricas)
+ * ---------------------------------------------------------------------------
+ *  Escribe una linea con el tiempo de cada etapa y otra con el rendimiento.
+ */
+void metricas_syslog(const struct metricas *metricas)
+{
+    u_int64_t paquetes, nanosegundos, maximo;
+    double analisis;
+
+    clasificados(metricas, &paquetes, &nanosegundos, &maximo);
+    analisis = segundos(metricas->nanosegundos[ETAPA_ANALISIS]);
+    syslog(LOG_INFO,
+           "Etapas: %s %.3fs, %s %.3fs, %s %.3fs, %s %.3fs, %s %.3fs, "
+           "%s %.3fs",
+           nombres_etapas[ETAPA_CLASES],
+           segundos(metricas->nanosegundos[ETAPA_CLASES]),
+           nombres_etapas[ETAPA_ANALISIS], analisis,
+           nombres_etapas[ETAPA_OBTENCION],
+           segundos(metricas->nanosegundos[ETAPA_OBTENCION]),
+           nombres_etapas[ETAPA_CONVERSION],
+           segundos(metricas->nanosegundos[ETAPA_CONVERSION]),
+           nombres_etapas[ETAPA_CLASIFICACION], segundos(nanosegundos),
+           nombres_etapas[ETAPA_ESCRITURA],
+           segundos(metricas->nanosegundos[ETAPA_ESCRITURA]));
+    syslog(LOG_INFO,
+           "Se obtuvieron %" PRIu64 " filas (%.1f filas/s) y %" PRIu64
+           " bytes, memoria maxima %ld KB, desbalance entre %d hilos %.3f",
+           metricas->filas,
+           analisis > 0 ? metricas->filas / analisis : 0,
+           metricas->bytes,
+           memoria_maxima(),
+           metricas->cant_hilos,
+           desbalance(metricas, paquetes, maximo));
+}
+
+/**
+ * free_metricas(metricas)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por las metricas.
+ */
+void free_metricas(struct metricas *metricas)
+{
+    if (metricas == NULL)
+        return;
+    free(metricas->memoria_hilos);
+    free(metricas->clases);
+    free(metricas);
+}
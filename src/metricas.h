@@ -0,0 +1,191 @@
+/**
+ * metricas.h
+ * ==========================================================================
+ * Este modulo mide en que se usa el tiempo de una ejecucion: cuanto tarda
+ * cada etapa (obtener las clases, obtener los paquetes de la fuente,
+ * convertirlos, clasificarlos e imprimir el resultado), cuantas filas y
+ * bytes se obtuvieron, cuantos paquetes clasifico cada hilo y cuantas veces
+ * se comparo cada clase con un paquete.
+ *
+ * Las metricas solo se miden si el analizador tiene metricas (ver
+ * s_analizador->metricas). Sin metricas cada lote solo comprueba que el
+ * puntero sea NULL. Con metricas se lee el reloj una vez al empezar y otra
+ * al terminar cada lote, y cada hilo suma en sus propios contadores, que
+ * ocupan lineas de cache distintas.
+ */
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "analizador.h"
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * enum etapa
+ * ---------------------------------------------------------------------------
+ * Etapas de una ejecucion. El tiempo de las etapas que se ejecutan en varios
+ * hilos a la vez es la suma del tiempo de cada hilo. La conversion ocurre
+ * dentro de la obtencion, por lo que su tiempo tambien se suma a la
+ * obtencion.
+ */
+enum etapa {
+    ETAPA_CLASES, /* obtener y compilar las clases de trafico */
+    ETAPA_ANALISIS, /* obtener y clasificar todos los paquetes */
+    ETAPA_OBTENCION, /* obtener los lotes de la fuente */
+    ETAPA_CONVERSION, /* convertir las columnas de la base de datos */
+    ETAPA_CLASIFICACION, /* clasificar los lotes */
+    ETAPA_ESCRITURA, /* imprimir el resultado */
+    CANT_ETAPAS
+};
+
+/**
+ * struct metrica_hilo
+ * ---------------------------------------------------------------------------
+ * Paquetes clasificados por un hilo y el tiempo que tardo. Ocupa una linea
+ * de cache completa.
+ */
+struct metrica_hilo {
+    u_int64_t paquetes;
+    u_int64_t nanosegundos;
+    char relleno[LINEA_CACHE - 2 * sizeof(u_int64_t)];
+};
+
+/**
+ * struct metrica_clase
+ * ---------------------------------------------------------------------------
+ * Comparaciones de una clase de trafico en un hilo. Sin indice la clase se
+ * compara con cada paquete que no esta en la cache de flujos; con indice
+ * solo con los paquetes de los que es candidata. La clase por defecto no se
+ * compara, pero se le cuentan los paquetes que no coincidieron con ninguna.
+ */
+struct metrica_clase {
+    u_int64_t intentos; /* paquetes con los que se comparo la clase */
+    u_int64_t aciertos; /* paquetes comparados en los que se eligio */
+    u_int64_t cache; /* paquetes asignados por la cache de flujos */
+};
+
+/**
+ * struct metricas
+ * ---------------------------------------------------------------------------
+ * Metricas de una ejecucion desde que se crearon.
+ */
+struct metricas {
+    u_int64_t inicio; /* reloj al crear las metricas */
+    u_int64_t nanosegundos[CANT_ETAPAS];
+    u_int64_t filas; /* filas obtenidas de la fuente */
+    u_int64_t bytes; /* bytes recibidos de la base de datos */
+    int cant_hilos;
+    struct metrica_hilo *hilos;
+    /* comparaciones por clase de cada hilo (posicion hilo * clases_hilo +
+     * clase). Si es NULL no se cuentan. */
+    struct metrica_clase *clases;
+    int cant_clases;
+    int clases_hilo; /* mayor o igual a cant_clases */
+    void *memoria_hilos; /* memoria reservada para los hilos */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_metricas(cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Crea metricas en cero para cada hilo de analisis y para *cant_clases*
+ *  clases de trafico.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct metricas* crear_metricas(int cant_clases);
+
+/**
+ * reiniciar_clases_metricas(metricas, cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Vuelve a crear en cero las comparaciones por clase para una nueva
+ *  cantidad de clases, por ejemplo al recargar las clases.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible. En ese caso
+ *  las comparaciones por clase dejan de contarse.
+ */
+int reiniciar_clases_metricas(struct metricas *metricas, int cant_clases);
+
+/**
+ * reloj_metricas()
+ * ---------------------------------------------------------------------------
+ *  Devuelve el tiempo de un reloj monotono en nanosegundos.
+ */
+u_int64_t reloj_metricas();
+
+/**
+ * iniciar_etapa(metricas)
+ * ---------------------------------------------------------------------------
+ *  Devuelve el reloj al empezar una etapa, o cero si *metricas* es NULL.
+ */
+u_int64_t iniciar_etapa(const struct metricas *metricas);
+
+/**
+ * terminar_etapa(metricas, etapa, inicio)
+ * ---------------------------------------------------------------------------
+ *  Suma a la etapa el tiempo desde *inicio*. Se puede llamar desde varios
+ *  hilos a la vez. No hace nada si *metricas* es NULL.
+ */
+void terminar_etapa(struct metricas *metricas, enum etapa etapa,
+                    u_int64_t inicio);
+
+/**
+ * terminar_clasificacion(metricas, inicio, paquetes)
+ * ---------------------------------------------------------------------------
+ *  Suma a los contadores del hilo actual los paquetes clasificados y el
+ *  tiempo desde *inicio*. No hace nada si *metricas* es NULL.
+ */
+void terminar_clasificacion(struct metricas *metricas, u_int64_t inicio,
+                            int paquetes);
+
+/**
+ * contar_obtenidos(metricas, filas, bytes)
+ * ---------------------------------------------------------------------------
+ *  Suma filas y bytes obtenidos de la fuente. Se puede llamar desde varios
+ *  hilos a la vez. No hace nada si *metricas* es NULL.
+ */
+void contar_obtenidos(struct metricas *metricas, int filas, size_t bytes);
+
+/**
+ * metricas_clases_hilo(metricas, cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Devuelve las comparaciones por clase del hilo actual, o NULL si no se
+ *  cuentan o si se crearon para otra cantidad de clases.
+ */
+struct metrica_clase* metricas_clases_hilo(const struct metricas *metricas,
+                                           int cant_clases);
+
+/**
+ * metricas_to_file(file, metricas, s_analizador)
+ * ---------------------------------------------------------------------------
+ *  Escribe las metricas en el archivo pasado por parametro en formato JSON.
+ *  Las clases se identifican con el id de las clases del analizador.
+ */
+int metricas_to_file(FILE *file, const struct metricas *metricas,
+                     const struct s_analizador *analizador);
+
+/**
+ * metricas_syslog(metricas)
+ * ---------------------------------------------------------------------------
+ *  Escribe en syslog un resumen de las metricas: tiempo de cada etapa, filas
+ *  por segundo, memoria maxima y desbalance entre hilos.
+ */
+void metricas_syslog(const struct metricas *metricas);
+
+/**
+ * free_metricas(metricas)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por las metricas.
+ */
+void free_metricas(struct metricas *metricas);
+
+#endif /* METRICAS_H */
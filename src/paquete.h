@@ -19,11 +19,15 @@ struct paquete {
     struct in_addr ip_destino;  /* direccion ip de destino */
     u_int16_t puerto_origen; /* puerto de origen */
     u_int16_t puerto_destino; /* puerto de destino */
-    int bytes; /* cantidad de bytes que contiene el paquete */
+    u_int64_t bytes; /* cantidad de bytes que contiene el paquete */
     int protocolo; /* protocolo (6 es TCP y 17 es UDP) */
     enum dir direccion; /* direccion del paquete (puede ser ENTRANTE o
                          * SALIENTE)
                          */
+    u_int32_t cantidad; /* cantidad de paquetes que representa. Es mayor a
+                         * uno cuando los paquetes se agrupan por flujo, en
+                         * ese caso bytes es la suma de todos ellos.
+                         */
 };
 
 #endif /* PAQUETE_H */
@@ -0,0 +1,246 @@
+#define _POSIX_C_SOURCE 200809L /* pthread */
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include "recarga.h"
+#include "indice.h"
+
+/*
+ * free_tabla
+ * ---------------------------------------------------------------------------
+ *  Libera las clases y el indice de una tabla.
+ */
+static void free_tabla(struct tabla_clases *tabla)
+{
+    struct s_analizador analizador;
+    if (tabla->instantanea.memoria != NULL) {
+        /* cerrar_instantanea() libera el indice y las clases del
+         * analizador */
+        memset(&analizador, 0, sizeof(struct s_analizador));
+        analizador.clases = tabla->clases;
+        analizador.cant_clases = tabla->cant_clases;
+        analizador.indice = tabla->indice;
+        cerrar_instantanea(&analizador, &(tabla->instantanea));
+    } else {
+        free_clases(tabla->clases);
+        free_indice(tabla->indice);
+    }
+    tabla->clases = NULL;
+    tabla->cant_clases = 0;
+    tabla->indice = NULL;
+}
+
+/*
+ * compilar_tabla
+ * ---------------------------------------------------------------------------
+ *  Funcion del hilo de compilacion. Compila el indice de la tabla pendiente,
+ *  actualiza la instantanea y publica la tabla. Si no se puede compilar la
+ *  tabla se descarta y la firma se vuelve a revisar en el siguiente
+ *  intervalo.
+ */
+static void* compilar_tabla(void *datos)
+{
+    struct recarga *recarga = datos;
+    struct tabla_clases *tabla = recarga->pendiente;
+    struct s_analizador analizador;
+
+    tabla->indice = crear_indice(tabla->clases, tabla->cant_clases);
+    if (tabla->indice == NULL) {
+        syslog(LOG_ERR, "Error al compilar las clases de trafico recargadas");
+        free_tabla(tabla);
+        free(tabla);
+        __atomic_store_n(&(recarga->compilando), 0, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    if (recarga->archivo_instantanea != NULL) {
+        memset(&analizador, 0, sizeof(struct s_analizador));
+        analizador.clases = tabla->clases;
+        analizador.cant_clases = tabla->cant_clases;
+        analizador.indice = tabla->indice;
+        if (guardar_instantanea(recarga->archivo_instantanea, tabla->firma,
+                                &analizador) == 0)
+            syslog(LOG_INFO, "Se actualizo la instantanea %s",
+                   recarga->archivo_instantanea);
+    }
+    /* la tabla queda completa antes de que otro hilo pueda verla */
+    __atomic_store_n(&(recarga->publicada), tabla, __ATOMIC_RELEASE);
+    __atomic_store_n(&(recarga->compilando), 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+ * esperar_hilo
+ * ---------------------------------------------------------------------------
+ *  Espera a que termine el hilo de compilacion, si se inicio alguno.
+ */
+static void esperar_hilo(struct recarga *recarga)
+{
+    if (!recarga->hilo_iniciado)
+        return;
+    pthread_join(recarga->hilo, NULL);
+    recarga->hilo_iniciado = 0;
+}
+
+/**
+ * crear_recarga(s_analizador, instantanea, firma, intervalo, obtener_firma,
+ *               obtener_clases, archivo_instantanea)
+ * ---------------------------------------------------------------------------
+ *  Crea la recarga con las clases del analizador como tabla instalada. La
+ *  primera revision es luego de un intervalo.
+ *
+ *  Devuelve NULL si el intervalo es cero o si no hay memoria disponible.
+ */
+struct recarga* crear_recarga(struct s_analizador *analizador,
+                              struct instantanea *instantanea,
+                              u_int64_t firma, int intervalo,
+                              u_int64_t (*obtener_firma)(),
+                              int (*obtener_clases)(struct s_analizador*),
+                              const char *archivo_instantanea)
+{
+    struct recarga *recarga;
+    if (intervalo <= 0)
+        return NULL;
+    recarga = calloc(1, sizeof(struct recarga));
+    if (recarga == NULL)
+        return NULL;
+    recarga->obtener_firma = obtener_firma;
+    recarga->obtener_clases = obtener_clases;
+    recarga->archivo_instantanea = archivo_instantanea;
+    recarga->intervalo = intervalo;
+    recarga->siguiente = time(NULL) + intervalo;
+    recarga->actual.firma = firma;
+    recarga->actual.clases = analizador->clases;
+    recarga->actual.cant_clases = analizador->cant_clases;
+    recarga->actual.indice = analizador->indice;
+    if (instantanea != NULL) {
+        recarga->actual.instantanea = *instantanea;
+        instantanea->memoria = NULL;
+        instantanea->tamanio = 0;
+    }
+    return recarga;
+}
+
+/**
+ * revisar_clases(recarga, ahora)
+ * ---------------------------------------------------------------------------
+ *  Obtiene la firma de las clases y, si cambio, las clases en una tabla
+ *  nueva que se compila en otro hilo.
+ *
+ *  Devuelve 1 si se empezo a compilar una tabla nueva, 0 en caso contrario.
+ */
+int revisar_clases(struct recarga *recarga, time_t ahora)
+{
+    struct s_analizador analizador;
+    struct tabla_clases *tabla;
+    u_int64_t firma;
+
+    if (ahora < recarga->siguiente ||
+            __atomic_load_n(&(recarga->compilando), __ATOMIC_ACQUIRE) ||
+            __atomic_load_n(&(recarga->publicada), __ATOMIC_ACQUIRE) != NULL)
+        return 0;
+    recarga->siguiente = ahora + recarga->intervalo;
+    esperar_hilo(recarga);
+    firma = recarga->obtener_firma();
+    if (firma == recarga->actual.firma)
+        return 0;
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    if (recarga->obtener_clases(&analizador) < 0 ||
+            analizador.cant_clases <= 0) {
+        syslog(LOG_ERR, "Error al obtener las clases de trafico recargadas");
+        return 0;
+    }
+    tabla = calloc(1, sizeof(struct tabla_clases));
+    if (tabla == NULL) {
+        syslog(LOG_ERR, "No hay memoria disponible para recargar las clases");
+        free_clases(analizador.clases);
+        return 0;
+    }
+    tabla->firma = firma;
+    tabla->clases = analizador.clases;
+    tabla->cant_clases = analizador.cant_clases;
+    recarga->pendiente = tabla;
+    __atomic_store_n(&(recarga->compilando), 1, __ATOMIC_RELEASE);
+    if (pthread_create(&(recarga->hilo), NULL, compilar_tabla, recarga)) {
+        /* sin hilo se compila en el hilo actual */
+        syslog(LOG_WARNING, "No se pudo crear el hilo de compilacion");
+        compilar_tabla(recarga);
+        return 1;
+    }
+    recarga->hilo_iniciado = 1;
+    syslog(LOG_INFO, "Las clases de trafico cambiaron, compilando %d clases",
+           tabla->cant_clases);
+    return 1;
+}
+
+/**
+ * instalar_recarga(recarga, s_analizador, ventanas)
+ * ---------------------------------------------------------------------------
+ *  Toma la tabla publicada, si hay alguna, y reemplaza la tabla instalada.
+ *  Si no hay memoria disponible la tabla publicada queda para el siguiente
+ *  intento.
+ *
+ *  Devuelve 1 si se instalo una tabla, 0 si no hay ninguna publicada o -1 si
+ *  no hay memoria disponible.
+ */
+int instalar_recarga(struct recarga *recarga,
+                     struct s_analizador *analizador,
+                     struct ventanas *ventanas)
+{
+    struct tabla_clases *tabla;
+
+    tabla = __atomic_load_n(&(recarga->publicada), __ATOMIC_ACQUIRE);
+    if (tabla == NULL)
+        return 0;
+    if (ventanas != NULL &&
+            reasignar_ventanas(ventanas, analizador->clases,
+                               analizador->cant_clases, tabla->clases,
+                               tabla->cant_clases) < 0)
+        return -1;
+    if (reemplazar_clases(analizador, tabla->clases, tabla->cant_clases,
+                          tabla->indice) < 0) {
+        /* las ventanas vuelven a las clases instaladas */
+        if (ventanas != NULL &&
+                reasignar_ventanas(ventanas, tabla->clases,
+                                   tabla->cant_clases, analizador->clases,
+                                   analizador->cant_clases) < 0) {
+            syslog(LOG_ERR, "No se pudieron restaurar las ventanas");
+            exit(EXIT_FAILURE);
+        }
+        return -1;
+    }
+    __atomic_store_n(&(recarga->publicada), NULL, __ATOMIC_RELEASE);
+    /* ningun hilo analiza paquetes, por lo que nadie usa la tabla anterior */
+    free_tabla(&(recarga->actual));
+    recarga->actual = *tabla;
+    free(tabla);
+    syslog(LOG_INFO, "Se instalaron %d clases de trafico",
+           recarga->actual.cant_clases);
+    return 1;
+}
+
+/**
+ * free_recarga(recarga, s_analizador)
+ * ---------------------------------------------------------------------------
+ *  Espera al hilo de compilacion y libera las tablas. Los vectores de
+ *  subredes del analizador se liberan antes de quitarle las clases, ya que
+ *  free_analizador() los recorre con la cantidad de clases.
+ */
+void free_recarga(struct recarga *recarga, struct s_analizador *analizador)
+{
+    struct tabla_clases *tabla;
+    if (recarga == NULL)
+        return;
+    esperar_hilo(recarga);
+    tabla = __atomic_load_n(&(recarga->publicada), __ATOMIC_ACQUIRE);
+    if (tabla != NULL) {
+        free_tabla(tabla);
+        free(tabla);
+    }
+    free_vectores(analizador);
+    free_tabla(&(recarga->actual));
+    analizador->clases = NULL;
+    analizador->cant_clases = 0;
+    analizador->indice = NULL;
+    free(recarga);
+}
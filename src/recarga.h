@@ -0,0 +1,136 @@
+/**
+ * recarga.h
+ * ==========================================================================
+ * Este modulo vuelve a cargar las clases de trafico cuando cambian, sin
+ * reiniciar el programa.
+ *
+ * Cada version de las clases es una tabla (ver struct tabla_clases) que no se
+ * modifica luego de publicarla. Cada cierto tiempo se compara la firma de las
+ * clases de la base de datos con la de la tabla instalada (ver
+ * revisar_clases). Si cambio, se obtienen las clases y se compila su indice
+ * en un hilo aparte mientras el analisis continua con la tabla actual. El
+ * hilo publica la tabla compilada con una escritura atomica de un puntero.
+ *
+ * La tabla publicada se instala entre dos analisis (ver instalar_recarga),
+ * cuando ningun hilo clasifica paquetes: los paquetes en curso terminan con
+ * la tabla anterior y los siguientes usan la nueva, por lo que el analisis
+ * nunca espera a la compilacion ni ve una tabla a medio reemplazar. La tabla
+ * anterior se libera al instalar la nueva porque ya nadie la usa.
+ */
+#ifndef RECARGA_H
+#define RECARGA_H
+
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "analizador.h"
+#include "instantanea.h"
+#include "ventana.h"
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct tabla_clases
+ * ---------------------------------------------------------------------------
+ * Version de las clases de trafico con su indice compilado.
+ */
+struct tabla_clases {
+    u_int64_t firma; /* firma de las clases (ver obtener_firma_clases) */
+    struct clase *clases;
+    int cant_clases;
+    struct indice *indice;
+    /* si la memoria no es NULL las clases pertenecen a la instantanea */
+    struct instantanea instantanea;
+};
+
+/**
+ * struct recarga
+ * ---------------------------------------------------------------------------
+ * Estado de la recarga de clases de trafico. Solo *publicada* y *compilando*
+ * se acceden desde el hilo de compilacion, siempre de forma atomica.
+ */
+struct recarga {
+    /* obtiene la firma actual de las clases */
+    u_int64_t (*obtener_firma)();
+    /* obtiene en el analizador clases creadas con crear_clases().
+     * Devuelve -1 en caso de error */
+    int (*obtener_clases)(struct s_analizador*);
+    const char *archivo_instantanea; /* se actualiza con cada tabla nueva */
+    int intervalo; /* segundos entre revisiones de la firma */
+    time_t siguiente; /* hora de la siguiente revision */
+    struct tabla_clases actual; /* tabla instalada en el analizador */
+    struct tabla_clases *pendiente; /* tabla que compila el hilo */
+    struct tabla_clases *publicada; /* tabla compilada sin instalar */
+    int compilando; /* distinto de cero mientras el hilo compila */
+    int hilo_iniciado; /* si es distinto de cero se debe esperar al hilo */
+    pthread_t hilo;
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_recarga(s_analizador, instantanea, firma, intervalo, obtener_firma,
+ *               obtener_clases, archivo_instantanea)
+ * ---------------------------------------------------------------------------
+ *  Crea la recarga de las clases del analizador, que ya deben estar
+ *  compiladas y tener la firma pasada por parametro. Si las clases se
+ *  cargaron de una instantanea se pasa la instantanea, caso contrario NULL.
+ *  Desde ese momento las clases del analizador pertenecen a la recarga y se
+ *  liberan con free_recarga().
+ *
+ *  La firma se revisa cada *intervalo* segundos.
+ *
+ *  Devuelve NULL si el intervalo es cero o si no hay memoria disponible.
+ */
+struct recarga* crear_recarga(struct s_analizador *analizador,
+                              struct instantanea *instantanea,
+                              u_int64_t firma, int intervalo,
+                              u_int64_t (*obtener_firma)(),
+                              int (*obtener_clases)(struct s_analizador*),
+                              const char *archivo_instantanea);
+
+/**
+ * revisar_clases(recarga, ahora)
+ * ---------------------------------------------------------------------------
+ *  Si paso el intervalo desde la ultima revision y no hay una tabla
+ *  compilandose o sin instalar, obtiene la firma de las clases. Si cambio,
+ *  obtiene las clases en el hilo actual, porque la conexion con la base de
+ *  datos no se comparte, y las compila en un hilo aparte.
+ *
+ *  Devuelve 1 si se empezo a compilar una tabla nueva, 0 en caso contrario.
+ */
+int revisar_clases(struct recarga *recarga, time_t ahora);
+
+/**
+ * instalar_recarga(recarga, s_analizador, ventanas)
+ * ---------------------------------------------------------------------------
+ *  Si hay una tabla publicada, la instala en el analizador, adapta las
+ *  ventanas a las nuevas clases (si no son NULL) y libera la tabla anterior.
+ *  No espera a que termine la compilacion.
+ *
+ *  Solo se debe llamar cuando ningun hilo analiza paquetes y con los
+ *  contadores ya reducidos.
+ *
+ *  Devuelve 1 si se instalo una tabla, 0 si no hay ninguna publicada o -1 si
+ *  no hay memoria disponible para instalarla.
+ */
+int instalar_recarga(struct recarga *recarga,
+                     struct s_analizador *analizador,
+                     struct ventanas *ventanas);
+
+/**
+ * free_recarga(recarga, s_analizador)
+ * ---------------------------------------------------------------------------
+ *  Espera a que termine la compilacion en curso y libera las tablas, incluida
+ *  la instalada en el analizador, cuyas clases e indice quedan en NULL, y
+ *  los vectores de subredes del analizador.
+ */
+void free_recarga(struct recarga *recarga, struct s_analizador *analizador);
+
+#endif /* RECARGA_H */
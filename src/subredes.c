@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+#include "subredes.h"
+#include "analizador.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUBREDES_X86
+#endif
+
+/* red de las posiciones de relleno */
+#define RED_RELLENO 0xffffffff
+
+/**
+ * crear_vector_subredes(subredes, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Copia el array de subredes en un vector. Cada subred guarda su prefijo mas
+ *  uno para que una subred /0 que coincide se distinga de una que no
+ *  coincide.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct vector_subredes* crear_vector_subredes(const struct subred *subredes,
+                                              int cantidad)
+{
+    struct vector_subredes *vector;
+    int i;
+    vector = calloc(1, sizeof(struct vector_subredes));
+    if (vector == NULL)
+        return NULL;
+    vector->cantidad = cantidad;
+    vector->capacidad = (cantidad + SUBREDES_BLOQUE - 1) /
+                        SUBREDES_BLOQUE * SUBREDES_BLOQUE;
+    vector->implementacion = implementacion_subredes();
+    /* se reserva al menos una posicion aunque no haya subredes */
+    vector->redes = malloc(sizeof(u_int32_t) * (vector->capacidad + 1));
+    vector->mascaras = malloc(sizeof(u_int32_t) * (vector->capacidad + 1));
+    vector->puntos = malloc(sizeof(int32_t) * (vector->capacidad + 1));
+    if (vector->redes == NULL || vector->mascaras == NULL ||
+            vector->puntos == NULL) {
+        free_vector_subredes(vector);
+        return NULL;
+    }
+    for (i = 0; i < vector->capacidad; i++) {
+        if (i < cantidad) {
+            vector->redes[i] = subredes[i].red.s_addr;
+            vector->mascaras[i] = subredes[i].mascara;
+            vector->puntos[i] = subredes[i].prefijo + 1;
+        } else {
+            vector->redes[i] = RED_RELLENO;
+            vector->mascaras[i] = 0;
+            vector->puntos[i] = 0;
+        }
+    }
+    return vector;
+}
+
+/**
+ * free_vector_subredes(vector)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por el vector.
+ */
+void free_vector_subredes(struct vector_subredes *vector)
+{
+    if (vector == NULL)
+        return;
+    free(vector->redes);
+    free(vector->mascaras);
+    free(vector->puntos);
+    free(vector);
+}
+
+/**
+ * implementacion_subredes()
+ * ---------------------------------------------------------------------------
+ *  Devuelve la mejor implementacion que soporta el procesador.
+ */
+int implementacion_subredes()
+{
+#ifdef SUBREDES_X86
+    if (__builtin_cpu_supports("avx2"))
+        return SUBREDES_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SUBREDES_SSE41;
+#endif
+    return SUBREDES_ESCALAR;
+}
+
+/*
+ * mejor_prefijo_escalar
+ * ---------------------------------------------------------------------------
+ *  Compara la ip con cada subred.
+ */
+static int mejor_prefijo_escalar(const struct vector_subredes *vector,
+                                 u_int32_t ip)
+{
+    int32_t mejor = 0;
+    int i;
+    for (i = 0; i < vector->cantidad; i++)
+        if ((ip & vector->mascaras[i]) == vector->redes[i] &&
+                vector->puntos[i] > mejor)
+            mejor = vector->puntos[i];
+    return mejor - 1;
+}
+
+#ifdef SUBREDES_X86
+/*
+ * mejor_prefijo_sse41
+ * ---------------------------------------------------------------------------
+ *  Compara la ip con 4 subredes por instruccion. Los puntos de las subredes
+ *  que no contienen a la ip se anulan con el resultado de la comparacion y
+ *  se acumula el maximo de cada carril.
+ */
+__attribute__((target("sse4.1")))
+static int mejor_prefijo_sse41(const struct vector_subredes *vector,
+                               u_int32_t ip)
+{
+    __m128i vip = _mm_set1_epi32((int) ip);
+    __m128i mejor = _mm_setzero_si128();
+    __m128i red, mascara, puntos, iguales;
+    int i;
+    for (i = 0; i < vector->capacidad; i += 4) {
+        red = _mm_loadu_si128((const __m128i *) (vector->redes + i));
+        mascara = _mm_loadu_si128((const __m128i *) (vector->mascaras + i));
+        puntos = _mm_loadu_si128((const __m128i *) (vector->puntos + i));
+        iguales = _mm_cmpeq_epi32(_mm_and_si128(vip, mascara), red);
+        mejor = _mm_max_epi32(mejor, _mm_and_si128(iguales, puntos));
+    }
+    /* maximo entre los 4 carriles */
+    mejor = _mm_max_epi32(mejor, _mm_shuffle_epi32(mejor, 0x4e));
+    mejor = _mm_max_epi32(mejor, _mm_shuffle_epi32(mejor, 0xb1));
+    return _mm_cvtsi128_si32(mejor) - 1;
+}
+
+/*
+ * mejor_prefijo_avx2
+ * ---------------------------------------------------------------------------
+ *  Igual que mejor_prefijo_sse41() con 8 subredes por instruccion.
+ */
+__attribute__((target("avx2")))
+static int mejor_prefijo_avx2(const struct vector_subredes *vector,
+                              u_int32_t ip)
+{
+    __m256i vip = _mm256_set1_epi32((int) ip);
+    __m256i mejor = _mm256_setzero_si256();
+    __m256i red, mascara, puntos, iguales;
+    __m128i mitad;
+    int i;
+    for (i = 0; i < vector->capacidad; i += 8) {
+        red = _mm256_loadu_si256((const __m256i *) (vector->redes + i));
+        mascara = _mm256_loadu_si256(
+                (const __m256i *) (vector->mascaras + i));
+        puntos = _mm256_loadu_si256((const __m256i *) (vector->puntos + i));
+        iguales = _mm256_cmpeq_epi32(_mm256_and_si256(vip, mascara), red);
+        mejor = _mm256_max_epi32(mejor, _mm256_and_si256(iguales, puntos));
+    }
+    /* maximo entre los 8 carriles */
+    mitad = _mm_max_epi32(_mm256_castsi256_si128(mejor),
+                          _mm256_extracti128_si256(mejor, 1));
+    mitad = _mm_max_epi32(mitad, _mm_shuffle_epi32(mitad, 0x4e));
+    mitad = _mm_max_epi32(mitad, _mm_shuffle_epi32(mitad, 0xb1));
+    return _mm_cvtsi128_si32(mitad) - 1;
+}
+#endif /* SUBREDES_X86 */
+
+/**
+ * mejor_prefijo_con(vector, ip, implementacion)
+ * ---------------------------------------------------------------------------
+ *  Busca el prefijo mas largo con la implementacion pasada por parametro.
+ */
+int mejor_prefijo_con(const struct vector_subredes *vector, struct in_addr ip,
+                      int implementacion)
+{
+#ifdef SUBREDES_X86
+    if (implementacion == SUBREDES_AVX2)
+        return mejor_prefijo_avx2(vector, ip.s_addr);
+    if (implementacion == SUBREDES_SSE41)
+        return mejor_prefijo_sse41(vector, ip.s_addr);
+#else
+    (void) implementacion;
+#endif
+    return mejor_prefijo_escalar(vector, ip.s_addr);
+}
+
+/**
+ * mejor_prefijo(vector, ip)
+ * ---------------------------------------------------------------------------
+ *  Busca el prefijo mas largo con la implementacion del vector.
+ */
+int mejor_prefijo(const struct vector_subredes *vector, struct in_addr ip)
+{
+    return mejor_prefijo_con(vector, ip, vector->implementacion);
+}
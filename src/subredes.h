@@ -0,0 +1,100 @@
+/**
+ * subredes.h
+ * ==========================================================================
+ * Este modulo busca el prefijo mas largo de un array de subredes que contiene
+ * a una ip comparando varias subredes por instruccion.
+ *
+ * Las subredes se copian en un vector con las direcciones de red, las
+ * mascaras y los prefijos en arrays separados, por lo que se cargan en los
+ * registros SIMD sin reordenarlas. Segun el procesador se usa AVX2 (8
+ * subredes por instruccion), SSE4.1 (4 subredes por instruccion) o la
+ * comparacion de a una subred. La implementacion se elige al crear el vector.
+ */
+#ifndef SUBREDES_H
+#define SUBREDES_H
+
+#include <sys/types.h>
+#include "clase_trafico.h"
+
+/* implementaciones de la busqueda */
+#define SUBREDES_ESCALAR 0
+#define SUBREDES_SSE41 1
+#define SUBREDES_AVX2 2
+
+#define SUBREDES_BLOQUE 8 /* la cantidad de subredes del vector se completa
+                           * a un multiplo de este valor.
+                           */
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct vector_subredes
+ * ---------------------------------------------------------------------------
+ * Subredes de un grupo de una clase de trafico. Las direcciones y mascaras
+ * estan en orden de red, igual que en struct subred. Las posiciones de
+ * relleno tienen una mascara en cero y una red que no es cero, por lo que no
+ * coinciden con ninguna ip.
+ */
+struct vector_subredes {
+    int cantidad; /* cantidad de subredes sin el relleno */
+    int capacidad; /* cantidad de subredes con el relleno */
+    int implementacion; /* implementacion de la busqueda */
+    u_int32_t *redes;
+    u_int32_t *mascaras;
+    int32_t *puntos; /* prefijo de cada subred mas uno */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_vector_subredes(subredes, cantidad)
+ * ---------------------------------------------------------------------------
+ *  Copia el array de subredes en un vector y elige la mejor implementacion
+ *  que soporta el procesador.
+ *
+ *  Devuelve NULL si no hay memoria disponible.
+ */
+struct vector_subredes* crear_vector_subredes(const struct subred *subredes,
+                                              int cantidad);
+
+/**
+ * free_vector_subredes(vector)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por el vector.
+ */
+void free_vector_subredes(struct vector_subredes *vector);
+
+/**
+ * implementacion_subredes()
+ * ---------------------------------------------------------------------------
+ *  Devuelve la mejor implementacion que soporta el procesador.
+ */
+int implementacion_subredes();
+
+/**
+ * mejor_prefijo(vector, ip)
+ * ---------------------------------------------------------------------------
+ *  Busca el prefijo mas largo de las subredes del vector que contienen a la
+ *  ip con la implementacion del vector.
+ *
+ *  Devuelve el prefijo o -1 si ninguna subred contiene a la ip.
+ */
+int mejor_prefijo(const struct vector_subredes *vector, struct in_addr ip);
+
+/**
+ * mejor_prefijo_con(vector, ip, implementacion)
+ * ---------------------------------------------------------------------------
+ *  Igual que mejor_prefijo() pero con la implementacion pasada por
+ *  parametro, que debe estar soportada por el procesador. Se usa para
+ *  comparar las implementaciones.
+ */
+int mejor_prefijo_con(const struct vector_subredes *vector, struct in_addr ip,
+                      int implementacion);
+
+#endif /* SUBREDES_H */
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <syslog.h>
+#include "ventana.h"
+
+/*
+ * sumar_contador
+ * ---------------------------------------------------------------------------
+ *  Suma (signo 1) o resta (signo -1) el contador *b* al contador *a*.
+ */
+static void sumar_contador(struct contador *a, const struct contador *b,
+                           int signo)
+{
+    if (signo > 0) {
+        a->bytes_subida += b->bytes_subida;
+        a->bytes_bajada += b->bytes_bajada;
+        a->paquetes_subida += b->paquetes_subida;
+        a->paquetes_bajada += b->paquetes_bajada;
+    } else {
+        a->bytes_subida -= b->bytes_subida;
+        a->bytes_bajada -= b->bytes_bajada;
+        a->paquetes_subida -= b->paquetes_subida;
+        a->paquetes_bajada -= b->paquetes_bajada;
+    }
+}
+
+/**
+ * crear_ventanas(cant_clases, periodo, segundos, cant_ventanas)
+ * ---------------------------------------------------------------------------
+ *  Crea ventanas vacias. El buffer circular guarda tantos ticks como tiene
+ *  la ventana mas larga.
+ *
+ *  Devuelve NULL si los parametros no son validos o si no hay memoria
+ *  disponible.
+ */
+struct ventanas* crear_ventanas(int cant_clases, int periodo,
+                                const int *segundos, int cant_ventanas)
+{
+    struct ventanas *ventanas;
+    int i;
+    if (cant_clases <= 0 || periodo <= 0 || cant_ventanas <= 0 ||
+            cant_ventanas > MAX_VENTANAS)
+        return NULL;
+    ventanas = calloc(1, sizeof(struct ventanas));
+    if (ventanas == NULL)
+        return NULL;
+    ventanas->cant_clases = cant_clases;
+    ventanas->periodo = periodo;
+    ventanas->cant_ventanas = cant_ventanas;
+    for (i = 0; i < cant_ventanas; i++) {
+        if (segundos[i] <= 0) {
+            free(ventanas);
+            return NULL;
+        }
+        ventanas->segundos[i] = segundos[i];
+        ventanas->ticks[i] = (segundos[i] + periodo - 1) / periodo;
+        if (ventanas->ticks[i] > ventanas->cant_ranuras)
+            ventanas->cant_ranuras = ventanas->ticks[i];
+    }
+    ventanas->ranuras = calloc((size_t) ventanas->cant_ranuras * cant_clases,
+                               sizeof(struct contador));
+    ventanas->totales = calloc((size_t) cant_ventanas * cant_clases,
+                               sizeof(struct contador));
+    if (ventanas->ranuras == NULL || ventanas->totales == NULL) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para %d ticks de %d clases",
+               ventanas->cant_ranuras,
+               cant_clases);
+        free_ventanas(ventanas);
+        return NULL;
+    }
+    return ventanas;
+}
+
+/**
+ * avanzar_ventanas(ventanas, clases)
+ * ---------------------------------------------------------------------------
+ *  Agrega un tick con los contadores de las clases.
+ *
+ *  Primero se resta de cada ventana el tick que sale de ella, que todavia
+ *  esta en el buffer porque la ventana mas larga ocupa todo el buffer y su
+ *  tick saliente es el que se reemplaza. Luego se guarda el tick nuevo y se
+ *  suma a todas las ventanas.
+ */
+void avanzar_ventanas(struct ventanas *ventanas, struct clase *clases)
+{
+    struct contador *ranura, *total;
+    u_int64_t tick = ventanas->tick;
+    int i, j;
+    /* resto el tick que sale de cada ventana */
+    for (i = 0; i < ventanas->cant_ventanas; i++) {
+        if (tick < (u_int64_t) ventanas->ticks[i])
+            continue;
+        ranura = ventanas->ranuras +
+                 ((tick - ventanas->ticks[i]) % ventanas->cant_ranuras) *
+                 ventanas->cant_clases;
+        total = ventanas->totales + i * ventanas->cant_clases;
+        for (j = 0; j < ventanas->cant_clases; j++)
+            sumar_contador(total + j, ranura + j, -1);
+    }
+    /* guardo el tick nuevo y vuelvo a cero las clases */
+    ranura = ventanas->ranuras +
+             (tick % ventanas->cant_ranuras) * ventanas->cant_clases;
+    for (j = 0; j < ventanas->cant_clases; j++) {
+        ranura[j].bytes_subida = clases[j].bytes_subida;
+        ranura[j].bytes_bajada = clases[j].bytes_bajada;
+        ranura[j].paquetes_subida = clases[j].paquetes_subida;
+        ranura[j].paquetes_bajada = clases[j].paquetes_bajada;
+        clases[j].bytes_subida = 0;
+        clases[j].bytes_bajada = 0;
+        clases[j].paquetes_subida = 0;
+        clases[j].paquetes_bajada = 0;
+    }
+    /* sumo el tick nuevo a todas las ventanas */
+    for (i = 0; i < ventanas->cant_ventanas; i++) {
+        total = ventanas->totales + i * ventanas->cant_clases;
+        for (j = 0; j < ventanas->cant_clases; j++)
+            sumar_contador(total + j, ranura + j, 1);
+    }
+    ventanas->tick++;
+}
+
+/**
+ * reasignar_ventanas(ventanas, anteriores, cant_anteriores, clases,
+ *                    cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Crea el buffer circular y los totales para la nueva cantidad de clases y
+ *  copia la columna de cada clase que sigue existiendo.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible.
+ */
+int reasignar_ventanas(struct ventanas *ventanas,
+                       const struct clase *anteriores, int cant_anteriores,
+                       const struct clase *clases, int cant_clases)
+{
+    struct contador *ranuras, *totales;
+    int i, j, k;
+    if (cant_clases <= 0)
+        return -1;
+    ranuras = calloc((size_t) ventanas->cant_ranuras * cant_clases,
+                     sizeof(struct contador));
+    totales = calloc((size_t) ventanas->cant_ventanas * cant_clases,
+                     sizeof(struct contador));
+    if (ranuras == NULL || totales == NULL) {
+        syslog(LOG_ERR,
+               "No hay memoria disponible para %d ticks de %d clases",
+               ventanas->cant_ranuras,
+               cant_clases);
+        free(ranuras);
+        free(totales);
+        return -1;
+    }
+    for (j = 0; j < cant_clases; j++) {
+        for (k = 0; k < cant_anteriores && k < ventanas->cant_clases; k++)
+            if (anteriores[k].id == clases[j].id)
+                break;
+        if (k == cant_anteriores || k == ventanas->cant_clases)
+            continue;
+        for (i = 0; i < ventanas->cant_ranuras; i++)
+            ranuras[i * cant_clases + j] =
+                ventanas->ranuras[i * ventanas->cant_clases + k];
+        for (i = 0; i < ventanas->cant_ventanas; i++)
+            totales[i * cant_clases + j] =
+                ventanas->totales[i * ventanas->cant_clases + k];
+    }
+    free(ventanas->ranuras);
+    free(ventanas->totales);
+    ventanas->ranuras = ranuras;
+    ventanas->totales = totales;
+    ventanas->cant_clases = cant_clases;
+    return 0;
+}
+
+/**
+ * total_ventana(ventanas, ventana)
+ * ---------------------------------------------------------------------------
+ *  Devuelve los contadores de cada clase de la ventana pasada por parametro.
+ */
+const struct contador* total_ventana(const struct ventanas *ventanas,
+                                     int ventana)
+{
+    return ventanas->totales + ventana * ventanas->cant_clases;
+}
+
+/**
+ * ventanas_to_file(file, ventanas, clases)
+ * ---------------------------------------------------------------------------
+ *  Escribe los totales de cada ventana en el archivo pasado por parametro en
+ *  formato JSON. Al igual que clases_to_file(), no se escriben las clases sin
+ *  bytes.
+ */
+int ventanas_to_file(FILE *file, const struct ventanas *ventanas,
+                     const struct clase *clases)
+{
+    const struct contador *total;
+    int i, j, cantidad_procesada;
+    /* inicio array de ventanas */
+    fprintf(file, "[\n");
+    for (i = 0; i < ventanas->cant_ventanas; i++) {
+        total = total_ventana(ventanas, i);
+        fprintf(file,
+                "%c\n"
+                "  {\n"
+                "    \"segundos\": %d,\n"
+                "    \"clases\": [",
+                i != 0 ? ',' : ' ',
+                ventanas->segundos[i]);
+        cantidad_procesada = 0;
+        for (j = 0; j < ventanas->cant_clases; j++) {
+            /* evito imprimir clases sin bytes */
+            if (total[j].bytes_subida == 0 && total[j].bytes_bajada == 0)
+                continue;
+            fprintf(file,
+                    "%c\n"
+                    "      {\n"
+                    "        \"id\": %d,\n"
+                    "        \"nombre\": \"%s\",\n"
+                    "        \"subida\": %" PRIu64 ",\n"
+                    "        \"bajada\": %" PRIu64 ",\n"
+                    "        \"paquetes_subida\": %" PRIu64 ",\n"
+                    "        \"paquetes_bajada\": %" PRIu64 "\n"
+                    "      }",
+                    cantidad_procesada != 0 ? ',' : ' ',
+                    (clases + j)->id,
+                    (clases + j)->nombre,
+                    total[j].bytes_subida,
+                    total[j].bytes_bajada,
+                    total[j].paquetes_subida,
+                    total[j].paquetes_bajada);
+            cantidad_procesada++;
+        }
+        fprintf(file, "]\n  }");
+    }
+    /* fin array de ventanas */
+    fprintf(file, "]\n");
+    return 0;
+}
+
+/**
+ * free_ventanas(ventanas)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por las ventanas.
+ */
+void free_ventanas(struct ventanas *ventanas)
+{
+    if (ventanas == NULL)
+        return;
+    free(ventanas->ranuras);
+    free(ventanas->totales);
+    free(ventanas);
+}
@@ -0,0 +1,110 @@
+/**
+ * ventana.h
+ * ==========================================================================
+ * Este modulo mantiene los totales por clase de trafico de ventanas de tiempo
+ * deslizantes (por ejemplo el ultimo minuto, los ultimos 5 minutos y la
+ * ultima hora) para el modo demonio.
+ *
+ * El tiempo se divide en ticks de duracion fija. Por cada tick se guardan los
+ * contadores de cada clase en un buffer circular que abarca la ventana mas
+ * larga. Al avanzar un tick, a cada ventana se le suma el tick nuevo y se le
+ * resta el tick que queda fuera de ella, por lo que actualizar una ventana no
+ * depende de su duracion.
+ */
+#ifndef VENTANA_H
+#define VENTANA_H
+
+#include <stdio.h>
+#include "analizador.h"
+
+#define MAX_VENTANAS 8 /* cantidad maxima de ventanas */
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct ventanas
+ * ---------------------------------------------------------------------------
+ * Ventanas deslizantes de un conjunto de clases de trafico.
+ */
+struct ventanas {
+    int cant_clases; /* cantidad de clases de cada tick */
+    int periodo; /* duracion de un tick en segundos */
+    int cant_ventanas;
+    int segundos[MAX_VENTANAS]; /* duracion de cada ventana en segundos */
+    int ticks[MAX_VENTANAS]; /* duracion de cada ventana en ticks */
+    int cant_ranuras; /* ticks que guarda el buffer circular */
+    u_int64_t tick; /* cantidad de ticks que avanzaron las ventanas */
+    struct contador *ranuras; /* cant_ranuras ticks de cant_clases */
+    struct contador *totales; /* cant_ventanas totales de cant_clases */
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_ventanas(cant_clases, periodo, segundos, cant_ventanas)
+ * ---------------------------------------------------------------------------
+ *  Crea ventanas vacias de la duracion en segundos pasada por parametro con
+ *  ticks de *periodo* segundos. Las duraciones se redondean hacia arriba a
+ *  una cantidad entera de ticks.
+ *
+ *  Devuelve NULL si los parametros no son validos o si no hay memoria
+ *  disponible.
+ */
+struct ventanas* crear_ventanas(int cant_clases, int periodo,
+                                const int *segundos, int cant_ventanas);
+
+/**
+ * avanzar_ventanas(ventanas, clases)
+ * ---------------------------------------------------------------------------
+ *  Agrega a las ventanas un tick con los bytes y paquetes de las clases de
+ *  trafico y descarta el tick que queda fuera de cada ventana. Los contadores
+ *  de las clases se vuelven a cero para acumular el siguiente tick.
+ */
+void avanzar_ventanas(struct ventanas *ventanas, struct clase *clases);
+
+/**
+ * reasignar_ventanas(ventanas, anteriores, cant_anteriores, clases,
+ *                    cant_clases)
+ * ---------------------------------------------------------------------------
+ *  Adapta las ventanas a un nuevo array de clases de trafico. Los ticks y
+ *  totales de cada clase se conservan si el nuevo array tiene una clase con
+ *  el mismo id; las clases nuevas empiezan en cero.
+ *
+ *  Devuelve 0 en caso de exito, -1 si no hay memoria disponible. En ese caso
+ *  las ventanas no se modifican.
+ */
+int reasignar_ventanas(struct ventanas *ventanas,
+                       const struct clase *anteriores, int cant_anteriores,
+                       const struct clase *clases, int cant_clases);
+
+/**
+ * total_ventana(ventanas, ventana)
+ * ---------------------------------------------------------------------------
+ *  Devuelve los contadores de cada clase de la ventana pasada por parametro.
+ */
+const struct contador* total_ventana(const struct ventanas *ventanas,
+                                     int ventana);
+
+/**
+ * ventanas_to_file(file, ventanas, clases)
+ * ---------------------------------------------------------------------------
+ *  Escribe los totales de cada ventana en el archivo pasado por parametro en
+ *  formato JSON.
+ */
+int ventanas_to_file(FILE *file, const struct ventanas *ventanas,
+                     const struct clase *clases);
+
+/**
+ * free_ventanas(ventanas)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria ocupada por las ventanas.
+ */
+void free_ventanas(struct ventanas *ventanas);
+
+#endif /* VENTANA_H */
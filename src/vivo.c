@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <inttypes.h>
+#include <omp.h>
+#include "vivo.h"
+#include "captura.h"
+#include "recarga.h"
+
+/**
+ * crear_vivo(s_analizador, lan, intervalo, salida, callback)
+ * ---------------------------------------------------------------------------
+ *  Crea el estado con un lote vacio. El primer intervalo empieza con la
+ *  primer trama o la primer llamada a avanzar_reloj().
+ */
+struct vivo* crear_vivo(struct s_analizador *analizador,
+                        const struct subred *lan,
+                        unsigned int intervalo,
+                        FILE *salida,
+                        int (*callback)(const struct s_analizador*,
+                                        const struct paquete*))
+{
+    struct vivo *vivo;
+    if (intervalo == 0)
+        return NULL;
+    vivo = calloc(1, sizeof(struct vivo));
+    if (vivo == NULL)
+        return NULL;
+    vivo->analizador = analizador;
+    vivo->lan = lan;
+    vivo->callback = callback;
+    vivo->salida = salida;
+    vivo->intervalo = intervalo;
+    vivo->tamanio = analizador->tamanio_lote > 0 ?
+                    analizador->tamanio_lote :
+                    TAMANIO_LOTE;
+    vivo->lote = malloc(sizeof(struct paquete) * vivo->tamanio);
+    if (vivo->lote == NULL) {
+        free(vivo);
+        return NULL;
+    }
+    return vivo;
+}
+
+/*
+ * analizar_pendientes
+ * ---------------------------------------------------------------------------
+ *  Analiza en paralelo los paquetes del lote y lo vacia. Si la funcion es
+ *  analizar_paquete(), cada hilo analiza una parte del lote con
+ *  analizar_lote().
+ */
+static void analizar_pendientes(struct vivo *vivo)
+{
+    int i, hilos, desde, hasta;
+    if (vivo->callback == analizar_paquete) {
+        #pragma omp parallel private(hilos, desde, hasta)
+        {
+            hilos = omp_get_num_threads();
+            desde = (long) vivo->cantidad * omp_get_thread_num() / hilos;
+            hasta = (long) vivo->cantidad * (omp_get_thread_num() + 1) /
+                    hilos;
+            analizar_lote(vivo->analizador, vivo->lote + desde,
+                          hasta - desde, NULL);
+        }
+    } else {
+        #pragma omp parallel for
+        for (i = 0; i < vivo->cantidad; i++)
+            vivo->callback(vivo->analizador, vivo->lote + i);
+    }
+    vivo->paquetes += vivo->cantidad;
+    vivo->cantidad = 0;
+}
+
+/**
+ * cerrar_intervalo(vivo)
+ * ---------------------------------------------------------------------------
+ *  Analiza el lote pendiente y escribe los totales del intervalo. Con el
+ *  lote vacio ningun hilo analiza paquetes, por lo que ahi se instalan las
+ *  clases recargadas.
+ */
+void cerrar_intervalo(struct vivo *vivo)
+{
+    struct clase *clase;
+    int i;
+    analizar_pendientes(vivo);
+    reducir_contadores(vivo->analizador);
+    clases_to_file(vivo->salida, vivo->analizador);
+    fflush(vivo->salida);
+    syslog(LOG_DEBUG,
+           "Se analizaron %" PRIu64 " paquetes y se descartaron %" PRIu64
+           " tramas en el intervalo",
+           vivo->paquetes,
+           vivo->descartados);
+    /* el siguiente intervalo empieza de cero */
+    for (i = 0; i < vivo->analizador->cant_clases; i++) {
+        clase = vivo->analizador->clases + i;
+        clase->bytes_subida = 0;
+        clase->bytes_bajada = 0;
+        clase->paquetes_subida = 0;
+        clase->paquetes_bajada = 0;
+    }
+    vivo->paquetes = 0;
+    vivo->descartados = 0;
+    if (vivo->recarga != NULL) {
+        revisar_clases(vivo->recarga, time(NULL));
+        instalar_recarga(vivo->recarga, vivo->analizador, NULL);
+    }
+}
+
+/**
+ * avanzar_reloj(vivo, ahora)
+ * ---------------------------------------------------------------------------
+ *  Si el intervalo actual termino, lo cierra y avanza al intervalo que
+ *  contiene a *ahora*. Los intervalos intermedios sin tramas no se escriben.
+ *  La primera llamada solo empieza el primer intervalo.
+ *
+ *  Devuelve 1 si se cerro el intervalo, 0 en caso contrario.
+ */
+int avanzar_reloj(struct vivo *vivo, time_t ahora)
+{
+    if (vivo->fin == 0) {
+        /* empieza el primer intervalo */
+        vivo->fin = ahora - ahora % vivo->intervalo + vivo->intervalo;
+        return 0;
+    }
+    if (ahora < vivo->fin)
+        return 0;
+    cerrar_intervalo(vivo);
+    vivo->fin = ahora - ahora % vivo->intervalo + vivo->intervalo;
+    return 1;
+}
+
+/**
+ * agregar_trama(vivo, segundos, trama, largo, enlace)
+ * ---------------------------------------------------------------------------
+ *  Decodifica la trama en el lote y analiza el lote cuando se llena.
+ *
+ *  Devuelve 0 si la trama se agrego al lote, -1 si se descarto.
+ */
+int agregar_trama(struct vivo *vivo, time_t segundos, const u_int8_t *trama,
+                  u_int32_t largo, int enlace)
+{
+    avanzar_reloj(vivo, segundos);
+    if (decodificar_paquete(trama, largo, enlace, vivo->lan,
+                            vivo->lote + vivo->cantidad) < 0) {
+        vivo->descartados++;
+        return -1;
+    }
+    if (++vivo->cantidad == vivo->tamanio)
+        analizar_pendientes(vivo);
+    return 0;
+}
+
+/**
+ * free_vivo(vivo)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria del estado.
+ */
+void free_vivo(struct vivo *vivo)
+{
+    if (vivo == NULL)
+        return;
+    free(vivo->lote);
+    free(vivo);
+}
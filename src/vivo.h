@@ -0,0 +1,117 @@
+/**
+ * vivo.h
+ * ==========================================================================
+ * Este modulo clasifica paquetes a medida que se capturan, sin guardarlos en
+ * la base de datos, y escribe los totales de las clases de trafico al final
+ * de cada intervalo.
+ *
+ * Las tramas se agregan de a una con su marca de tiempo (ver agregar_trama),
+ * se decodifican en un lote y cada lote completo se analiza en paralelo. Los
+ * intervalos estan alineados a multiplos de su duracion (por ejemplo, con
+ * intervalos de 60 segundos terminan al inicio de cada minuto). Cuando llega
+ * una trama de un intervalo posterior, o pasa el tiempo sin capturar tramas
+ * (ver avanzar_reloj), se analiza el lote pendiente y se escriben los totales
+ * del intervalo con clases_to_file().
+ *
+ * El modulo no depende del origen de las tramas: la captura de una interfaz
+ * con libpcap (ver interfaz.h) y la reproduccion de archivos de captura (ver
+ * reproducir_captura) usan las mismas funciones.
+ */
+#ifndef VIVO_H
+#define VIVO_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include "analizador.h"
+
+struct recarga;
+
+/*
+ * ESTRUCTURAS
+ * ===========================================================================
+ */
+
+/**
+ * struct vivo
+ * ---------------------------------------------------------------------------
+ * Estado del analisis de tramas capturadas.
+ */
+struct vivo {
+    struct s_analizador *analizador;
+    const struct subred *lan; /* red local para la direccion de los paquetes */
+    int (*callback)(const struct s_analizador*, const struct paquete*);
+    FILE *salida; /* archivo donde se escriben los totales */
+    unsigned int intervalo; /* duracion de los intervalos en segundos */
+    time_t fin; /* fin del intervalo actual o 0 si no se capturo nada */
+    struct paquete *lote; /* paquetes decodificados sin analizar */
+    int tamanio; /* capacidad del lote */
+    int cantidad; /* paquetes en el lote */
+    u_int64_t paquetes; /* paquetes analizados en el intervalo actual */
+    u_int64_t descartados; /* tramas descartadas en el intervalo actual */
+    /* si no es NULL las clases se recargan al cerrar cada intervalo */
+    struct recarga *recarga;
+};
+
+/*
+ * FUNCIONES
+ * ===========================================================================
+ */
+
+/**
+ * crear_vivo(s_analizador, lan, intervalo, salida, callback)
+ * ---------------------------------------------------------------------------
+ *  Crea el estado para analizar tramas con la funcion callback y escribir
+ *  los totales en *salida* cada *intervalo* segundos. Los lotes son de
+ *  analizador->tamanio_lote paquetes.
+ *
+ *  Devuelve NULL si el intervalo es cero o no hay memoria disponible.
+ */
+struct vivo* crear_vivo(struct s_analizador *analizador,
+                        const struct subred *lan,
+                        unsigned int intervalo,
+                        FILE *salida,
+                        int (*callback)(const struct s_analizador*,
+                                        const struct paquete*));
+
+/**
+ * agregar_trama(vivo, segundos, trama, largo, enlace)
+ * ---------------------------------------------------------------------------
+ *  Agrega una trama capturada en el instante *segundos*. Si la trama
+ *  pertenece a un intervalo posterior al actual, primero se cierra el
+ *  intervalo actual.
+ *
+ *  Devuelve 0 si la trama se agrego al lote, -1 si se descarto (ver
+ *  decodificar_paquete).
+ */
+int agregar_trama(struct vivo *vivo, time_t segundos, const u_int8_t *trama,
+                  u_int32_t largo, int enlace);
+
+/**
+ * avanzar_reloj(vivo, ahora)
+ * ---------------------------------------------------------------------------
+ *  Cierra el intervalo actual si termino antes de *ahora*. Se llama cuando
+ *  no se capturan tramas para que los totales se escriban igual al final de
+ *  cada intervalo.
+ *
+ *  Devuelve 1 si se cerro el intervalo, 0 en caso contrario.
+ */
+int avanzar_reloj(struct vivo *vivo, time_t ahora);
+
+/**
+ * cerrar_intervalo(vivo)
+ * ---------------------------------------------------------------------------
+ *  Analiza el lote pendiente, escribe los totales de las clases y los vuelve
+ *  a cero. Luego instala las clases recargadas, si hay. Se llama al terminar
+ *  la captura para escribir el ultimo intervalo, aunque este incompleto.
+ */
+void cerrar_intervalo(struct vivo *vivo);
+
+/**
+ * free_vivo(vivo)
+ * ---------------------------------------------------------------------------
+ *  Libera la memoria del estado. No cierra el intervalo actual.
+ */
+void free_vivo(struct vivo *vivo);
+
+#endif /* VIVO_H */
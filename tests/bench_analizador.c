@@ -0,0 +1,692 @@
+/**
+ * bench_analizador.c
+ * ==========================================================================
+ * Mide el rendimiento de la clasificacion de paquetes con cargas sinteticas
+ * reproducibles.
+ *
+ * Se generan N clases de trafico con M subredes y K puertos cada una, y un
+ * flujo de paquetes donde una proporcion configurable de los paquetes repite
+ * un flujo anterior (localidad). Por cada cantidad de clases, cantidad de
+ * hilos y modo de analisis se mide el tiempo de analizar_paquete() sobre todos
+ * los paquetes.
+ *
+ * Cada medicion se escribe en la salida estandar como un objeto JSON por
+ * linea, para poder comparar resultados entre versiones.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <omp.h>
+#include "../src/analizador.h"
+#include "../src/fuente.h"
+#include "../src/columnas.h"
+#include "../src/copia.h"
+
+#define MAX_VALORES 16 /* cantidad maxima de valores de una lista */
+
+/*
+ * Modos de analisis medidos.
+ */
+enum modo {
+    LINEAL = 0, /* compara cada paquete con todas las clases */
+    VECTORIAL = 1, /* igual que LINEAL con las subredes en vectores */
+    INDICE = 2, /* busca en el indice compilado */
+    CACHE = 3 /* busca en la cache de flujos y luego en el indice */
+};
+
+static const char *nombres_modo[] = {"lineal", "vectorial", "indice",
+                                      "cache"};
+
+/*
+ * struct configuracion
+ * ---------------------------------------------------------------------------
+ * Parametros de la carga sintetica.
+ */
+struct configuracion {
+    int clases[MAX_VALORES]; /* cantidades de clases a medir */
+    int cant_clases;
+    int hilos[MAX_VALORES]; /* cantidades de hilos a medir */
+    int cant_hilos;
+    int subredes; /* subredes por grupo de cada clase */
+    int puertos; /* puertos por grupo de cada clase */
+    int paquetes; /* paquetes analizados por medicion */
+    int flujos; /* flujos distintos que se repiten */
+    double localidad; /* probabilidad de repetir un flujo */
+    int repeticiones; /* se informa la mejor de las repeticiones */
+    int lineal; /* si es distinto de cero se mide el modo lineal */
+    int subredes_micro; /* si es distinto de cero se mide coincide_subred() */
+    int copia; /* si es distinto de cero se mide decodificar_copia() */
+    unsigned int semilla;
+};
+
+/*
+ * aleatorio
+ * ---------------------------------------------------------------------------
+ *  Generador de numeros pseudoaleatorios (xorshift) con estado propio, para
+ *  que la carga no dependa de la implementacion de rand().
+ */
+static u_int32_t aleatorio(u_int32_t *estado)
+{
+    u_int32_t x = *estado;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *estado = x;
+}
+
+/*
+ * puerto_aleatorio
+ * ---------------------------------------------------------------------------
+ *  Devuelve un puerto conocido con mayor probabilidad que uno efimero.
+ */
+static int puerto_aleatorio(u_int32_t *estado)
+{
+    const int conocidos[] = {22, 25, 53, 80, 110, 143, 443, 993, 3306, 5222,
+                             8080, 8443};
+    if (aleatorio(estado) % 4)
+        return conocidos[aleatorio(estado) % 12];
+    return 1024 + aleatorio(estado) % 64512;
+}
+
+/*
+ * crear_subredes
+ * ---------------------------------------------------------------------------
+ *  Crea un array de subredes con prefijos entre /8 y /32.
+ */
+static struct subred* crear_subredes(int cantidad, u_int32_t *estado)
+{
+    struct subred *subredes = malloc(sizeof(struct subred) * cantidad);
+    int i, prefijo;
+    for (i = 0; i < cantidad; i++) {
+        prefijo = 8 + aleatorio(estado) % 25;
+        subredes[i].mascara = prefijo == 32 ? MASCARA_HOST :
+                                              GET_MASCARA(prefijo);
+        subredes[i].prefijo = prefijo;
+        subredes[i].red.s_addr = aleatorio(estado) & subredes[i].mascara;
+    }
+    return subredes;
+}
+
+/*
+ * crear_puertos
+ * ---------------------------------------------------------------------------
+ *  Crea un array de puertos TCP, UDP o de cualquier protocolo.
+ */
+static struct puerto* crear_puertos(int cantidad, u_int32_t *estado)
+{
+    const int protocolos[] = {0, IPPROTO_TCP, IPPROTO_UDP};
+    struct puerto *puertos = malloc(sizeof(struct puerto) * cantidad);
+    int i;
+    for (i = 0; i < cantidad; i++) {
+        puertos[i].numero = puerto_aleatorio(estado);
+        puertos[i].protocolo = protocolos[aleatorio(estado) % 3];
+    }
+    return puertos;
+}
+
+/*
+ * generar_clases
+ * ---------------------------------------------------------------------------
+ *  Crea la clase por defecto y *cantidad* clases con subredes outside e
+ *  inside y puertos outside. Las subredes inside se eligen de la LAN
+ *  192.168.0.0/16 y algunas clases no definen puertos.
+ */
+static struct clase* generar_clases(int cantidad,
+                                    const struct configuracion *cfg,
+                                    u_int32_t *estado)
+{
+    struct clase *clases = calloc(cantidad + 1, sizeof(struct clase));
+    struct clase *clase;
+    int i, j;
+    strcpy(clases->nombre, "Default");
+    for (i = 1; i <= cantidad; i++) {
+        clase = clases + i;
+        clase->id = i;
+        snprintf(clase->nombre, LONG_NOMBRE, "clase %d", i);
+        clase->cant_subredes_outside = cfg->subredes;
+        clase->subredes_outside = crear_subredes(cfg->subredes, estado);
+        clase->cant_subredes_inside = aleatorio(estado) % 2;
+        clase->subredes_inside = crear_subredes(1, estado);
+        for (j = 0; j < clase->cant_subredes_inside; j++) {
+            clase->subredes_inside[j].red.s_addr &= htonl(0x0000ffff);
+            clase->subredes_inside[j].red.s_addr |= htonl(0xc0a80000);
+            clase->subredes_inside[j].red.s_addr &=
+                clase->subredes_inside[j].mascara;
+        }
+        clase->cant_puertos_outside = aleatorio(estado) % 4 ? cfg->puertos :
+                                                              0;
+        clase->puertos_outside = crear_puertos(cfg->puertos, estado);
+        clase->cant_puertos_inside = 0;
+        clase->puertos_inside = NULL;
+    }
+    return clases;
+}
+
+/*
+ * paquete_sintetico
+ * ---------------------------------------------------------------------------
+ *  Crea un paquete entre un host de la LAN y un host de Internet. La mitad de
+ *  los hosts de Internet pertenece a alguna subred de alguna clase, para que
+ *  exista una proporcion realista de coincidencias.
+ */
+static void paquete_sintetico(struct paquete *paquete,
+                              const struct clase *clases, int cant_clases,
+                              u_int32_t *estado)
+{
+    const struct clase *clase;
+    const struct subred *subred;
+    u_int32_t lan, internet;
+    int saliente = aleatorio(estado) % 2;
+    lan = htonl(0xc0a80000 | (aleatorio(estado) & 0xffff));
+    internet = aleatorio(estado);
+    if (aleatorio(estado) % 2) {
+        clase = clases + 1 + aleatorio(estado) % cant_clases;
+        subred = clase->subredes_outside +
+                 aleatorio(estado) % clase->cant_subredes_outside;
+        internet = subred->red.s_addr | (internet & ~subred->mascara);
+    }
+    paquete->ip_origen.s_addr = saliente ? lan : internet;
+    paquete->ip_destino.s_addr = saliente ? internet : lan;
+    paquete->puerto_origen = saliente ?
+                             (int) (1024 + aleatorio(estado) % 64512) :
+                             puerto_aleatorio(estado);
+    paquete->puerto_destino = saliente ? puerto_aleatorio(estado) :
+                              (int) (1024 + aleatorio(estado) % 64512);
+    paquete->protocolo = aleatorio(estado) % 4 ? IPPROTO_TCP : IPPROTO_UDP;
+    paquete->direccion = saliente ? SALIENTE : ENTRANTE;
+    paquete->bytes = 40 + aleatorio(estado) % 1460;
+    paquete->cantidad = 1;
+}
+
+/*
+ * crear_paquetes
+ * ---------------------------------------------------------------------------
+ *  Crea el flujo de paquetes. Con probabilidad *localidad* un paquete repite
+ *  uno de los *flujos* flujos conocidos, caso contrario es un flujo nuevo.
+ */
+static struct paquete* crear_paquetes(const struct clase *clases,
+                                      int cant_clases,
+                                      const struct configuracion *cfg,
+                                      u_int32_t *estado)
+{
+    struct paquete *paquetes = malloc(sizeof(struct paquete) * cfg->paquetes);
+    struct paquete *flujos = malloc(sizeof(struct paquete) * cfg->flujos);
+    u_int32_t umbral = (u_int32_t) (cfg->localidad * 0xffffffffu);
+    int i;
+    for (i = 0; i < cfg->flujos; i++)
+        paquete_sintetico(flujos + i, clases, cant_clases, estado);
+    for (i = 0; i < cfg->paquetes; i++) {
+        if (aleatorio(estado) < umbral) {
+            paquetes[i] = flujos[aleatorio(estado) % cfg->flujos];
+            paquetes[i].bytes = 40 + aleatorio(estado) % 1460;
+        } else {
+            paquete_sintetico(paquetes + i, clases, cant_clases, estado);
+        }
+    }
+    free(flujos);
+    return paquetes;
+}
+
+/*
+ * medir
+ * ---------------------------------------------------------------------------
+ *  Analiza todos los paquetes con la cantidad de hilos pasada por parametro y
+ *  devuelve el tiempo en segundos. Los paquetes se analizan con
+ *  analizar_fuente(), igual que los de la base de datos o de un archivo de
+ *  captura.
+ */
+static double medir(struct s_analizador *analizador,
+                    const struct paquete *paquetes, int cantidad, int hilos)
+{
+    struct fuente fuente;
+    double inicio;
+    if (fuente_memoria(&fuente, paquetes, cantidad) < 0) {
+        fprintf(stderr, "Error al crear la fuente de paquetes\n");
+        exit(EXIT_FAILURE);
+    }
+    omp_set_num_threads(hilos);
+    inicio = omp_get_wtime();
+    analizar_fuente(analizador, &fuente, analizar_paquete);
+    reducir_contadores(analizador);
+    return omp_get_wtime() - inicio;
+}
+
+/*
+ * medir_modo
+ * ---------------------------------------------------------------------------
+ *  Prepara el analizador para el modo pasado por parametro y escribe el
+ *  mejor tiempo de las repeticiones.
+ */
+static void medir_modo(struct s_analizador *analizador, enum modo modo,
+                       const struct paquete *paquetes,
+                       const struct configuracion *cfg, int hilos)
+{
+    u_int64_t aciertos = 0, fallos = 0;
+    double tiempo, mejor = -1;
+    int r;
+    free_analizador(analizador);
+    if (modo >= INDICE && compilar_clases(analizador) < 0) {
+        fprintf(stderr, "Error al compilar las clases de trafico\n");
+        exit(EXIT_FAILURE);
+    }
+    if (modo == VECTORIAL && vectorizar_clases(analizador) < 0) {
+        fprintf(stderr, "Error al crear los vectores de subredes\n");
+        exit(EXIT_FAILURE);
+    }
+    if (iniciar_contadores(analizador) < 0) {
+        fprintf(stderr, "Error al crear los contadores de bytes\n");
+        exit(EXIT_FAILURE);
+    }
+    for (r = 0; r < cfg->repeticiones; r++) {
+        /* cada repeticion empieza con la cache vacia */
+        if (modo == CACHE && iniciar_cache(analizador) < 0) {
+            fprintf(stderr, "Error al crear la cache de flujos\n");
+            exit(EXIT_FAILURE);
+        }
+        tiempo = medir(analizador, paquetes, cfg->paquetes, hilos);
+        if (mejor < 0 || tiempo < mejor) {
+            mejor = tiempo;
+            estadisticas_cache(analizador, &aciertos, &fallos);
+        }
+    }
+    printf("{\"modo\": \"%s\", \"clases\": %d, \"subredes\": %d, "
+           "\"puertos\": %d, \"hilos\": %d, \"paquetes\": %d, "
+           "\"localidad\": %.2f, \"segundos\": %.6f, "
+           "\"paquetes_por_segundo\": %.0f, \"ns_por_paquete\": %.2f, "
+           "\"aciertos_cache\": %" PRIu64 ", \"fallos_cache\": %" PRIu64 "}\n",
+           nombres_modo[modo],
+           analizador->cant_clases - 1,
+           cfg->subredes,
+           cfg->puertos,
+           hilos,
+           cfg->paquetes,
+           cfg->localidad,
+           mejor,
+           cfg->paquetes / mejor,
+           mejor * 1e9 / cfg->paquetes,
+           aciertos,
+           fallos);
+    fflush(stdout);
+}
+
+/*
+ * prefijo_ciclo
+ * ---------------------------------------------------------------------------
+ *  Calcula el prefijo comparando la mascara con la de cada longitud, como se
+ *  hacia en cada coincidencia antes de guardar el prefijo en struct subred.
+ */
+static int prefijo_ciclo(u_int32_t mascara)
+{
+    int i;
+    if (mascara == MASCARA_HOST)
+        return 32;
+    for (i = 0; i < 32; i++)
+        if (mascara == GET_MASCARA(i))
+            return i;
+    return -1;
+}
+
+/*
+ * coincide_subred_ciclo
+ * ---------------------------------------------------------------------------
+ *  Igual que coincide_subred() pero calcula el prefijo de cada subred que
+ *  coincide con prefijo_ciclo().
+ */
+static int coincide_subred_ciclo(const struct paquete *paquete,
+                                 const struct subred *subredes, int cantidad,
+                                 int grupo)
+{
+    struct in_addr ip = ip_grupo(paquete, grupo);
+    const struct subred *subred;
+    int i, p, puntos = cantidad == 0;
+    for (i = 0; i < cantidad; i++) {
+        subred = subredes + i;
+        if (en_subred(ip, subred)) {
+            p = prefijo_ciclo(subred->mascara);
+            if (p > puntos)
+                puntos = p;
+        }
+    }
+    return puntos;
+}
+
+/*
+ * medir_subredes
+ * ---------------------------------------------------------------------------
+ *  Mide coincide_subred() con una clase de cfg->subredes subredes y
+ *  cfg->paquetes paquetes, de los que tres de cada cuatro pertenecen a
+ *  alguna subred, como en test_coincide_muchas_subredes. Se compara con el
+ *  prefijo guardado en cada subred y calculado en cada coincidencia, y se
+ *  escribe la diferencia por coincidencia.
+ */
+static void medir_subredes(const struct configuracion *cfg)
+{
+    int (*funciones[])(const struct paquete*, const struct subred*, int,
+                       int) = {coincide_subred, coincide_subred_ciclo};
+    struct subred *subredes, *subred;
+    struct paquete *paquetes;
+    u_int64_t puntos[2], coincidencias = 0;
+    double tiempo, mejor[2];
+    u_int32_t estado = cfg->semilla;
+    int f, r, i;
+
+    subredes = crear_subredes(cfg->subredes, &estado);
+    paquetes = calloc(cfg->paquetes, sizeof(struct paquete));
+    for (i = 0; i < cfg->paquetes; i++) {
+        paquetes[i].ip_origen.s_addr = aleatorio(&estado);
+        if (aleatorio(&estado) % 4) {
+            subred = subredes + aleatorio(&estado) % cfg->subredes;
+            paquetes[i].ip_origen.s_addr &= ~subred->mascara;
+            paquetes[i].ip_origen.s_addr |= subred->red.s_addr;
+        }
+        paquetes[i].direccion = ENTRANTE;
+        for (subred = subredes; subred < subredes + cfg->subredes; subred++)
+            coincidencias += en_subred(paquetes[i].ip_origen, subred);
+    }
+    for (f = 0; f < 2; f++) {
+        mejor[f] = -1;
+        for (r = 0; r < cfg->repeticiones; r++) {
+            puntos[f] = 0;
+            tiempo = omp_get_wtime();
+            for (i = 0; i < cfg->paquetes; i++)
+                puntos[f] += funciones[f](paquetes + i, subredes,
+                                          cfg->subredes, GRUPO_OUTSIDE);
+            tiempo = omp_get_wtime() - tiempo;
+            if (mejor[f] < 0 || tiempo < mejor[f])
+                mejor[f] = tiempo;
+        }
+    }
+    if (puntos[0] != puntos[1]) {
+        fprintf(stderr, "Los puntajes de coincide_subred() no coinciden\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("{\"modo\": \"coincide_subred\", \"subredes\": %d, "
+           "\"paquetes\": %d, \"coincidencias\": %" PRIu64 ", "
+           "\"ns_por_paquete\": %.2f, \"ns_por_paquete_ciclo\": %.2f, "
+           "\"ns_por_coincidencia_ahorrados\": %.2f}\n",
+           cfg->subredes,
+           cfg->paquetes,
+           coincidencias,
+           mejor[0] * 1e9 / cfg->paquetes,
+           mejor[1] * 1e9 / cfg->paquetes,
+           coincidencias > 0 ? (mejor[1] - mejor[0]) * 1e9 / coincidencias :
+                               0);
+    fflush(stdout);
+    free(subredes);
+    free(paquetes);
+}
+
+/*
+ * campo_copia
+ * ---------------------------------------------------------------------------
+ *  Escribe un campo de COPY binario de *largo* bytes y devuelve la posicion
+ *  siguiente.
+ */
+static unsigned char* campo_copia(unsigned char *p, u_int64_t valor,
+                                  int largo)
+{
+    int i;
+    p[0] = p[1] = p[2] = 0;
+    p[3] = largo;
+    for (i = 0; i < largo; i++)
+        p[4 + i] = valor >> (8 * (largo - 1 - i));
+    return p + 4 + largo;
+}
+
+/*
+ * medir_copia
+ * ---------------------------------------------------------------------------
+ *  Mide la decodificacion de cfg->paquetes filas de paquetes en un lote por
+ *  columnas, con las filas en el formato binario de COPY (ver copia.h) y en
+ *  texto, como las recibe el cursor de ECPG, que convierte cada columna con
+ *  strtoll(). Cada fila se decodifica por separado, como llega de libpq. Se
+ *  escriben el tiempo y los bytes por fila de cada formato.
+ */
+static void medir_copia(const struct configuracion *cfg)
+{
+    const int largo_fila = 2 + 7 * (4 + 4) + 4 + 8;
+    const unsigned char cabecera[COPIA_CABECERA] = "PGCOPY\n\377\r\n";
+    struct lote_columnas *lote = crear_lote_columnas(TAMANIO_LOTE);
+    struct lector_copia lector;
+    unsigned char *binario = malloc((size_t) largo_fila * cfg->paquetes);
+    char *texto = malloc((size_t) 64 * cfg->paquetes), *fin;
+    int *inicio_texto = malloc(sizeof(int) * (cfg->paquetes + 1));
+    u_int64_t valores[COPIA_CAMPOS], suma[2];
+    u_int32_t estado = cfg->semilla;
+    double tiempo, mejor[2];
+    unsigned char *p = binario;
+    int f, r, i, j, largo_texto = 0;
+
+    for (i = 0; i < cfg->paquetes; i++) {
+        valores[0] = aleatorio(&estado) >> 1;
+        valores[1] = aleatorio(&estado) >> 1;
+        valores[2] = puerto_aleatorio(&estado);
+        valores[3] = puerto_aleatorio(&estado);
+        valores[4] = aleatorio(&estado) % 2 ? IPPROTO_TCP : IPPROTO_UDP;
+        valores[5] = 40 + aleatorio(&estado) % 1460;
+        valores[6] = aleatorio(&estado) % 2;
+        valores[7] = 1;
+        p[0] = 0;
+        p[1] = COPIA_CAMPOS;
+        p += 2;
+        for (j = 0; j < COPIA_CAMPOS; j++)
+            p = campo_copia(p, valores[j], j == 5 ? 8 : 4);
+        inicio_texto[i] = largo_texto;
+        for (j = 0; j < COPIA_CAMPOS; j++)
+            largo_texto += sprintf(texto + largo_texto, "%" PRIu64 "%c",
+                                   valores[j],
+                                   j < COPIA_CAMPOS - 1 ? '\t' : '\n');
+    }
+    inicio_texto[cfg->paquetes] = largo_texto;
+
+    for (f = 0; f < 2; f++) {
+        mejor[f] = -1;
+        for (r = 0; r < cfg->repeticiones; r++) {
+            suma[f] = 0;
+            lote->filas = 0;
+            memset(&lector, 0, sizeof(struct lector_copia));
+            decodificar_copia(&lector, (const char *) cabecera,
+                              COPIA_CABECERA, lote);
+            tiempo = omp_get_wtime();
+            for (i = 0; i < cfg->paquetes; i++) {
+                if (lote->filas == lote->capacidad) {
+                    suma[f] += lote->bytes[lote->filas - 1];
+                    lote->filas = 0;
+                }
+                if (f == 0) {
+                    decodificar_copia(&lector,
+                                      (const char *) binario +
+                                      (size_t) largo_fila * i,
+                                      largo_fila, lote);
+                    continue;
+                }
+                fin = texto + inicio_texto[i];
+                for (j = 0; j < COPIA_CAMPOS; j++)
+                    valores[j] = strtoll(fin, &fin, 10);
+                j = lote->filas++;
+                lote->ip_origen[j] = htonl(valores[0]);
+                lote->ip_destino[j] = htonl(valores[1]);
+                lote->puerto_origen[j] = valores[2];
+                lote->puerto_destino[j] = valores[3];
+                lote->protocolo[j] = valores[4];
+                lote->bytes[j] = valores[5];
+                lote->direccion[j] = valores[6];
+                lote->cantidad[j] = valores[7];
+            }
+            tiempo = omp_get_wtime() - tiempo;
+            if (mejor[f] < 0 || tiempo < mejor[f])
+                mejor[f] = tiempo;
+        }
+    }
+    if (suma[0] != suma[1]) {
+        fprintf(stderr, "Las filas binarias y de texto no coinciden\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("{\"modo\": \"copia\", \"filas\": %d, "
+           "\"ns_por_fila_binario\": %.2f, \"ns_por_fila_texto\": %.2f, "
+           "\"bytes_por_fila_binario\": %d, "
+           "\"bytes_por_fila_texto\": %.2f}\n",
+           cfg->paquetes,
+           mejor[0] * 1e9 / cfg->paquetes,
+           mejor[1] * 1e9 / cfg->paquetes,
+           largo_fila,
+           (double) largo_texto / cfg->paquetes);
+    fflush(stdout);
+    free_lote_columnas(lote);
+    free(binario);
+    free(texto);
+    free(inicio_texto);
+}
+
+/*
+ * lista
+ * ---------------------------------------------------------------------------
+ *  Obtiene una lista de enteros positivos separados por coma. Devuelve la
+ *  cantidad de valores o cero si la lista no es valida.
+ */
+static int lista(const char *texto, int *valores)
+{
+    int cantidad = 0, consumidos;
+    while (cantidad < MAX_VALORES &&
+           sscanf(texto, "%d%n", valores + cantidad, &consumidos) == 1 &&
+           valores[cantidad] > 0) {
+        cantidad++;
+        texto += consumidos;
+        if (*texto != ',')
+            break;
+        texto++;
+    }
+    return *texto == '\0' ? cantidad : 0;
+}
+
+/*
+ * ayuda
+ * ---------------------------------------------------------------------------
+ *  Muestra mensaje de ayuda.
+ */
+static void ayuda(const char *programa)
+{
+    printf("Uso: %s [opciones]\n\n"
+           "Opciones:\n"
+           "  -c LISTA   Cantidades de clases (por defecto 10,100,1000).\n"
+           "  -t LISTA   Cantidades de hilos (por defecto 1,2,4,... hasta "
+                         "la cantidad de procesadores).\n"
+           "  -m N       Subredes outside por clase (por defecto 4).\n"
+           "  -k N       Puertos outside por clase (por defecto 4).\n"
+           "  -p N       Paquetes por medicion (por defecto 1000000).\n"
+           "  -f N       Flujos que se repiten (por defecto 10000).\n"
+           "  -x P       Probabilidad de repetir un flujo entre 0 y 1 "
+                         "(por defecto 0.9).\n"
+           "  -r N       Repeticiones de cada medicion (por defecto 3).\n"
+           "  -s N       Semilla (por defecto 106).\n"
+           "  -l         Mide tambien la comparacion con todas las clases, "
+                         "con y sin vectores de subredes.\n"
+           "  -u         Mide tambien coincide_subred() con el prefijo "
+                         "guardado y calculado en cada coincidencia.\n"
+           "  -b         Mide tambien la decodificacion de filas de COPY "
+                         "binario y de texto.\n",
+           programa);
+}
+
+/*
+ * argumentos
+ * ---------------------------------------------------------------------------
+ *  Obtiene la configuracion de los argumentos del programa.
+ */
+static void argumentos(int argc, const char *argv[],
+                       struct configuracion *cfg)
+{
+    int i, maximo = omp_get_max_threads();
+    memset(cfg, 0, sizeof(struct configuracion));
+    cfg->cant_clases = lista("10,100,1000", cfg->clases);
+    for (i = 1; i <= maximo && cfg->cant_hilos < MAX_VALORES; i *= 2)
+        cfg->hilos[cfg->cant_hilos++] = i;
+    if (cfg->hilos[cfg->cant_hilos - 1] != maximo &&
+            cfg->cant_hilos < MAX_VALORES)
+        cfg->hilos[cfg->cant_hilos++] = maximo;
+    cfg->subredes = 4;
+    cfg->puertos = 4;
+    cfg->paquetes = 1000000;
+    cfg->flujos = 10000;
+    cfg->localidad = 0.9;
+    cfg->repeticiones = 3;
+    cfg->semilla = 106;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0) {
+            cfg->lineal = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-u") == 0) {
+            cfg->subredes_micro = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-b") == 0) {
+            cfg->copia = 1;
+            continue;
+        }
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            ayuda(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        switch (argv[i][1]) {
+            case 'c': cfg->cant_clases = lista(argv[++i], cfg->clases); break;
+            case 't': cfg->cant_hilos = lista(argv[++i], cfg->hilos); break;
+            case 'm': cfg->subredes = atoi(argv[++i]); break;
+            case 'k': cfg->puertos = atoi(argv[++i]); break;
+            case 'p': cfg->paquetes = atoi(argv[++i]); break;
+            case 'f': cfg->flujos = atoi(argv[++i]); break;
+            case 'x': cfg->localidad = atof(argv[++i]); break;
+            case 'r': cfg->repeticiones = atoi(argv[++i]); break;
+            case 's': cfg->semilla = atoi(argv[++i]); break;
+            default: ayuda(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    if (cfg->cant_clases == 0 || cfg->cant_hilos == 0 || cfg->subredes <= 0 ||
+            cfg->puertos < 0 || cfg->paquetes <= 0 || cfg->flujos <= 0 ||
+            cfg->localidad < 0 || cfg->localidad > 1 ||
+            cfg->repeticiones <= 0 || cfg->semilla == 0) {
+        ayuda(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    struct configuracion cfg;
+    struct s_analizador analizador;
+    struct clase *clases;
+    struct paquete *paquetes;
+    u_int32_t estado;
+    int c, h, m, j;
+
+    argumentos(argc, argv, &cfg);
+    if (cfg.subredes_micro)
+        medir_subredes(&cfg);
+    if (cfg.copia)
+        medir_copia(&cfg);
+    for (c = 0; c < cfg.cant_clases; c++) {
+        /* la carga depende solo de la semilla y de la cantidad de clases */
+        estado = cfg.semilla;
+        clases = generar_clases(cfg.clases[c], &cfg, &estado);
+        paquetes = crear_paquetes(clases, cfg.clases[c], &cfg, &estado);
+        memset(&analizador, 0, sizeof(struct s_analizador));
+        analizador.clases = clases;
+        analizador.cant_clases = cfg.clases[c] + 1;
+        for (h = 0; h < cfg.cant_hilos; h++) {
+            for (m = cfg.lineal ? LINEAL : INDICE; m <= CACHE; m++)
+                medir_modo(&analizador, m, paquetes, &cfg, cfg.hilos[h]);
+        }
+        free_analizador(&analizador);
+        for (j = 0; j <= cfg.clases[c]; j++) {
+            free(clases[j].subredes_outside);
+            free(clases[j].subredes_inside);
+            free(clases[j].puertos_outside);
+        }
+        free(clases);
+        free(paquetes);
+    }
+    return 0;
+}
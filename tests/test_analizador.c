@@ -1,12 +1,26 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <omp.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include "../src/analizador.h"
 #include "../src/bd.h"
+#include "../src/indice.h"
+#include "../src/ventana.h"
+#include "../src/instantanea.h"
+#include "../src/captura.h"
+#include "../src/vivo.h"
+#include "../src/fuente.h"
+#include "../src/subredes.h"
+#include "../src/columnas.h"
+#include "../src/recarga.h"
+#include "../src/copia.h"
+#include "../src/cola.h"
+#include "../src/metricas.h"
 
 #define MASCARA_0  htonl(0x0)
 #define MASCARA_8  htonl(0xff000000)
@@ -85,6 +99,7 @@ void crear_clase(struct clase* clase, const char *red, int prefijo) {
     clase->subredes_outside = (struct subred *) malloc(sizeof(struct subred));
     inet_aton("10.1.0.0", &(clase->subredes_outside->red));
     clase->subredes_outside->mascara = GET_MASCARA(16);
+    clase->subredes_outside->prefijo = 16;
 }
 
 /*
@@ -114,12 +129,14 @@ void test_coincide_subred() {
     a.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("192.168.0.0", &(a.subredes_outside->red));
     a.subredes_outside->mascara = GET_MASCARA(16);
+    a.subredes_outside->prefijo = prefijo(a.subredes_outside->mascara);
 
     init_clase(&b);
     b.cant_subredes_outside = 1;
     b.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("10.0.0.0", &(b.subredes_outside->red));
     b.subredes_outside->mascara = GET_MASCARA(16);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
 
     /* creo paquete */
     inet_aton("192.168.122.177", &(x.ip_origen));
@@ -166,15 +183,23 @@ void test_coincide_muchas_subredes() {
     inet_aton("172.17.0.0", &((a.subredes_outside + 1)->red));
     inet_aton("172.17.1.0", &((a.subredes_outside + 2)->red));
     a.subredes_outside->mascara = GET_MASCARA(16);
+    a.subredes_outside->prefijo = prefijo(a.subredes_outside->mascara);
     (a.subredes_outside + 1)->mascara = GET_MASCARA(24);
+    (a.subredes_outside + 1)->prefijo =
+            prefijo((a.subredes_outside + 1)->mascara);
     (a.subredes_outside + 2)->mascara = GET_MASCARA(24);
+    (a.subredes_outside + 2)->prefijo =
+            prefijo((a.subredes_outside + 2)->mascara);
 
     b.cant_subredes_outside = 2;
     b.subredes_outside = malloc(2 * sizeof(struct subred));
     inet_aton("10.0.0.0", &(b.subredes_outside->red));
     inet_aton("177.200.1.0", &((b.subredes_outside + 1)->red));
     b.subredes_outside->mascara = GET_MASCARA(16);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
     (b.subredes_outside + 1)->mascara = GET_MASCARA(25);
+    (b.subredes_outside + 1)->prefijo =
+            prefijo((b.subredes_outside + 1)->mascara);
 
     /* creo paquete */
     inet_aton("177.200.1.128", &(x.ip_origen));
@@ -216,18 +241,22 @@ void test_coincide_subred_origen_destino() {
     a.subredes_outside = malloc(sizeof(struct subred)); /* outside */
     inet_aton("192.168.0.0", &(a.subredes_outside->red));
     a.subredes_outside->mascara = GET_MASCARA(24);
+    a.subredes_outside->prefijo = prefijo(a.subredes_outside->mascara);
     a.subredes_inside = malloc(sizeof(struct subred)); /* inside */
     inet_aton("192.168.1.0", &(a.subredes_inside->red));
     a.subredes_inside->mascara = GET_MASCARA(24);
+    a.subredes_inside->prefijo = prefijo(a.subredes_inside->mascara);
 
     b.cant_subredes_outside = 1;
     b.cant_subredes_inside = 1;
     b.subredes_outside = malloc(sizeof(struct subred)); /* outside */
     inet_aton("192.168.0.0", &(b.subredes_outside->red));
     b.subredes_outside->mascara = GET_MASCARA(24);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
     b.subredes_inside = malloc(sizeof(struct subred)); /* inside */
     inet_aton("10.0.0.0", &(b.subredes_inside->red));
     b.subredes_inside->mascara = GET_MASCARA(8);
+    b.subredes_inside->prefijo = prefijo(b.subredes_inside->mascara);
 
     /* creo paquete */
     inet_aton("192.168.1.1", &(x.ip_origen));
@@ -240,6 +269,60 @@ void test_coincide_subred_origen_destino() {
     assert(coincide(&b, &x) == 0);
 }
 
+/*
+ * test_coincide_prefijo_mas_largo
+ * --------------------------------------------------------------------------
+ *  Prueba que el puntaje de coincidencia por subred sea el prefijo mas largo
+ *  de las subredes que contienen a la ip, sin importar el orden en el que
+ *  fueron definidas.
+ *
+ *  En este caso de prueba se establecen los siguiente valores:
+ *
+ *  clase trafico   | direccion de red | prefijo
+ *  --------------- + ---------------- + --------
+ *  a               | 10.0.0.0         | 8
+ *                  | 10.1.0.0         | 16
+ *                  | 10.1.2.0         | 24
+ *
+ *  paquete | ip origen       | ip dest        | puntaje subred
+ *  ------- + --------------- + -------------- + --------------
+ *  x       | 192.168.1.1     | 10.1.2.3       | 24
+ *  y       | 192.168.1.1     | 10.1.3.3       | 16
+ *  z       | 192.168.1.1     | 10.2.3.3       | 8
+ */
+void test_coincide_prefijo_mas_largo() {
+    struct clase a;
+    struct paquete x;
+    init_clase(&a);
+    a.cant_subredes_outside = 3;
+    a.subredes_outside = malloc(3 * sizeof(struct subred));
+    inet_aton("10.0.0.0", &(a.subredes_outside->red));
+    inet_aton("10.1.0.0", &((a.subredes_outside + 1)->red));
+    inet_aton("10.1.2.0", &((a.subredes_outside + 2)->red));
+    a.subredes_outside->mascara = GET_MASCARA(8);
+    a.subredes_outside->prefijo = prefijo(a.subredes_outside->mascara);
+    (a.subredes_outside + 1)->mascara = GET_MASCARA(16);
+    (a.subredes_outside + 1)->prefijo =
+            prefijo((a.subredes_outside + 1)->mascara);
+    (a.subredes_outside + 2)->mascara = GET_MASCARA(24);
+    (a.subredes_outside + 2)->prefijo =
+            prefijo((a.subredes_outside + 2)->mascara);
+
+    inet_aton("192.168.1.1", &(x.ip_origen));
+    x.puerto_origen = 12345;
+    x.puerto_destino = 80;
+    x.protocolo = IPPROTO_TCP;
+    x.direccion = SALIENTE;
+
+    /* el puntaje de los grupos sin subredes ni puertos es 1 cada uno */
+    inet_aton("10.1.2.3", &(x.ip_destino));
+    assert(coincide(&a, &x) == 24 + 3);
+    inet_aton("10.1.3.3", &(x.ip_destino));
+    assert(coincide(&a, &x) == 16 + 3);
+    inet_aton("10.2.3.3", &(x.ip_destino));
+    assert(coincide(&a, &x) == 8 + 3);
+}
+
 /*
  * test_coincide_stress()
  * --------------------------------------------------------------------------
@@ -258,6 +341,7 @@ void test_coincide_stress(int cantidad_clases) {
     a.subredes_outside = malloc(sizeof(struct subred)); /* a */
     inet_aton("192.168.0.0", &(a.subredes_outside->red));
     a.subredes_outside->mascara = GET_MASCARA(24);
+    a.subredes_outside->prefijo = prefijo(a.subredes_outside->mascara);
 
     /* creo paquete */
     inet_aton("192.168.1.1", &(x.ip_origen));
@@ -309,6 +393,7 @@ void test_coincide_puerto() {
     b.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("10.0.0.0", &(b.subredes_outside->red));
     b.subredes_outside->mascara = GET_MASCARA(8);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
     b.puertos_outside = malloc(sizeof(struct puerto));
     b.puertos_outside->numero = 80;
     b.puertos_outside->protocolo = IPPROTO_TCP;
@@ -318,6 +403,7 @@ void test_coincide_puerto() {
     c.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("10.0.0.0", &(c.subredes_outside->red));
     c.subredes_outside->mascara = GET_MASCARA(8);
+    c.subredes_outside->prefijo = prefijo(c.subredes_outside->mascara);
     c.puertos_outside = malloc(sizeof(struct puerto));
     c.puertos_outside->numero = 22;
     c.puertos_outside->protocolo = IPPROTO_TCP;
@@ -382,6 +468,7 @@ void test_coincide_muchos_puertos() {
     b.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("10.0.0.0", &(b.subredes_outside->red));
     b.subredes_outside->mascara = GET_MASCARA(8);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
     b.puertos_outside = malloc(2 * sizeof(struct puerto));
     (b.puertos_outside)->numero = 80;
     (b.puertos_outside)->protocolo = IPPROTO_TCP;
@@ -462,6 +549,7 @@ void test_coincide_puerto_origen_destino() {
     b.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("10.0.0.0", &(b.subredes_outside->red));
     b.subredes_outside->mascara = GET_MASCARA(8);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
     b.puertos_outside = malloc(2 * sizeof(struct puerto));
     (b.puertos_outside)->numero = 80;
     (b.puertos_outside)->protocolo = 0;
@@ -480,9 +568,11 @@ void test_coincide_puerto_origen_destino() {
     c.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("192.168.122.177", &(c.subredes_outside->red));
     c.subredes_outside->mascara = MASCARA_HOST;
+    c.subredes_outside->prefijo = prefijo(c.subredes_outside->mascara);
     c.subredes_inside = malloc(sizeof(struct subred));
     inet_aton("200.150.0.0", &(c.subredes_inside->red));
     c.subredes_inside->mascara = GET_MASCARA(16);
+    c.subredes_inside->prefijo = prefijo(c.subredes_inside->mascara);
     c.puertos_outside = malloc(sizeof(struct puerto));
     c.puertos_outside->numero = 443;
     c.puertos_outside->protocolo = 0;
@@ -543,6 +633,7 @@ void test_coincide_protocolo() {
     b.subredes_outside = malloc(sizeof(struct subred));
     inet_aton("10.0.0.0", &(b.subredes_outside->red));
     b.subredes_outside->mascara = GET_MASCARA(8);
+    b.subredes_outside->prefijo = prefijo(b.subredes_outside->mascara);
     b.puertos_outside = malloc(sizeof(struct puerto));
     b.puertos_outside->numero = 22;
     b.puertos_outside->protocolo = IPPROTO_TCP;
@@ -583,6 +674,7 @@ void test_coincide_protocolo() {
  */
 void test_imprimir() {
     struct s_analizador analizador;
+    memset(&analizador, 0, sizeof(struct s_analizador));
     struct clase clases[4];
     /* creo clases de trafico */
     clases[0].id = 0;
@@ -590,18 +682,24 @@ void test_imprimir() {
     strncpy(clases[0].descripcion, "Proto ssh", LONG_DESCRIPCION);
     clases[0].bytes_subida = 25108;
     clases[0].bytes_bajada = 2105;
+    clases[0].paquetes_subida = 12;
+    clases[0].paquetes_bajada = 3;
 
     clases[1].id = 1;
     strncpy(clases[1].nombre, "HTTP", LONG_NOMBRE);
     strncpy(clases[1].descripcion, "Nav. Web", LONG_DESCRIPCION);
     clases[1].bytes_subida = 15;
     clases[1].bytes_bajada = 11020;
+    clases[1].paquetes_subida = 4;
+    clases[1].paquetes_bajada = 40;
 
     clases[2].id = 2;
     strncpy(clases[2].nombre, "DNS", LONG_NOMBRE);
     strncpy(clases[2].descripcion, "Serv. nombres", LONG_DESCRIPCION);
     clases[2].bytes_subida = 22111;
     clases[2].bytes_bajada = 53;
+    clases[2].paquetes_subida = 9;
+    clases[2].paquetes_bajada = 1;
 
     clases[3].id = 3;
     strncpy(clases[3].nombre, "No se debe mostrar", LONG_NOMBRE);
@@ -609,6 +707,8 @@ void test_imprimir() {
             LONG_DESCRIPCION);
     clases[3].bytes_subida = 0;
     clases[3].bytes_bajada = 0;
+    clases[3].paquetes_subida = 0;
+    clases[3].paquetes_bajada = 0;
 
     analizador.clases = clases;
     analizador.cant_clases = 4;
@@ -656,6 +756,7 @@ void test_imprimir() {
  */
 void test_analizar_paquete() {
     struct s_analizador analizador;
+    memset(&analizador, 0, sizeof(struct s_analizador));
     struct clase clases[3];
     struct paquete paquetes[4];
 
@@ -669,6 +770,8 @@ void test_analizar_paquete() {
     clases[1].subredes_inside = malloc(sizeof(struct subred));
     inet_aton("1.0.0.0", &(clases[1].subredes_inside->red));
     clases[1].subredes_inside->mascara = GET_MASCARA(8);
+    clases[1].subredes_inside->prefijo =
+            prefijo(clases[1].subredes_inside->mascara);
 
     init_clase(clases + 2);
     strncpy(clases[2].nombre, "c2", LONG_NOMBRE);
@@ -764,6 +867,7 @@ void test_analizar_paquete() {
  */
 void test_mejor_coincidencia() {
     struct s_analizador analizador;
+    memset(&analizador, 0, sizeof(struct s_analizador));
     struct clase clases[4];
     struct paquete paquete;
 
@@ -777,6 +881,8 @@ void test_mejor_coincidencia() {
     clases[1].subredes_inside = malloc(sizeof(struct subred));
     inet_aton("1.0.0.0", &(clases[1].subredes_inside->red));
     clases[1].subredes_inside->mascara = GET_MASCARA(8);
+    clases[1].subredes_inside->prefijo =
+            prefijo(clases[1].subredes_inside->mascara);
 
     init_clase(clases + 2);
     strncpy(clases[2].nombre, "c2", LONG_NOMBRE);
@@ -791,6 +897,8 @@ void test_mejor_coincidencia() {
     clases[3].subredes_inside = malloc(sizeof(struct subred));
     inet_aton("1.0.0.0", &(clases[3].subredes_inside->red));
     clases[3].subredes_inside->mascara = GET_MASCARA(8);
+    clases[3].subredes_inside->prefijo =
+            prefijo(clases[3].subredes_inside->mascara);
     clases[3].cant_puertos_outside = 1;
     clases[3].puertos_outside = malloc(sizeof(struct puerto));
     clases[3].puertos_outside->numero = 12;
@@ -832,6 +940,2113 @@ void test_prefijo() {
         assert(prefijo(GET_MASCARA(i)) == i);
 
     assert(prefijo(MASCARA_HOST) == 32);
+    /* mascaras con bits no contiguos */
+    assert(prefijo(htonl(0xff00ff00)) == -1);
+    assert(prefijo(htonl(0x00ffffff)) == -1);
+    assert(prefijo(htonl(0x00000001)) == -1);
+}
+
+/*
+ * clase_aleatoria
+ * ------------------------------------------------------------------
+ *  Funcion auxiliar que crea una clase de trafico con subredes y puertos
+ *  elegidos al azar de un conjunto reducido de valores, para que existan
+ *  coincidencias parciales y empates entre clases.
+ */
+void clase_aleatoria(struct clase *clase) {
+    const char *redes[] = {"10.0.0.0", "10.1.0.0", "10.1.2.0", "192.168.0.0",
+                           "192.168.1.0", "0.0.0.0", "8.8.8.8"};
+    const int prefijos[] = {8, 16, 24, 16, 24, 0, 32};
+    const int puertos[] = {22, 53, 80, 443, 8080};
+    const int protocolos[] = {0, IPPROTO_TCP, IPPROTO_UDP};
+    int i, r;
+
+    init_clase(clase);
+    clase->cant_subredes_outside = 1 + rand() % 3;
+    clase->cant_subredes_inside = rand() % 2;
+    clase->cant_puertos_outside = rand() % 3;
+    clase->cant_puertos_inside = rand() % 2;
+    clase->subredes_outside = malloc(3 * sizeof(struct subred));
+    clase->subredes_inside = malloc(3 * sizeof(struct subred));
+    clase->puertos_outside = malloc(3 * sizeof(struct puerto));
+    clase->puertos_inside = malloc(3 * sizeof(struct puerto));
+    for (i = 0; i < 3; i++) {
+        r = rand() % 7;
+        inet_aton(redes[r], &((clase->subredes_outside + i)->red));
+        (clase->subredes_outside + i)->mascara = prefijos[r] == 32 ?
+                                                 MASCARA_HOST :
+                                                 GET_MASCARA(prefijos[r]);
+        (clase->subredes_outside + i)->prefijo =
+                prefijo((clase->subredes_outside + i)->mascara);
+        r = rand() % 7;
+        inet_aton(redes[r], &((clase->subredes_inside + i)->red));
+        (clase->subredes_inside + i)->mascara = prefijos[r] == 32 ?
+                                                MASCARA_HOST :
+                                                GET_MASCARA(prefijos[r]);
+        (clase->subredes_inside + i)->prefijo =
+                prefijo((clase->subredes_inside + i)->mascara);
+        (clase->puertos_outside + i)->numero = puertos[rand() % 5];
+        (clase->puertos_outside + i)->protocolo = protocolos[rand() % 3];
+        (clase->puertos_inside + i)->numero = puertos[rand() % 5];
+        (clase->puertos_inside + i)->protocolo = protocolos[rand() % 3];
+    }
+}
+
+/*
+ * liberar_clase
+ * ------------------------------------------------------------------
+ *  Funcion auxiliar que libera las subredes y puertos de una clase creada
+ *  con clase_aleatoria.
+ */
+void liberar_clase(struct clase *clase) {
+    free(clase->subredes_outside);
+    free(clase->subredes_inside);
+    free(clase->puertos_outside);
+    free(clase->puertos_inside);
+}
+
+/*
+ * paquete_aleatorio
+ * ------------------------------------------------------------------
+ *  Funcion auxiliar que crea un paquete con valores elegidos al azar.
+ */
+void paquete_aleatorio(struct paquete *paquete) {
+    const char *ips[] = {"10.0.0.1", "10.1.0.1", "10.1.2.3", "192.168.0.5",
+                         "192.168.1.9", "8.8.8.8", "200.1.1.1"};
+    const int puertos[] = {22, 53, 80, 443, 8080, 12345};
+    const int protocolos[] = {IPPROTO_TCP, IPPROTO_UDP};
+
+    inet_aton(ips[rand() % 7], &(paquete->ip_origen));
+    inet_aton(ips[rand() % 7], &(paquete->ip_destino));
+    paquete->puerto_origen = puertos[rand() % 6];
+    paquete->puerto_destino = puertos[rand() % 6];
+    paquete->protocolo = protocolos[rand() % 2];
+    paquete->direccion = rand() % 2 ? SALIENTE : ENTRANTE;
+    paquete->bytes = 1 + rand() % 1500;
+    paquete->cantidad = 1;
+}
+
+/*
+ * test_indice
+ * --------------------------------------------------------------------------
+ *  Prueba que el analisis con las clases compiladas en un indice sume los
+ *  bytes de cada paquete a la misma clase que el analisis comparando el
+ *  paquete con todas las clases.
+ *
+ *  Se usan mas de 64 clases para que los conjuntos de clases ocupen mas de
+ *  una palabra.
+ */
+void test_indice() {
+    const int cant_clases = 150;
+    const int cant_paquetes = 20000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete paquete;
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    int i;
+
+    srand(106);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+
+    /* analizo sin indice */
+    srand(2016);
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        analizar_paquete(&analizador, &paquete);
+    }
+    for (i = 0; i < cant_clases; i++) {
+        esperado_subida[i] = clases[i].bytes_subida;
+        esperado_bajada[i] = clases[i].bytes_bajada;
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* analizo con indice los mismos paquetes */
+    assert(compilar_clases(&analizador) == 0);
+    assert(analizador.indice != NULL);
+    srand(2016);
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        analizar_paquete(&analizador, &paquete);
+    }
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+    }
+    free_analizador(&analizador);
+    assert(analizador.indice == NULL);
+}
+
+/*
+ * test_indice_protocolo
+ * --------------------------------------------------------------------------
+ *  Prueba la tabla de puertos del indice con protocolos que definen las
+ *  clases, con el protocolo comodin y con un protocolo que no define ninguna
+ *  clase.
+ *
+ *  clase trafico   | puerto o | protocolo
+ *  =============== + ======== + =========
+ *   default        |          |
+ * ---------------- + -------- + ---------
+ *   c1             | 53       | udp
+ * ---------------- + -------- + ---------
+ *   c2             | 53       | comodin
+ *
+ *  paquete | p_dest | protocolo | clase
+ *  ======= + ====== + ========= + =====
+ *   p0     | 53     | udp       | c1 (primera con igual puntaje)
+ *   p1     | 53     | tcp       | c2
+ *   p2     | 53     | icmp      | c2
+ *   p3     | 54     | udp       | default
+ */
+void test_indice_protocolo() {
+    struct s_analizador analizador;
+    struct clase clases[3];
+    struct paquete paquete;
+    const int protocolos[] = {IPPROTO_UDP, IPPROTO_TCP, IPPROTO_ICMP,
+                              IPPROTO_UDP};
+    const int puertos[] = {53, 53, 53, 54};
+    const int esperado[] = {1, 2, 2, 0};
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    init_clase(clases + 1);
+    clases[1].cant_puertos_outside = 1;
+    clases[1].puertos_outside = malloc(sizeof(struct puerto));
+    clases[1].puertos_outside->numero = 53;
+    clases[1].puertos_outside->protocolo = IPPROTO_UDP;
+    init_clase(clases + 2);
+    clases[2].cant_puertos_outside = 1;
+    clases[2].puertos_outside = malloc(sizeof(struct puerto));
+    clases[2].puertos_outside->numero = 53;
+    clases[2].puertos_outside->protocolo = 0;
+    analizador.clases = clases;
+    analizador.cant_clases = 3;
+    assert(compilar_clases(&analizador) == 0);
+
+    inet_aton("192.168.1.1", &(paquete.ip_origen));
+    inet_aton("8.8.8.8", &(paquete.ip_destino));
+    paquete.puerto_origen = 40000;
+    paquete.bytes = 10;
+    paquete.direccion = SALIENTE;
+    for (int i = 0; i < 4; i++) {
+        paquete.puerto_destino = puertos[i];
+        paquete.protocolo = protocolos[i];
+        for (int j = 0; j < 3; j++)
+            clases[j].bytes_subida = 0;
+        analizar_paquete(&analizador, &paquete);
+        assert(clases[esperado[i]].bytes_subida == 10);
+    }
+    free_analizador(&analizador);
+}
+
+/*
+ * test_contadores_hilos
+ * --------------------------------------------------------------------------
+ *  Prueba que al analizar paquetes en paralelo con contadores por hilo, la
+ *  suma de bytes de cada clase sea la misma que al analizarlos con un solo
+ *  hilo sumando directamente en las clases.
+ */
+void test_contadores_hilos() {
+    const int cant_clases = 20;
+    const int cant_paquetes = 100000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    int i;
+
+    srand(55);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    assert(compilar_clases(&analizador) == 0);
+    for (i = 0; i < cant_paquetes; i++)
+        paquete_aleatorio(paquetes + i);
+
+    /* analizo sin contadores por hilo */
+    for (i = 0; i < cant_paquetes; i++)
+        analizar_paquete(&analizador, paquetes + i);
+    for (i = 0; i < cant_clases; i++) {
+        esperado_subida[i] = clases[i].bytes_subida;
+        esperado_bajada[i] = clases[i].bytes_bajada;
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* analizo en paralelo con contadores por hilo */
+    assert(iniciar_contadores(&analizador) == 0);
+    assert((uintptr_t) analizador.contadores % LINEA_CACHE == 0);
+    #pragma omp parallel for
+    for (i = 0; i < cant_paquetes; i++)
+        analizar_paquete(&analizador, paquetes + i);
+    /* los bytes quedan en los contadores hasta reducirlos */
+    for (i = 0; i < cant_clases; i++)
+        assert(clases[i].bytes_subida == 0 && clases[i].bytes_bajada == 0);
+    reducir_contadores(&analizador);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+    }
+    free_analizador(&analizador);
+    assert(analizador.contadores == NULL);
+    free(paquetes);
+}
+
+/*
+ * test_contadores_64_bits
+ * --------------------------------------------------------------------------
+ *  Prueba que los bytes de una clase no se desborden al superar los 2GB y que
+ *  se cuente la cantidad de paquetes de cada direccion, incluidos los flujos
+ *  que representan varios paquetes.
+ */
+void test_contadores_64_bits() {
+    struct s_analizador analizador;
+    struct clase clases[1];
+    struct paquete paquete;
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    analizador.clases = clases;
+    analizador.cant_clases = 1;
+
+    inet_aton("192.168.1.1", &(paquete.ip_origen));
+    inet_aton("8.8.8.8", &(paquete.ip_destino));
+    paquete.puerto_origen = 40000;
+    paquete.puerto_destino = 443;
+    paquete.protocolo = IPPROTO_TCP;
+    paquete.direccion = SALIENTE;
+    paquete.bytes = 3000000000ULL; /* flujo de 3GB */
+    paquete.cantidad = 2000000;
+    analizar_paquete(&analizador, &paquete);
+    analizar_paquete(&analizador, &paquete);
+    paquete.direccion = ENTRANTE;
+    paquete.bytes = 1500;
+    paquete.cantidad = 1;
+    analizar_paquete(&analizador, &paquete);
+
+    assert(clases[0].bytes_subida == 6000000000ULL);
+    assert(clases[0].paquetes_subida == 4000000);
+    assert(clases[0].bytes_bajada == 1500);
+    assert(clases[0].paquetes_bajada == 1);
+}
+
+/*
+ * test_cache_flujos
+ * --------------------------------------------------------------------------
+ *  Prueba que al analizar paquetes en paralelo con la cache de flujos se
+ *  sumen los bytes a las mismas clases que sin cache, que los flujos
+ *  repetidos se clasifiquen con la cache y que al volver a compilar las
+ *  clases se invaliden los flujos clasificados.
+ */
+void test_cache_flujos() {
+    const int cant_clases = 30;
+    const int cant_paquetes = 100000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    u_int64_t aciertos, fallos, aciertos_despues, fallos_despues;
+    int i;
+
+    srand(77);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    for (i = 0; i < cant_paquetes; i++)
+        paquete_aleatorio(paquetes + i);
+
+    /* analizo sin cache */
+    for (i = 0; i < cant_paquetes; i++)
+        analizar_paquete(&analizador, paquetes + i);
+    for (i = 0; i < cant_clases; i++) {
+        esperado_subida[i] = clases[i].bytes_subida;
+        esperado_bajada[i] = clases[i].bytes_bajada;
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* analizo en paralelo con cache */
+    assert(iniciar_cache(&analizador) == 0);
+    assert(compilar_clases(&analizador) == 0);
+    #pragma omp parallel for
+    for (i = 0; i < cant_paquetes; i++)
+        analizar_paquete(&analizador, paquetes + i);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+    }
+    estadisticas_cache(&analizador, &aciertos, &fallos);
+    assert(aciertos + fallos == (u_int64_t) cant_paquetes);
+    assert(aciertos > 0);
+    /* un flujo que se repite se clasifica con la cache */
+    analizar_paquete(&analizador, paquetes);
+    analizar_paquete(&analizador, paquetes);
+    estadisticas_cache(&analizador, &aciertos, &fallos);
+    assert(aciertos + fallos == (u_int64_t) cant_paquetes + 2);
+    analizar_paquete(&analizador, paquetes);
+    estadisticas_cache(&analizador, &aciertos_despues, &fallos_despues);
+    assert(aciertos_despues == aciertos + 1 && fallos_despues == fallos);
+
+    /* cambio la clase de todos los paquetes y vuelvo a compilar las clases,
+     * ningun paquete debe quedar en la clase anterior */
+    for (i = 0; i < cant_clases; i++) {
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+        if (i == 0)
+            continue;
+        clases[i].cant_subredes_outside = i == 5 ? 0 : 1;
+        clases[i].cant_subredes_inside = 0;
+        clases[i].cant_puertos_outside = 0;
+        clases[i].cant_puertos_inside = 0;
+        inet_aton("1.2.3.4", &((clases + i)->subredes_outside->red));
+        (clases + i)->subredes_outside->mascara = MASCARA_HOST;
+        (clases + i)->subredes_outside->prefijo =
+                prefijo((clases + i)->subredes_outside->mascara);
+    }
+    assert(compilar_clases(&analizador) == 0);
+    for (i = 0; i < cant_paquetes; i++)
+        assert(analizar_paquete(&analizador, paquetes + i) == 1);
+    for (i = 0; i < cant_clases; i++) {
+        if (i == 5)
+            continue;
+        assert(clases[i].bytes_subida == 0 && clases[i].bytes_bajada == 0);
+    }
+    free_analizador(&analizador);
+    assert(analizador.caches == NULL);
+    free(paquetes);
+}
+
+/*
+ * test_ventanas
+ * --------------------------------------------------------------------------
+ *  Prueba que las ventanas deslizantes sumen los ticks que abarcan y
+ *  descarten los ticks viejos, comparando con la suma de los ultimos ticks.
+ *  La duracion de las ventanas se redondea hacia arriba a ticks completos.
+ */
+void test_ventanas() {
+    const int cant_clases = 3;
+    const int cant_ticks = 50;
+    const int segundos[] = {60, 300, 250};
+    const int ticks[] = {1, 5, 5}; /* ticks de 60 segundos */
+    struct ventanas *ventanas;
+    struct clase clases[cant_clases];
+    u_int64_t historial[cant_ticks][cant_clases];
+    u_int64_t esperado;
+    int i, j, t, k;
+
+    memset(clases, 0, sizeof(clases));
+    assert(crear_ventanas(cant_clases, 0, segundos, 3) == NULL);
+    assert(crear_ventanas(cant_clases, 60, segundos, 0) == NULL);
+    ventanas = crear_ventanas(cant_clases, 60, segundos, 3);
+    assert(ventanas != NULL);
+    assert(ventanas->cant_ranuras == 5);
+
+    srand(9);
+    for (t = 0; t < cant_ticks; t++) {
+        for (j = 0; j < cant_clases; j++) {
+            historial[t][j] = rand() % 100000;
+            clases[j].bytes_subida = historial[t][j];
+            clases[j].bytes_bajada = 2 * historial[t][j];
+            clases[j].paquetes_subida = 1;
+        }
+        avanzar_ventanas(ventanas, clases);
+        /* los contadores de las clases quedan en cero */
+        for (j = 0; j < cant_clases; j++)
+            assert(clases[j].bytes_subida == 0 &&
+                   clases[j].paquetes_subida == 0);
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < cant_clases; j++) {
+                esperado = 0;
+                for (k = t; k >= 0 && k > t - ticks[i]; k--)
+                    esperado += historial[k][j];
+                assert(total_ventana(ventanas, i)[j].bytes_subida ==
+                       esperado);
+                assert(total_ventana(ventanas, i)[j].bytes_bajada ==
+                       2 * esperado);
+                assert(total_ventana(ventanas, i)[j].paquetes_subida ==
+                       (u_int64_t) (t + 1 < ticks[i] ? t + 1 : ticks[i]));
+            }
+        }
+    }
+    free_ventanas(ventanas);
+}
+
+/*
+ * corromper_instantanea
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que busca un array del indice en el archivo y reemplaza
+ *  su primer valor de *largo_valor* bytes.
+ */
+void corromper_instantanea(const char *archivo, const void *array,
+                           size_t largo, const void *valor,
+                           size_t largo_valor) {
+    FILE *file = fopen(archivo, "r+b");
+    char *datos;
+    long tamanio, i;
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    tamanio = ftell(file);
+    datos = malloc(tamanio);
+    rewind(file);
+    assert(fread(datos, 1, tamanio, file) == (size_t) tamanio);
+    for (i = 0; i + (long) largo <= tamanio; i++)
+        if (memcmp(datos + i, array, largo) == 0)
+            break;
+    assert(i + (long) largo <= tamanio);
+    fseek(file, i, SEEK_SET);
+    fwrite(valor, largo_valor, 1, file);
+    fclose(file);
+    free(datos);
+}
+
+/*
+ * test_instantanea
+ * --------------------------------------------------------------------------
+ *  Prueba que las clases cargadas de una instantanea clasifiquen los paquetes
+ *  igual que las clases compiladas originales, y que no se cargue una
+ *  instantanea con otra firma, con posiciones del indice fuera de sus arrays
+ *  o con un formato desconocido.
+ */
+void test_instantanea() {
+    const char *archivo = "bin/tests/instantanea.bin";
+    const int cant_clases = 100;
+    const int cant_paquetes = 20000;
+    struct s_analizador original, cargado;
+    struct instantanea instantanea;
+    struct clase clases[cant_clases];
+    struct paquete paquete;
+    const struct dimension_subred *dimension;
+    u_int16_t conjunto;
+    FILE *file;
+    int i, posiciones;
+
+    srand(12);
+    memset(&original, 0, sizeof(struct s_analizador));
+    memset(&cargado, 0, sizeof(struct s_analizador));
+    memset(&instantanea, 0, sizeof(struct instantanea));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++) {
+        clase_aleatoria(clases + i);
+        clases[i].id = i;
+        snprintf(clases[i].nombre, LONG_NOMBRE, "clase %d", i);
+    }
+    original.clases = clases;
+    original.cant_clases = cant_clases;
+
+    /* sin indice no se puede guardar */
+    assert(guardar_instantanea(archivo, 1, &original) < 0);
+    assert(compilar_clases(&original) == 0);
+    assert(guardar_instantanea(archivo, 106, &original) == 0);
+
+    /* otra firma */
+    assert(cargar_instantanea(archivo, 107, &cargado, &instantanea) < 0);
+    assert(instantanea.memoria == NULL && cargado.clases == NULL);
+
+    assert(cargar_instantanea(archivo, 106, &cargado, &instantanea) == 0);
+    assert(cargado.cant_clases == cant_clases);
+    assert(cargado.indice != NULL && cargado.indice->externo);
+    for (i = 0; i < cant_clases; i++) {
+        assert(cargado.clases[i].id == clases[i].id);
+        assert(strcmp(cargado.clases[i].nombre, clases[i].nombre) == 0);
+        assert(cargado.clases[i].cant_subredes_outside ==
+               clases[i].cant_subredes_outside);
+        assert(cargado.clases[i].cant_puertos_inside ==
+               clases[i].cant_puertos_inside);
+    }
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        assert(clasificar_paquete(&cargado, &paquete) ==
+               clasificar_paquete(&original, &paquete));
+        /* las clases cargadas tambien se comparan sin indice */
+        assert(coincide(cargado.clases + 1, &paquete) ==
+               coincide(clases + 1, &paquete));
+        analizar_paquete(&cargado, &paquete);
+    }
+    cerrar_instantanea(&cargado, &instantanea);
+    assert(cargado.indice == NULL && instantanea.memoria == NULL);
+
+    /* una clase de un nodo de subredes fuera del array de clases */
+    dimension = &(original.indice->subredes_outside);
+    for (i = 0, posiciones = 0; i < dimension->cant_nodos; i++)
+        if (dimension->nodos[i].inicio + dimension->nodos[i].cantidad >
+                posiciones)
+            posiciones = dimension->nodos[i].inicio +
+                         dimension->nodos[i].cantidad;
+    assert(posiciones > 0);
+    corromper_instantanea(archivo, dimension->clases,
+                          sizeof(int) * posiciones, &cant_clases,
+                          sizeof(int));
+    assert(cargar_instantanea(archivo, 106, &cargado, &instantanea) < 0);
+    assert(instantanea.memoria == NULL && cargado.clases == NULL);
+
+    /* una tabla de puertos con un conjunto que no existe */
+    assert(guardar_instantanea(archivo, 106, &original) == 0);
+    conjunto = original.indice->puertos_outside.cant_conjuntos;
+    corromper_instantanea(archivo, original.indice->puertos_outside.tablas,
+                          sizeof(u_int16_t) * CANT_PUERTOS, &conjunto,
+                          sizeof(u_int16_t));
+    assert(cargar_instantanea(archivo, 106, &cargado, &instantanea) < 0);
+
+    /* formato desconocido */
+    assert(guardar_instantanea(archivo, 106, &original) == 0);
+    file = fopen(archivo, "r+b");
+    assert(file != NULL);
+    fputc('X', file);
+    fclose(file);
+    assert(cargar_instantanea(archivo, 106, &cargado, &instantanea) < 0);
+    remove(archivo);
+    assert(cargar_instantanea(archivo, 106, &cargado, &instantanea) < 0);
+    free_analizador(&original);
+    free_analizador(&cargado);
+}
+
+/*
+ * trama_ethernet
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que escribe en *trama* una trama ethernet con un paquete
+ *  IPv4 de 100 bytes, opcionalmente con una etiqueta VLAN. Devuelve el largo
+ *  de la trama.
+ */
+int trama_ethernet(u_int8_t *trama, const char *origen, const char *destino,
+                   int protocolo, int puerto_origen, int puerto_destino,
+                   int vlan) {
+    u_int8_t *ip;
+    struct in_addr direccion;
+    int inicio = vlan ? 18 : 14;
+
+    memset(trama, 0, inicio + 100);
+    if (vlan) {
+        trama[12] = 0x81; trama[13] = 0x00;
+        trama[16] = 0x08; trama[17] = 0x00;
+    } else {
+        trama[12] = 0x08; trama[13] = 0x00;
+    }
+    ip = trama + inicio;
+    ip[0] = 0x45;
+    ip[3] = 100;
+    ip[9] = protocolo;
+    inet_aton(origen, &direccion);
+    memcpy(ip + 12, &direccion, 4);
+    inet_aton(destino, &direccion);
+    memcpy(ip + 16, &direccion, 4);
+    ip[20] = puerto_origen >> 8; ip[21] = puerto_origen & 0xff;
+    ip[22] = puerto_destino >> 8; ip[23] = puerto_destino & 0xff;
+    return inicio + 100;
+}
+
+/*
+ * test_decodificar_paquete
+ * --------------------------------------------------------------------------
+ *  Prueba la decodificacion de tramas ethernet con y sin VLAN, la direccion
+ *  segun la red local y el descarte de tramas que no se pueden analizar.
+ */
+void test_decodificar_paquete() {
+    u_int8_t trama[256];
+    struct subred lan;
+    struct paquete paquete;
+    int largo;
+
+    inet_aton("192.168.0.0", &(lan.red));
+    lan.mascara = MASCARA_16;
+
+    largo = trama_ethernet(trama, "192.168.1.10", "8.8.8.8", IPPROTO_UDP,
+                           40000, 53, 0);
+    assert(decodificar_paquete(trama, largo, ENLACE_ETHERNET, &lan,
+                               &paquete) == 0);
+    assert(paquete.ip_origen.s_addr == inet_addr("192.168.1.10"));
+    assert(paquete.ip_destino.s_addr == inet_addr("8.8.8.8"));
+    assert(paquete.puerto_origen == 40000 && paquete.puerto_destino == 53);
+    assert(paquete.protocolo == IPPROTO_UDP);
+    assert(paquete.direccion == SALIENTE);
+    assert(paquete.bytes == 100 && paquete.cantidad == 1);
+
+    largo = trama_ethernet(trama, "8.8.8.8", "192.168.1.10", IPPROTO_TCP,
+                           443, 40000, 1);
+    assert(decodificar_paquete(trama, largo, ENLACE_ETHERNET, &lan,
+                               &paquete) == 0);
+    assert(paquete.direccion == ENTRANTE);
+    assert(paquete.puerto_origen == 443 && paquete.protocolo == IPPROTO_TCP);
+
+    /* paquete IP sin cabecera de enlace */
+    assert(decodificar_paquete(trama + 18, 100, ENLACE_RAW, &lan,
+                               &paquete) == 0);
+    assert(paquete.direccion == ENTRANTE);
+
+    /* trafico interno, ajeno a la red local, truncado o no IPv4 */
+    largo = trama_ethernet(trama, "192.168.1.10", "192.168.2.1", IPPROTO_TCP,
+                           1, 2, 0);
+    assert(decodificar_paquete(trama, largo, ENLACE_ETHERNET, &lan,
+                               &paquete) < 0);
+    largo = trama_ethernet(trama, "1.1.1.1", "8.8.8.8", IPPROTO_TCP, 1, 2, 0);
+    assert(decodificar_paquete(trama, largo, ENLACE_ETHERNET, &lan,
+                               &paquete) < 0);
+    largo = trama_ethernet(trama, "192.168.1.10", "8.8.8.8", IPPROTO_TCP,
+                           1, 2, 0);
+    assert(decodificar_paquete(trama, 30, ENLACE_ETHERNET, &lan,
+                               &paquete) < 0);
+    trama[12] = 0x86; trama[13] = 0xdd; /* IPv6 */
+    assert(decodificar_paquete(trama, largo, ENLACE_ETHERNET, &lan,
+                               &paquete) < 0);
+}
+
+/*
+ * escribir32
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que escribe un entero de 32 bits en el archivo.
+ */
+void escribir32(FILE *file, u_int32_t valor) {
+    fwrite(&valor, sizeof(valor), 1, file);
+}
+
+/*
+ * test_analizar_captura
+ * --------------------------------------------------------------------------
+ *  Prueba que se analicen los paquetes de un archivo pcap y de un archivo
+ *  pcapng, y de un directorio que contiene ambos, y que un archivo pcapng
+ *  corrupto no se lea fuera de su tamanio.
+ */
+void test_analizar_captura() {
+    const char *directorio = "bin/tests/capturas";
+    const char *pcap = "bin/tests/capturas/1.pcap";
+    const char *pcapng = "bin/tests/capturas/2.pcapng";
+    const char *corrupto = "bin/tests/corrupto.pcapng";
+    struct s_analizador analizador;
+    struct clase clases[1];
+    struct subred lan;
+    u_int8_t trama[256];
+    FILE *file;
+    int i, largo;
+
+    inet_aton("192.168.0.0", &(lan.red));
+    lan.mascara = MASCARA_16;
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    analizador.clases = clases;
+    analizador.cant_clases = 1;
+    analizador.tamanio_lote = 2; /* varios lotes por archivo */
+    assert(system("mkdir -p bin/tests/capturas") == 0);
+
+    /* pcap: 3 salientes y uno interno que se descarta */
+    file = fopen(pcap, "wb");
+    assert(file != NULL);
+    escribir32(file, 0xa1b2c3d4);
+    escribir32(file, 0x00040002); /* version 2.4 */
+    escribir32(file, 0);
+    escribir32(file, 0);
+    escribir32(file, 65535);
+    escribir32(file, ENLACE_ETHERNET);
+    for (i = 0; i < 4; i++) {
+        largo = trama_ethernet(trama, "192.168.1.10",
+                               i == 3 ? "192.168.1.11" : "8.8.8.8",
+                               IPPROTO_TCP, 40000 + i, 443, i == 1);
+        escribir32(file, i);
+        escribir32(file, 0);
+        escribir32(file, largo);
+        escribir32(file, largo);
+        fwrite(trama, largo, 1, file);
+    }
+    fclose(file);
+    assert(analizar_captura(&analizador, pcap, &lan, analizar_paquete) == 3);
+    assert(clases[0].bytes_subida == 300 && clases[0].paquetes_subida == 3);
+
+    /* pcapng: una interfaz, un paquete extendido y uno simple entrantes */
+    file = fopen(pcapng, "wb");
+    assert(file != NULL);
+    escribir32(file, 0x0a0d0d0a);
+    escribir32(file, 28);
+    escribir32(file, 0x1a2b3c4d);
+    escribir32(file, 0x00000001); /* version 1.0 */
+    escribir32(file, 0xffffffff);
+    escribir32(file, 0xffffffff); /* largo de seccion desconocido */
+    escribir32(file, 28);
+    escribir32(file, 1); /* interfaz */
+    escribir32(file, 20);
+    escribir32(file, ENLACE_ETHERNET);
+    escribir32(file, 65535);
+    escribir32(file, 20);
+    largo = trama_ethernet(trama, "8.8.8.8", "192.168.1.10", IPPROTO_UDP,
+                           53, 40000, 0);
+    escribir32(file, 6); /* paquete extendido */
+    escribir32(file, 32 + ((largo + 3) & ~3));
+    escribir32(file, 0);
+    escribir32(file, 0);
+    escribir32(file, 0);
+    escribir32(file, largo);
+    escribir32(file, largo);
+    fwrite(trama, (largo + 3) & ~3, 1, file);
+    escribir32(file, 32 + ((largo + 3) & ~3));
+    escribir32(file, 3); /* paquete simple */
+    escribir32(file, 16 + ((largo + 3) & ~3));
+    escribir32(file, largo);
+    fwrite(trama, (largo + 3) & ~3, 1, file);
+    escribir32(file, 16 + ((largo + 3) & ~3));
+    fclose(file);
+    assert(analizar_captura(&analizador, pcapng, &lan,
+                            analizar_paquete) == 2);
+    assert(clases[0].bytes_bajada == 200 && clases[0].paquetes_bajada == 2);
+
+    /* directorio con ambos archivos */
+    assert(analizar_captura(&analizador, directorio, &lan,
+                            analizar_paquete) == 5);
+    assert(clases[0].bytes_subida == 600 && clases[0].bytes_bajada == 400);
+    assert(analizar_captura(&analizador, "bin/tests/no_existe", &lan,
+                            analizar_paquete) < 0);
+    remove(pcap);
+    remove(pcapng);
+
+    /* pcapng con un bloque de largo que no es multiplo de 4: redondearlo
+     * pasaria el final del archivo */
+    file = fopen(corrupto, "wb");
+    assert(file != NULL);
+    escribir32(file, 0x0a0d0d0a);
+    escribir32(file, 28);
+    escribir32(file, 0x1a2b3c4d);
+    escribir32(file, 0x00000001);
+    escribir32(file, 0xffffffff);
+    escribir32(file, 0xffffffff);
+    escribir32(file, 28);
+    escribir32(file, 6);
+    escribir32(file, 4065);
+    memset(trama, 0, sizeof(trama));
+    for (largo = 4094 - 36; largo > 0; largo -= sizeof(trama))
+        fwrite(trama, (size_t) largo < sizeof(trama) ?
+                      (size_t) largo : sizeof(trama), 1, file);
+    fclose(file);
+    assert(analizar_captura(&analizador, corrupto, &lan,
+                            analizar_paquete) == 0);
+    remove(corrupto);
+}
+
+/*
+ * contar_ocurrencias
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que cuenta las veces que aparece *texto* en el archivo.
+ */
+int contar_ocurrencias(FILE *file, const char *texto) {
+    char linea[256];
+    int cantidad = 0;
+    rewind(file);
+    while (fgets(linea, sizeof(linea), file) != NULL)
+        if (strstr(linea, texto) != NULL)
+            cantidad++;
+    return cantidad;
+}
+
+/*
+ * test_vivo
+ * --------------------------------------------------------------------------
+ *  Prueba que la reproduccion de una captura escriba los totales de cada
+ *  intervalo segun la marca de tiempo de los paquetes, y que se escriban los
+ *  intervalos sin paquetes al avanzar el reloj.
+ */
+void test_vivo() {
+    const char *pcap = "bin/tests/vivo.pcap";
+    const time_t tiempos[] = {0, 10, 59, 70, 200};
+    struct s_analizador analizador;
+    struct clase clases[1];
+    struct subred lan;
+    struct vivo *vivo;
+    u_int8_t trama[256];
+    FILE *file, *salida;
+    int i, largo;
+
+    inet_aton("192.168.0.0", &(lan.red));
+    lan.mascara = MASCARA_16;
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    analizador.clases = clases;
+    analizador.cant_clases = 1;
+    analizador.tamanio_lote = 2;
+    assert(system("mkdir -p bin/tests") == 0);
+
+    file = fopen(pcap, "wb");
+    assert(file != NULL);
+    escribir32(file, 0xa1b2c3d4);
+    escribir32(file, 0x00040002);
+    escribir32(file, 0);
+    escribir32(file, 0);
+    escribir32(file, 65535);
+    escribir32(file, ENLACE_ETHERNET);
+    for (i = 0; i < 5; i++) {
+        largo = trama_ethernet(trama, "192.168.1.10", "8.8.8.8",
+                               IPPROTO_TCP, 40000, 443, 0);
+        escribir32(file, 1000000000 + tiempos[i] - 1000000000 % 60);
+        escribir32(file, 0);
+        escribir32(file, largo);
+        escribir32(file, largo);
+        fwrite(trama, largo, 1, file);
+    }
+    fclose(file);
+
+    salida = tmpfile();
+    assert(salida != NULL);
+    assert(crear_vivo(&analizador, &lan, 0, salida, analizar_paquete) ==
+           NULL);
+    vivo = crear_vivo(&analizador, &lan, 60, salida, analizar_paquete);
+    assert(vivo != NULL);
+    assert(reproducir_captura(vivo, pcap) == 5);
+    /* intervalos de 3, 1 y 1 paquetes. El intervalo vacio no se escribe */
+    assert(contar_ocurrencias(salida, "[") == 3);
+    assert(contar_ocurrencias(salida, "\"subida\": 300") == 1);
+    assert(contar_ocurrencias(salida, "\"subida\": 100") == 2);
+    assert(clases[0].bytes_subida == 0 && clases[0].paquetes_subida == 0);
+    fclose(salida);
+
+    /* sin tramas los intervalos se cierran al avanzar el reloj */
+    salida = tmpfile();
+    assert(salida != NULL);
+    vivo->salida = salida;
+    vivo->fin = 0;
+    assert(avanzar_reloj(vivo, 30) == 0);
+    assert(avanzar_reloj(vivo, 59) == 0);
+    assert(agregar_trama(vivo, 59, trama, largo, ENLACE_ETHERNET) == 0);
+    assert(agregar_trama(vivo, 59, trama, 10, ENLACE_ETHERNET) < 0);
+    assert(avanzar_reloj(vivo, 60) == 1);
+    assert(avanzar_reloj(vivo, 119) == 0);
+    assert(avanzar_reloj(vivo, 120) == 1);
+    assert(contar_ocurrencias(salida, "[") == 2);
+    assert(contar_ocurrencias(salida, "\"subida\": 100") == 1);
+    fclose(salida);
+    free_vivo(vivo);
+    remove(pcap);
+}
+
+/*
+ * abrir_fallida
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que simula una fuente que no se puede abrir.
+ */
+int abrir_fallida(struct fuente *fuente,
+                  const struct s_analizador *analizador) {
+    (void) fuente;
+    (void) analizador;
+    return -1;
+}
+
+/*
+ * test_analizar_fuente
+ * --------------------------------------------------------------------------
+ *  Prueba que se analicen todos los paquetes de una fuente en lotes que no
+ *  dividen a la cantidad de paquetes, y que una fuente que no se puede abrir
+ *  se cierre igual.
+ */
+void test_analizar_fuente() {
+    struct s_analizador analizador;
+    struct clase clases[2];
+    struct paquete paquetes[1000];
+    struct subred subred;
+    struct fuente fuente;
+    int i;
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    memset(paquetes, 0, sizeof(paquetes));
+    init_clase(clases);
+    init_clase(clases + 1);
+    inet_aton("10.0.0.0", &(subred.red));
+    subred.mascara = MASCARA_8;
+    subred.prefijo = prefijo(subred.mascara);
+    clases[1].id = 1;
+    clases[1].subredes_outside = &subred;
+    clases[1].cant_subredes_outside = 1;
+    analizador.clases = clases;
+    analizador.cant_clases = 2;
+    analizador.tamanio_lote = 64;
+    assert(iniciar_contadores(&analizador) == 0);
+    for (i = 0; i < 1000; i++) {
+        paquetes[i].ip_origen.s_addr = inet_addr("192.168.1.1");
+        paquetes[i].ip_destino.s_addr = htonl(
+                (i % 2 ? 0x0a000000 : 0x0b000000) + i);
+        paquetes[i].direccion = SALIENTE;
+        paquetes[i].protocolo = IPPROTO_TCP;
+        paquetes[i].bytes = 10;
+        paquetes[i].cantidad = 1;
+    }
+
+    assert(fuente_memoria(&fuente, paquetes, 1000) == 0);
+    assert(analizar_fuente(&analizador, &fuente, analizar_paquete) == 1000);
+    assert(fuente.datos == NULL);
+    reducir_contadores(&analizador);
+    assert(clases[1].bytes_subida == 5000 && clases[1].paquetes_subida == 500);
+    assert(clases[0].bytes_subida == 5000 && clases[0].paquetes_subida == 500);
+
+    /* fuente vacia */
+    assert(fuente_memoria(&fuente, paquetes, 0) == 0);
+    assert(analizar_fuente(&analizador, &fuente, analizar_paquete) == 0);
+
+    /* fuente que no se puede abrir */
+    assert(fuente_memoria(&fuente, paquetes, 1000) == 0);
+    fuente.abrir = abrir_fallida;
+    assert(analizar_fuente(&analizador, &fuente, analizar_paquete) < 0);
+    assert(fuente.datos == NULL);
+    free_analizador(&analizador);
+}
+
+/*
+ * test_analizar_lote
+ * --------------------------------------------------------------------------
+ *  Prueba que analizar_lote() asigne a cada paquete la misma clase que
+ *  clasificar_paquete() comparando con todas las clases, con y sin cache de
+ *  flujos, y que sume los mismos bytes que analizar_paquete().
+ */
+void test_analizar_lote() {
+    const int cant_clases = 100;
+    const int cant_paquetes = 5000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    int *esperadas = malloc(cant_paquetes * sizeof(int));
+    int *obtenidas = malloc(cant_paquetes * sizeof(int));
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    int i, coincidencias = 0, obtenidas_total;
+
+    srand(1606);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    memset(esperado_subida, 0, sizeof(esperado_subida));
+    memset(esperado_bajada, 0, sizeof(esperado_bajada));
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(paquetes + i);
+        /* flujos repetidos para que haya aciertos en la cache */
+        if (i % 3 == 2)
+            paquetes[i] = paquetes[i - 2];
+        esperadas[i] = clasificar_paquete(&analizador, paquetes + i);
+        coincidencias += esperadas[i] > 0;
+        if (paquetes[i].direccion == SALIENTE)
+            esperado_subida[esperadas[i]] += paquetes[i].bytes;
+        else
+            esperado_bajada[esperadas[i]] += paquetes[i].bytes;
+    }
+
+    /* sin indice ni cache, en un solo hilo */
+    assert(analizar_lote(&analizador, paquetes, cant_paquetes, obtenidas) ==
+           coincidencias);
+    for (i = 0; i < cant_paquetes; i++)
+        assert(obtenidas[i] == esperadas[i]);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* con indice, cache y contadores, en paralelo con partes que no son
+     * multiplo del bloque */
+    assert(compilar_clases(&analizador) == 0);
+    assert(iniciar_cache(&analizador) == 0);
+    assert(iniciar_contadores(&analizador) == 0);
+    memset(obtenidas, 0xff, cant_paquetes * sizeof(int));
+    obtenidas_total = 0;
+    #pragma omp parallel for reduction(+:obtenidas_total)
+    for (i = 0; i < cant_paquetes; i += 37)
+        obtenidas_total += analizar_lote(&analizador, paquetes + i,
+                                         cant_paquetes - i < 37 ?
+                                         cant_paquetes - i : 37,
+                                         obtenidas + i);
+    assert(obtenidas_total == coincidencias);
+    reducir_contadores(&analizador);
+    for (i = 0; i < cant_paquetes; i++)
+        assert(obtenidas[i] == esperadas[i]);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+    }
+    /* sin array de clases */
+    assert(analizar_lote(&analizador, paquetes, cant_paquetes, NULL) ==
+           coincidencias);
+    analizador.cant_clases = 0;
+    assert(analizar_lote(&analizador, paquetes, cant_paquetes, NULL) == 0);
+    analizador.cant_clases = cant_clases;
+    free_analizador(&analizador);
+    free(paquetes);
+    free(esperadas);
+    free(obtenidas);
+}
+
+/*
+ * test_subredes_simd
+ * --------------------------------------------------------------------------
+ *  Prueba que las implementaciones SIMD de la busqueda del prefijo mas largo
+ *  que soporta el procesador den el mismo resultado que la comparacion de a
+ *  una subred, con cantidades de subredes que no son multiplo del bloque.
+ */
+void test_subredes_simd() {
+    const int cantidades[] = {0, 1, 3, 4, 7, 8, 9, 31, 300};
+    struct subred subredes[300], *subred;
+    struct vector_subredes *vector;
+    struct in_addr ip;
+    int c, i, j, p, impl, esperado;
+
+    srand(1717);
+    for (c = 0; c < 9; c++) {
+        for (i = 0; i < cantidades[c]; i++) {
+            p = rand() % 33;
+            subredes[i].mascara = p == 32 ? MASCARA_HOST :
+                                  p == 0 ? 0 : GET_MASCARA(p);
+            subredes[i].prefijo = prefijo(subredes[i].mascara);
+            /* redes dentro de 10.0.0.0/8 para que haya coincidencias */
+            subredes[i].red.s_addr = htonl(0x0a000000 | (rand() & 0xffffff)) &
+                                     subredes[i].mascara;
+        }
+        vector = crear_vector_subredes(subredes, cantidades[c]);
+        assert(vector != NULL);
+        assert(vector->capacidad % SUBREDES_BLOQUE == 0);
+        assert(vector->implementacion == implementacion_subredes());
+        for (j = 0; j < 2000; j++) {
+            ip.s_addr = j % 2 && cantidades[c] > 0 ?
+                        subredes[rand() % cantidades[c]].red.s_addr |
+                        htonl(rand() & 0xff) :
+                        htonl(0x0a000000 | (rand() & 0xffffff));
+            /* resultado esperado comparando de a una subred */
+            esperado = -1;
+            for (subred = subredes; subred < subredes + cantidades[c];
+                 subred++)
+                if (en_subred(ip, subred) &&
+                        prefijo(subred->mascara) > esperado)
+                    esperado = prefijo(subred->mascara);
+            for (impl = SUBREDES_ESCALAR; impl <= implementacion_subredes();
+                 impl++)
+                assert(mejor_prefijo_con(vector, ip, impl) == esperado);
+            assert(mejor_prefijo(vector, ip) == esperado);
+        }
+        free_vector_subredes(vector);
+    }
+}
+
+/*
+ * test_vectorizar_clases
+ * --------------------------------------------------------------------------
+ *  Prueba que la comparacion con todas las clases con las subredes en
+ *  vectores elija la misma clase que la comparacion sin vectores.
+ */
+void test_vectorizar_clases() {
+    const int cant_clases = 80;
+    const int cant_paquetes = 20000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete paquete;
+    int *esperadas;
+    int i;
+
+    srand(1818);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    esperadas = malloc(cant_paquetes * sizeof(int));
+    srand(1819);
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        esperadas[i] = clasificar_paquete(&analizador, &paquete);
+    }
+    assert(vectorizar_clases(&analizador) == 0);
+    assert(analizador.vectores != NULL);
+    srand(1819);
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        assert(clasificar_paquete(&analizador, &paquete) == esperadas[i]);
+    }
+    free_analizador(&analizador);
+    assert(analizador.vectores == NULL);
+    free(esperadas);
+}
+
+/*
+ * test_lote_columnas
+ * --------------------------------------------------------------------------
+ *  Prueba que un lote por columnas guarde los mismos paquetes que un array
+ *  de struct paquete y que la conversion de una columna al orden de red sea
+ *  igual a htonl() con cada direccion.
+ */
+void test_lote_columnas() {
+    struct paquete paquetes[100], copia[100];
+    struct lote_columnas *lote;
+    u_int32_t direcciones[37];
+    int i;
+
+    srand(1818);
+    memset(paquetes, 0, sizeof(paquetes));
+    memset(copia, 0, sizeof(copia));
+    for (i = 0; i < 100; i++)
+        paquete_aleatorio(paquetes + i);
+    lote = crear_lote_columnas(64);
+    assert(lote != NULL && lote->capacidad == 64);
+    /* no se copian mas paquetes que la capacidad */
+    assert(paquetes_a_columnas(paquetes, 100, lote) == 64);
+    assert(lote->filas == 64);
+    columnas_a_paquetes(lote, 10, 54, copia);
+    assert(memcmp(copia, paquetes + 10, 54 * sizeof(struct paquete)) == 0);
+    assert(lote->ip_origen[3] == paquetes[3].ip_origen.s_addr);
+    assert(lote->direccion[5] == paquetes[5].direccion);
+    free_lote_columnas(lote);
+
+    lote = crear_lote_columnas(0);
+    assert(lote != NULL);
+    assert(paquetes_a_columnas(paquetes, 100, lote) == 0);
+    free_lote_columnas(lote);
+
+    for (i = 0; i < 37; i++)
+        direcciones[i] = 0x0a000001 + i * 0x01020304;
+    columna_orden_red(direcciones, 37);
+    for (i = 0; i < 37; i++)
+        assert(direcciones[i] == htonl(0x0a000001 + i * 0x01020304));
+}
+
+/*
+ * siguiente_columnas_prueba
+ * --------------------------------------------------------------------------
+ *  Entrega por columnas los paquetes de una fuente en memoria.
+ */
+int siguiente_columnas_prueba(struct fuente *fuente,
+                              struct lote_columnas *lote) {
+    struct paquete paquetes[64];
+    int cantidad;
+    assert(lote->capacidad <= 64);
+    cantidad = fuente->siguiente_lote(fuente, paquetes, lote->capacidad);
+    return paquetes_a_columnas(paquetes, cantidad, lote);
+}
+
+/*
+ * test_analizar_columnas
+ * --------------------------------------------------------------------------
+ *  Prueba que analizar_columnas() asigne a cada paquete la misma clase que
+ *  analizar_lote(), con y sin cache de flujos, y que analizar_fuente()
+ *  analice los lotes por columnas de una fuente que los entrega.
+ */
+void test_analizar_columnas() {
+    const int cant_clases = 100;
+    const int cant_paquetes = 5000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    struct lote_columnas *lote = crear_lote_columnas(cant_paquetes);
+    int *esperadas = malloc(cant_paquetes * sizeof(int));
+    int *obtenidas = malloc(cant_paquetes * sizeof(int));
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    struct fuente fuente;
+    int i, coincidencias;
+
+    srand(1819);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(paquetes + i);
+        if (i % 3 == 2)
+            paquetes[i] = paquetes[i - 2];
+    }
+    assert(paquetes_a_columnas(paquetes, cant_paquetes, lote) ==
+           cant_paquetes);
+
+    coincidencias = analizar_lote(&analizador, paquetes, cant_paquetes,
+                                  esperadas);
+    for (i = 0; i < cant_clases; i++) {
+        esperado_subida[i] = clases[i].bytes_subida;
+        esperado_bajada[i] = clases[i].bytes_bajada;
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* sin indice ni cache */
+    assert(analizar_columnas(&analizador, lote, 0, cant_paquetes,
+                             obtenidas) == coincidencias);
+    for (i = 0; i < cant_paquetes; i++)
+        assert(obtenidas[i] == esperadas[i]);
+
+    /* con indice y cache, en partes que no son multiplo del bloque */
+    assert(compilar_clases(&analizador) == 0);
+    assert(iniciar_cache(&analizador) == 0);
+    memset(obtenidas, 0xff, cant_paquetes * sizeof(int));
+    for (i = 0; i < cant_paquetes; i += 37)
+        analizar_columnas(&analizador, lote, i,
+                          cant_paquetes - i < 37 ? cant_paquetes - i : 37,
+                          obtenidas + i);
+    for (i = 0; i < cant_paquetes; i++)
+        assert(obtenidas[i] == esperadas[i]);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == 2 * esperado_subida[i]);
+        assert(clases[i].bytes_bajada == 2 * esperado_bajada[i]);
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* fuente por columnas */
+    analizador.tamanio_lote = 64;
+    assert(iniciar_contadores(&analizador) == 0);
+    assert(fuente_memoria(&fuente, paquetes, cant_paquetes) == 0);
+    fuente.siguiente_columnas = siguiente_columnas_prueba;
+    assert(analizar_fuente(&analizador, &fuente, analizar_paquete) ==
+           cant_paquetes);
+    reducir_contadores(&analizador);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+    }
+    free_analizador(&analizador);
+    free_lote_columnas(lote);
+    free(paquetes);
+    free(esperadas);
+    free(obtenidas);
+}
+
+/* lotes que entregan las fuentes de test_fuente_fallida antes de fallar */
+int lotes_antes_de_fallar;
+
+/*
+ * siguiente_lote_fallido
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que entrega lotes llenos de paquetes salientes y falla
+ *  luego de lotes_antes_de_fallar lotes, como una conexion que se corta.
+ */
+int siguiente_lote_fallido(struct fuente *fuente, struct paquete *lote,
+                           int tamanio) {
+    int i;
+    (void) fuente;
+    if (__atomic_sub_fetch(&lotes_antes_de_fallar, 1, __ATOMIC_RELAXED) < 0)
+        return -1;
+    memset(lote, 0, sizeof(struct paquete) * tamanio);
+    for (i = 0; i < tamanio; i++) {
+        lote[i].direccion = SALIENTE;
+        lote[i].bytes = 10;
+        lote[i].cantidad = 1;
+    }
+    return tamanio;
+}
+
+/*
+ * siguiente_columnas_fallido
+ * --------------------------------------------------------------------------
+ *  Igual que siguiente_lote_fallido() por columnas.
+ */
+int siguiente_columnas_fallido(struct fuente *fuente,
+                               struct lote_columnas *lote) {
+    struct paquete paquetes[64];
+    int cantidad;
+    assert(lote->capacidad <= 64);
+    cantidad = siguiente_lote_fallido(fuente, paquetes, lote->capacidad);
+    if (cantidad < 0)
+        return -1;
+    return paquetes_a_columnas(paquetes, cantidad, lote);
+}
+
+/*
+ * test_fuente_fallida
+ * --------------------------------------------------------------------------
+ *  Prueba que analizar_fuente() devuelva error si la fuente falla luego de
+ *  entregar algunos lotes, por filas, por columnas y con la canalizacion, y
+ *  que descartar_contadores() descarte los bytes contados.
+ */
+void test_fuente_fallida() {
+    struct s_analizador analizador;
+    struct clase clases[1];
+    struct fuente fuente;
+    int maximo, hilos;
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    analizador.clases = clases;
+    analizador.cant_clases = 1;
+    analizador.tamanio_lote = 64;
+    maximo = omp_get_max_threads();
+    for (hilos = 1; hilos <= 4; hilos *= 4) {
+        omp_set_num_threads(hilos);
+        assert(iniciar_contadores(&analizador) == 0);
+
+        /* por filas */
+        assert(fuente_memoria(&fuente, NULL, 0) == 0);
+        fuente.siguiente_lote = siguiente_lote_fallido;
+        lotes_antes_de_fallar = 5;
+        assert(analizar_fuente(&analizador, &fuente, analizar_paquete) < 0);
+        assert(fuente.datos == NULL);
+
+        /* por columnas, con la canalizacion si hay varios hilos */
+        assert(fuente_memoria(&fuente, NULL, 0) == 0);
+        fuente.siguiente_columnas = siguiente_columnas_fallido;
+        lotes_antes_de_fallar = 5;
+        assert(analizar_fuente(&analizador, &fuente, analizar_paquete) < 0);
+        assert(fuente.datos == NULL);
+
+        /* los paquetes de los lotes obtenidos se descartan */
+        reducir_contadores(&analizador);
+        assert(clases[0].paquetes_subida + clases[0].paquetes_bajada > 0);
+        analizador.clases[0].bytes_subida = 1;
+        descartar_contadores(&analizador);
+        reducir_contadores(&analizador);
+        assert(clases[0].bytes_subida == 0 && clases[0].bytes_bajada == 0);
+        assert(clases[0].paquetes_subida == 0 &&
+               clases[0].paquetes_bajada == 0);
+    }
+    omp_set_num_threads(maximo);
+    free_analizador(&analizador);
+}
+
+/* firma y cantidad de clases de la base de datos de test_recarga */
+u_int64_t firma_prueba;
+int cant_clases_prueba;
+
+/*
+ * obtener_firma_prueba
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que reemplaza a obtener_firma_clases() en test_recarga.
+ */
+u_int64_t obtener_firma_prueba() {
+    return firma_prueba;
+}
+
+/*
+ * clases_en_bloque
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que copia las clases a un bloque creado con
+ *  crear_clases(), como lo hace obtener_clases(), y libera las originales.
+ */
+struct clase* clases_en_bloque(struct clase *clases, int cant_clases) {
+    struct clase *bloque;
+    struct subred *subredes;
+    struct puerto *puertos;
+    int i, cant_subredes = 0, cant_puertos = 0;
+    for (i = 0; i < cant_clases; i++) {
+        cant_subredes += clases[i].cant_subredes_outside +
+                         clases[i].cant_subredes_inside;
+        cant_puertos += clases[i].cant_puertos_outside +
+                        clases[i].cant_puertos_inside;
+    }
+    bloque = crear_clases(cant_clases, cant_subredes, cant_puertos,
+                          &subredes, &puertos);
+    assert(bloque != NULL);
+    for (i = 0; i < cant_clases; i++) {
+        /* las clases sin subredes o puertos tienen arrays NULL */
+        bloque[i] = clases[i];
+        bloque[i].subredes_outside = subredes;
+        if (clases[i].cant_subredes_outside > 0)
+            memcpy(subredes, clases[i].subredes_outside,
+                   sizeof(struct subred) * clases[i].cant_subredes_outside);
+        subredes += clases[i].cant_subredes_outside;
+        bloque[i].subredes_inside = subredes;
+        if (clases[i].cant_subredes_inside > 0)
+            memcpy(subredes, clases[i].subredes_inside,
+                   sizeof(struct subred) * clases[i].cant_subredes_inside);
+        subredes += clases[i].cant_subredes_inside;
+        bloque[i].puertos_outside = puertos;
+        if (clases[i].cant_puertos_outside > 0)
+            memcpy(puertos, clases[i].puertos_outside,
+                   sizeof(struct puerto) * clases[i].cant_puertos_outside);
+        puertos += clases[i].cant_puertos_outside;
+        bloque[i].puertos_inside = puertos;
+        if (clases[i].cant_puertos_inside > 0)
+            memcpy(puertos, clases[i].puertos_inside,
+                   sizeof(struct puerto) * clases[i].cant_puertos_inside);
+        puertos += clases[i].cant_puertos_inside;
+        liberar_clase(clases + i);
+    }
+    free(clases);
+    return bloque;
+}
+
+/*
+ * obtener_clases_prueba
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que reemplaza a obtener_clases() en test_recarga. Las
+ *  clases aleatorias dependen de la firma, por lo que dos llamadas con la
+ *  misma firma obtienen las mismas clases.
+ */
+int obtener_clases_prueba(struct s_analizador *analizador) {
+    struct clase *clases;
+    int i;
+    clases = malloc(cant_clases_prueba * sizeof(struct clase));
+    srand(firma_prueba);
+    init_clase(clases);
+    for (i = 1; i < cant_clases_prueba; i++) {
+        clase_aleatoria(clases + i);
+        clases[i].id = i;
+    }
+    analizador->clases = clases_en_bloque(clases, cant_clases_prueba);
+    analizador->cant_clases = cant_clases_prueba;
+    return 0;
+}
+
+/*
+ * test_clases_en_bloque
+ * --------------------------------------------------------------------------
+ *  Prueba que crear_clases() reserve las clases, luego las subredes y luego
+ *  los puertos en un solo bloque, y que las clases copiadas al bloque
+ *  clasifiquen igual que las originales.
+ */
+void test_clases_en_bloque() {
+    const int cant_clases = 40;
+    const int cant_paquetes = 5000;
+    struct s_analizador analizador, esperado;
+    struct clase *clases;
+    struct subred *subredes;
+    struct puerto *puertos;
+    struct paquete paquete;
+    char *fin;
+    int i;
+
+    clases = crear_clases(3, 5, 7, &subredes, &puertos);
+    assert(clases != NULL);
+    assert((char *) subredes == (char *) (clases + 3));
+    assert((char *) puertos == (char *) (subredes + 5));
+    fin = (char *) (puertos + 7);
+    /* el bloque esta en cero */
+    for (i = 0; i < 3; i++)
+        assert(clases[i].cant_subredes_outside == 0 &&
+               clases[i].subredes_outside == NULL);
+    for (i = 0; i < 5; i++)
+        assert(subredes[i].red.s_addr == 0 && subredes[i].mascara == 0);
+    for (i = 0; i < 7; i++)
+        assert(puertos[i].numero == 0 && puertos[i].protocolo == 0);
+    assert(fin - (char *) clases == (long) (sizeof(struct clase) * 3 +
+                                            sizeof(struct subred) * 5 +
+                                            sizeof(struct puerto) * 7));
+    free_clases(clases);
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    memset(&esperado, 0, sizeof(struct s_analizador));
+    srand(2025);
+    clases = malloc(cant_clases * sizeof(struct clase));
+    esperado.clases = malloc(cant_clases * sizeof(struct clase));
+    init_clase(clases);
+    init_clase(esperado.clases);
+    for (i = 1; i < cant_clases; i++) {
+        clase_aleatoria(clases + i);
+        clases[i].id = i;
+    }
+    srand(2025);
+    for (i = 1; i < cant_clases; i++) {
+        clase_aleatoria(esperado.clases + i);
+        esperado.clases[i].id = i;
+    }
+    esperado.cant_clases = cant_clases;
+    analizador.clases = clases_en_bloque(clases, cant_clases);
+    analizador.cant_clases = cant_clases;
+
+    /* cada clase apunta dentro del bloque y las listas no se superponen */
+    subredes = (struct subred *) (analizador.clases + cant_clases);
+    for (i = 0; i < cant_clases; i++) {
+        assert(analizador.clases[i].subredes_outside == subredes);
+        subredes += analizador.clases[i].cant_subredes_outside;
+        assert(analizador.clases[i].subredes_inside == subredes);
+        subredes += analizador.clases[i].cant_subredes_inside;
+    }
+    puertos = (struct puerto *) subredes;
+    for (i = 0; i < cant_clases; i++) {
+        assert(analizador.clases[i].puertos_outside == puertos);
+        puertos += analizador.clases[i].cant_puertos_outside;
+        assert(analizador.clases[i].puertos_inside == puertos);
+        puertos += analizador.clases[i].cant_puertos_inside;
+    }
+
+    assert(compilar_clases(&analizador) == 0);
+    assert(compilar_clases(&esperado) == 0);
+    srand(2026);
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        assert(clasificar_paquete(&analizador, &paquete) ==
+               clasificar_paquete(&esperado, &paquete));
+    }
+
+    free_clases(analizador.clases);
+    free_analizador(&analizador);
+    for (i = 0; i < cant_clases; i++)
+        liberar_clase(esperado.clases + i);
+    free(esperado.clases);
+    free_analizador(&esperado);
+}
+
+/*
+ * test_recarga
+ * --------------------------------------------------------------------------
+ *  Prueba que las clases se recarguen solo cuando cambia la firma y pasa el
+ *  intervalo, que las clases instaladas clasifiquen igual que las de la base
+ *  de datos, que se actualice la instantanea y que las ventanas conserven
+ *  los totales de las clases con el mismo id.
+ */
+void test_recarga() {
+    const char *archivo = "bin/tests/recarga.bin";
+    const int cant_paquetes = 5000;
+    const int segundos[] = {60, 120};
+    struct s_analizador analizador, esperado, cargado;
+    struct instantanea instantanea;
+    struct recarga *recarga;
+    struct ventanas *ventanas;
+    struct paquete paquete;
+    time_t ahora = time(NULL), limite;
+    int i, instalada;
+
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    memset(&esperado, 0, sizeof(struct s_analizador));
+    memset(&cargado, 0, sizeof(struct s_analizador));
+    memset(&instantanea, 0, sizeof(struct instantanea));
+    firma_prueba = 20;
+    cant_clases_prueba = 50;
+    assert(obtener_clases_prueba(&analizador) == 0);
+    assert(compilar_clases(&analizador) == 0);
+    assert(vectorizar_clases(&analizador) == 0);
+    assert(iniciar_contadores(&analizador) == 0);
+    assert(iniciar_cache(&analizador) == 0);
+    ventanas = crear_ventanas(cant_clases_prueba, 60, segundos, 2);
+    assert(ventanas != NULL);
+    analizador.clases[3].bytes_subida = 100;
+    analizador.clases[40].bytes_subida = 200;
+    avanzar_ventanas(ventanas, analizador.clases);
+
+    assert(crear_recarga(&analizador, NULL, firma_prueba, 0,
+                         obtener_firma_prueba, obtener_clases_prueba,
+                         archivo) == NULL);
+    recarga = crear_recarga(&analizador, NULL, firma_prueba, 10,
+                            obtener_firma_prueba, obtener_clases_prueba,
+                            archivo);
+    assert(recarga != NULL);
+
+    /* la firma no cambio */
+    assert(revisar_clases(recarga, ahora + 20) == 0);
+    assert(instalar_recarga(recarga, &analizador, ventanas) == 0);
+
+    /* la firma cambio pero no paso el intervalo */
+    firma_prueba = 21;
+    cant_clases_prueba = 30;
+    assert(revisar_clases(recarga, ahora + 25) == 0);
+    assert(revisar_clases(recarga, ahora + 30) == 1);
+    /* no se revisa de nuevo mientras la tabla no se instala */
+    assert(revisar_clases(recarga, ahora + 60) == 0);
+    limite = time(NULL) + 10;
+    while ((instalada = instalar_recarga(recarga, &analizador,
+                                         ventanas)) == 0 &&
+           time(NULL) < limite)
+        ;
+    assert(instalada == 1);
+    assert(analizador.cant_clases == cant_clases_prueba);
+    assert(analizador.indice != NULL && analizador.vectores != NULL);
+    assert(ventanas->cant_clases == cant_clases_prueba);
+    assert(total_ventana(ventanas, 1)[3].bytes_subida == 100);
+
+    /* clasifica igual que las clases de la base de datos */
+    assert(obtener_clases_prueba(&esperado) == 0);
+    assert(compilar_clases(&esperado) == 0);
+    srand(2020);
+    for (i = 0; i < cant_paquetes; i++) {
+        paquete_aleatorio(&paquete);
+        assert(clasificar_paquete(&analizador, &paquete) ==
+               clasificar_paquete(&esperado, &paquete));
+        analizar_paquete(&analizador, &paquete);
+        analizar_paquete(&esperado, &paquete);
+    }
+    reducir_contadores(&analizador);
+    for (i = 0; i < cant_clases_prueba; i++)
+        assert(analizador.clases[i].bytes_subida ==
+               esperado.clases[i].bytes_subida);
+
+    /* la instantanea tiene las clases nuevas */
+    assert(cargar_instantanea(archivo, 21, &cargado, &instantanea) == 0);
+    assert(cargado.cant_clases == cant_clases_prueba);
+    cerrar_instantanea(&cargado, &instantanea);
+    remove(archivo);
+
+    /* misma firma luego del intervalo */
+    assert(revisar_clases(recarga, ahora + 100) == 0);
+    free_recarga(recarga, &analizador);
+    assert(analizador.clases == NULL && analizador.indice == NULL);
+    free_analizador(&analizador);
+    free_clases(esperado.clases);
+    free_analizador(&esperado);
+    free_analizador(&cargado);
+    free_ventanas(ventanas);
+}
+
+/*
+ * fila_copia
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que escribe en *p* una fila de COPY binario con los
+ *  campos del paquete. Los bytes son bigint y el resto int; un largo de
+ *  campo -1 escribe NULL en la direccion. Devuelve el largo de la fila.
+ */
+int fila_copia(unsigned char *p, const char *origen, const char *destino,
+               int puerto_origen, int puerto_destino, int protocolo,
+               int64_t bytes, int direccion, int nulo) {
+    u_int64_t valores[COPIA_CAMPOS];
+    unsigned char *inicio = p;
+    int i, j, largo;
+
+    valores[0] = ntohl(inet_addr(origen));
+    valores[1] = ntohl(inet_addr(destino));
+    valores[2] = puerto_origen;
+    valores[3] = puerto_destino;
+    valores[4] = protocolo;
+    valores[5] = bytes;
+    valores[6] = direccion;
+    valores[7] = 1;
+    p[0] = 0;
+    p[1] = COPIA_CAMPOS;
+    p += 2;
+    for (i = 0; i < COPIA_CAMPOS; i++) {
+        largo = i == 5 ? 8 : 4;
+        if (nulo && i == 6) {
+            memset(p, 0xff, 4);
+            p += 4;
+            continue;
+        }
+        p[0] = p[1] = p[2] = 0;
+        p[3] = largo;
+        for (j = 0; j < largo; j++)
+            p[4 + j] = valores[i] >> (8 * (largo - 1 - j));
+        p += 4 + largo;
+    }
+    return p - inicio;
+}
+
+/*
+ * test_copia
+ * --------------------------------------------------------------------------
+ *  Prueba la decodificacion de filas de COPY binario: la cabecera sola o
+ *  junto con la primer fila, direcciones ip mayores a 2^31, campos NULL, la
+ *  fila final y el rechazo de datos con otro formato.
+ */
+void test_copia() {
+    const unsigned char cabecera[COPIA_CABECERA] = "PGCOPY\n\377\r\n";
+    struct lote_columnas *lote = crear_lote_columnas(3);
+    struct lector_copia lector;
+    struct paquete paquetes[3];
+    unsigned char datos[512];
+    int largo;
+
+    /* cabecera sola y luego una fila por llamada */
+    memset(&lector, 0, sizeof(struct lector_copia));
+    lote->filas = 0;
+    assert(decodificar_copia(&lector, (const char *) datos, 10, lote) < 0);
+    assert(decodificar_copia(&lector, (const char *) cabecera,
+                             COPIA_CABECERA, lote) == 0);
+    largo = fila_copia(datos, "192.168.1.10", "200.1.1.1", 40000, 443,
+                       IPPROTO_TCP, 5000000000LL, SALIENTE, 0);
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) == 1);
+    largo = fila_copia(datos, "8.8.8.8", "10.0.0.1", 53, 5353, IPPROTO_UDP,
+                       80, ENTRANTE, 1);
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) == 1);
+    columnas_a_paquetes(lote, 0, 2, paquetes);
+    assert(paquetes[0].ip_origen.s_addr == inet_addr("192.168.1.10"));
+    assert(paquetes[0].ip_destino.s_addr == inet_addr("200.1.1.1"));
+    assert(paquetes[0].puerto_origen == 40000);
+    assert(paquetes[0].puerto_destino == 443);
+    assert(paquetes[0].protocolo == IPPROTO_TCP);
+    assert(paquetes[0].bytes == 5000000000ULL);
+    assert(paquetes[0].direccion == SALIENTE);
+    assert(paquetes[0].cantidad == 1);
+    assert(paquetes[1].ip_origen.s_addr == inet_addr("8.8.8.8"));
+    assert(paquetes[1].puerto_destino == 5353);
+    /* NULL se guarda como cero */
+    assert(paquetes[1].direccion == 0);
+
+    /* fila final; no se aceptan filas despues de ella */
+    datos[0] = datos[1] = 0xff;
+    assert(decodificar_copia(&lector, (const char *) datos, 2, lote) == 0);
+    assert(lector.terminado && lote->filas == 2);
+    largo = fila_copia(datos, "8.8.8.8", "10.0.0.1", 53, 53, IPPROTO_UDP,
+                       80, ENTRANTE, 0);
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) < 0);
+
+    /* cabecera con extension y dos filas juntas; la tercera no entra */
+    memset(&lector, 0, sizeof(struct lector_copia));
+    lote->filas = 0;
+    memcpy(datos, cabecera, COPIA_CABECERA);
+    datos[18] = 4;
+    largo = COPIA_CABECERA + 4;
+    largo += fila_copia(datos + largo, "1.1.1.1", "2.2.2.2", 1, 2,
+                        IPPROTO_TCP, 3, ENTRANTE, 0);
+    largo += fila_copia(datos + largo, "3.3.3.3", "4.4.4.4", 5, 6,
+                        IPPROTO_TCP, 7, SALIENTE, 0);
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) == 2);
+    assert(lote->ip_destino[1] == inet_addr("4.4.4.4"));
+    assert(lote->bytes[1] == 7);
+    largo = fila_copia(datos, "8.8.8.8", "10.0.0.1", 53, 53, IPPROTO_UDP,
+                       80, ENTRANTE, 0);
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) == 1);
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) < 0);
+
+    /* fila truncada, otra cantidad de campos y otra firma */
+    lote->filas = 0;
+    assert(decodificar_copia(&lector, (const char *) datos, largo - 1,
+                             lote) < 0);
+    lote->filas = 0;
+    datos[1] = COPIA_CAMPOS - 1;
+    assert(decodificar_copia(&lector, (const char *) datos, largo,
+                             lote) < 0);
+    memset(&lector, 0, sizeof(struct lector_copia));
+    memcpy(datos, cabecera, COPIA_CABECERA);
+    datos[0] = 'X';
+    assert(decodificar_copia(&lector, (const char *) datos,
+                             COPIA_CABECERA, lote) < 0);
+    free_lote_columnas(lote);
+}
+
+/*
+ * test_analizar_particiones
+ * --------------------------------------------------------------------------
+ *  Prueba que analizar_particiones() sume los mismos bytes por clase que
+ *  analizar_lote() con todos los paquetes, con particiones de distinto
+ *  tamaño por filas y por columnas, y que devuelva error si una particion no
+ *  se puede abrir o falla al leerla, cerrando todas igual.
+ */
+void test_analizar_particiones() {
+    const int cant_clases = 100;
+    const int cant_paquetes = 7000;
+    const int cant_particiones = 7;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    struct fuente fuentes[cant_particiones];
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    int i, desde, hasta;
+
+    srand(2222);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    for (i = 0; i < cant_paquetes; i++)
+        paquete_aleatorio(paquetes + i);
+    analizar_lote(&analizador, paquetes, cant_paquetes, NULL);
+    for (i = 0; i < cant_clases; i++) {
+        esperado_subida[i] = clases[i].bytes_subida;
+        esperado_bajada[i] = clases[i].bytes_bajada;
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* particiones de tamaño creciente, la mitad por columnas */
+    analizador.tamanio_lote = 64;
+    assert(compilar_clases(&analizador) == 0);
+    assert(iniciar_contadores(&analizador) == 0);
+    assert(iniciar_cache(&analizador) == 0);
+    for (i = 0; i < cant_particiones; i++) {
+        desde = (long) cant_paquetes * i * i /
+                (cant_particiones * cant_particiones);
+        hasta = (long) cant_paquetes * (i + 1) * (i + 1) /
+                (cant_particiones * cant_particiones);
+        assert(fuente_memoria(fuentes + i, paquetes + desde,
+                              hasta - desde) == 0);
+        if (i % 2)
+            fuentes[i].siguiente_columnas = siguiente_columnas_prueba;
+    }
+    assert(analizar_particiones(&analizador, fuentes, cant_particiones,
+                                analizar_paquete) == cant_paquetes);
+    reducir_contadores(&analizador);
+    for (i = 0; i < cant_clases; i++) {
+        assert(clases[i].bytes_subida == esperado_subida[i]);
+        assert(clases[i].bytes_bajada == esperado_bajada[i]);
+    }
+    for (i = 0; i < cant_particiones; i++)
+        assert(fuentes[i].datos == NULL);
+
+    /* una particion que no se puede abrir */
+    for (i = 0; i < cant_particiones; i++)
+        assert(fuente_memoria(fuentes + i, paquetes, 100) == 0);
+    fuentes[3].abrir = abrir_fallida;
+    assert(analizar_particiones(&analizador, fuentes, cant_particiones,
+                                analizar_paquete) < 0);
+    for (i = 0; i < cant_particiones; i++)
+        assert(fuentes[i].datos == NULL);
+
+    /* una particion que falla luego de entregar algunos lotes, por filas y
+     * por columnas */
+    for (i = 0; i < cant_particiones; i++)
+        assert(fuente_memoria(fuentes + i, paquetes, 100) == 0);
+    fuentes[2].siguiente_lote = siguiente_lote_fallido;
+    fuentes[5].siguiente_lote = siguiente_lote_fallido;
+    fuentes[5].siguiente_columnas = siguiente_columnas_fallido;
+    lotes_antes_de_fallar = 3;
+    assert(analizar_particiones(&analizador, fuentes, cant_particiones,
+                                analizar_paquete) < 0);
+    for (i = 0; i < cant_particiones; i++)
+        assert(fuentes[i].datos == NULL);
+    free_analizador(&analizador);
+    free(paquetes);
+}
+
+/*
+ * test_cola
+ * --------------------------------------------------------------------------
+ *  Prueba que la cola respete el orden y la capacidad al dar varias vueltas
+ *  al buffer, y que con varios hilos encolando y desencolando a la vez cada
+ *  dato se desencole exactamente una vez.
+ */
+void test_cola() {
+    const int cant_datos = 200000;
+    const int hilos = 4;
+    struct cola cola;
+    long i, *recibidos = calloc(cant_datos, sizeof(long));
+    long desencolados = 0;
+    int vuelta, maximo;
+
+    /* la capacidad se redondea a potencia de dos */
+    assert(crear_cola(&cola, 5) == 0);
+    assert(desencolar(&cola) == NULL);
+    for (vuelta = 0; vuelta < 3; vuelta++) {
+        for (i = 0; i < 8; i++)
+            assert(encolar(&cola, (void*) (i + 1)) == 0);
+        assert(encolar(&cola, (void*) 9) < 0);
+        for (i = 0; i < 8; i++)
+            assert(desencolar(&cola) == (void*) (i + 1));
+        assert(desencolar(&cola) == NULL);
+    }
+    free_cola(&cola);
+
+    /* varios hilos encolan y desencolan sobre una cola chica */
+    maximo = omp_get_max_threads();
+    omp_set_num_threads(hilos);
+    assert(crear_cola(&cola, 16) == 0);
+    #pragma omp parallel reduction(+:desencolados)
+    {
+        long j, dato;
+        int hilo = omp_get_thread_num();
+        int cant_hilos = omp_get_num_threads();
+        for (j = hilo; j < cant_datos; j += cant_hilos) {
+            while (encolar(&cola, (void*) (j + 1)) < 0) {
+                dato = (long) desencolar(&cola);
+                if (dato) {
+                    __atomic_add_fetch(recibidos + dato - 1, 1,
+                                       __ATOMIC_RELAXED);
+                    desencolados++;
+                }
+            }
+        }
+    }
+    while ((i = (long) desencolar(&cola)) != 0) {
+        recibidos[i - 1]++;
+        desencolados++;
+    }
+    assert(desencolados == cant_datos);
+    for (i = 0; i < cant_datos; i++)
+        assert(recibidos[i] == 1);
+    free_cola(&cola);
+    omp_set_num_threads(maximo);
+    free(recibidos);
+}
+
+/*
+ * test_canalizar_columnas
+ * --------------------------------------------------------------------------
+ *  Prueba que analizar_fuente() con varios hilos y una fuente por columnas
+ *  sume los mismos bytes por clase que analizar_lote(), con lotes mas chicos
+ *  que los hilos de la canalizacion y con una fuente vacia.
+ */
+void test_canalizar_columnas() {
+    const int cant_clases = 100;
+    const int cant_paquetes = 20000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    u_int64_t esperado_subida[cant_clases], esperado_bajada[cant_clases];
+    struct fuente fuente;
+    int i, maximo, tamanio;
+
+    srand(2323);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    for (i = 0; i < cant_paquetes; i++)
+        paquete_aleatorio(paquetes + i);
+    analizar_lote(&analizador, paquetes, cant_paquetes, NULL);
+    for (i = 0; i < cant_clases; i++) {
+        esperado_subida[i] = clases[i].bytes_subida;
+        esperado_bajada[i] = clases[i].bytes_bajada;
+        clases[i].bytes_subida = 0;
+        clases[i].bytes_bajada = 0;
+    }
+
+    /* los contadores y la cache se crean para los hilos de la canalizacion */
+    maximo = omp_get_max_threads();
+    omp_set_num_threads(4);
+    assert(compilar_clases(&analizador) == 0);
+    assert(iniciar_contadores(&analizador) == 0);
+    assert(iniciar_cache(&analizador) == 0);
+    for (tamanio = 1; tamanio <= 64; tamanio *= 8) {
+        analizador.tamanio_lote = tamanio;
+        assert(fuente_memoria(&fuente, paquetes, cant_paquetes) == 0);
+        fuente.siguiente_columnas = siguiente_columnas_prueba;
+        assert(analizar_fuente(&analizador, &fuente, analizar_paquete) ==
+               cant_paquetes);
+        reducir_contadores(&analizador);
+        for (i = 0; i < cant_clases; i++) {
+            assert(clases[i].bytes_subida == esperado_subida[i]);
+            assert(clases[i].bytes_bajada == esperado_bajada[i]);
+            clases[i].bytes_subida = 0;
+            clases[i].bytes_bajada = 0;
+        }
+    }
+    assert(fuente_memoria(&fuente, paquetes, 0) == 0);
+    fuente.siguiente_columnas = siguiente_columnas_prueba;
+    assert(analizar_fuente(&analizador, &fuente, analizar_paquete) == 0);
+    omp_set_num_threads(maximo);
+    free_analizador(&analizador);
+    free(paquetes);
+}
+
+/*
+ * sumar_metricas_clase
+ * --------------------------------------------------------------------------
+ *  Funcion auxiliar que suma las comparaciones de una clase de todos los
+ *  hilos.
+ */
+struct metrica_clase sumar_metricas_clase(const struct metricas *metricas,
+                                          int clase) {
+    struct metrica_clase total = {0, 0, 0};
+    int i;
+    for (i = 0; i < metricas->cant_hilos; i++) {
+        total.intentos += metricas->clases[i * metricas->clases_hilo +
+                                           clase].intentos;
+        total.aciertos += metricas->clases[i * metricas->clases_hilo +
+                                           clase].aciertos;
+        total.cache += metricas->clases[i * metricas->clases_hilo +
+                                        clase].cache;
+    }
+    return total;
+}
+
+/*
+ * test_metricas
+ * --------------------------------------------------------------------------
+ *  Prueba que las metricas cuenten las filas obtenidas, los paquetes de cada
+ *  hilo y las comparaciones y elecciones de cada clase sin y con indice y con
+ *  cache de flujos, que no se cuenten las comparaciones si cambio la
+ *  cantidad de clases y que se escriban en JSON.
+ */
+void test_metricas() {
+    const int cant_clases = 100;
+    const int cant_paquetes = 5000;
+    struct s_analizador analizador;
+    struct clase clases[cant_clases];
+    struct paquete *paquetes = malloc(cant_paquetes * sizeof(struct paquete));
+    u_int64_t coincidencias[cant_clases], elegidas[cant_clases];
+    u_int64_t aciertos, fallos, asignados;
+    struct metrica_clase total;
+    struct fuente fuente;
+    u_int64_t paquetes_hilos;
+    FILE *salida;
+    int i, j, puntaje, mayor_puntaje, mejor;
+
+    srand(2424);
+    memset(&analizador, 0, sizeof(struct s_analizador));
+    init_clase(clases);
+    for (i = 1; i < cant_clases; i++)
+        clase_aleatoria(clases + i);
+    analizador.clases = clases;
+    analizador.cant_clases = cant_clases;
+    for (i = 0; i < cant_paquetes; i++)
+        paquete_aleatorio(paquetes + i);
+    memset(coincidencias, 0, sizeof(coincidencias));
+    memset(elegidas, 0, sizeof(elegidas));
+    for (j = 0; j < cant_paquetes; j++) {
+        mayor_puntaje = 0;
+        mejor = 0;
+        for (i = 1; i < cant_clases; i++) {
+            puntaje = coincide(clases + i, paquetes + j);
+            coincidencias[i] += puntaje > 0;
+            if (puntaje > mayor_puntaje) {
+                mayor_puntaje = puntaje;
+                mejor = i;
+            }
+        }
+        elegidas[mejor]++;
+    }
+
+    /* sin indice ni cache cada clase se compara con todos los paquetes */
+    analizador.metricas = crear_metricas(cant_clases);
+    assert(analizador.metricas != NULL);
+    assert(fuente_memoria(&fuente, paquetes, cant_paquetes) == 0);
+    assert(analizar_fuente(&analizador, &fuente, analizar_paquete) ==
+           cant_paquetes);
+    assert(analizador.metricas->filas == (u_int64_t) cant_paquetes);
+    paquetes_hilos = 0;
+    for (i = 0; i < analizador.metricas->cant_hilos; i++)
+        paquetes_hilos += analizador.metricas->hilos[i].paquetes;
+    assert(paquetes_hilos == (u_int64_t) cant_paquetes);
+    assert(sumar_metricas_clase(analizador.metricas, 0).intentos == 0);
+    assert(sumar_metricas_clase(analizador.metricas, 0).aciertos ==
+           elegidas[0]);
+    for (i = 1; i < cant_clases; i++) {
+        total = sumar_metricas_clase(analizador.metricas, i);
+        assert(total.intentos == (u_int64_t) cant_paquetes);
+        assert(total.aciertos == elegidas[i]);
+        assert(total.cache == 0);
+    }
+
+    /* con indice se comparan las candidatas, que son las que coinciden, y
+     * se elige la misma clase que sin indice */
+    assert(compilar_clases(&analizador) == 0);
+    assert(reiniciar_clases_metricas(analizador.metricas, cant_clases) == 0);
+    analizar_lote(&analizador, paquetes, cant_paquetes, NULL);
+    for (i = 0; i < cant_clases; i++) {
+        total = sumar_metricas_clase(analizador.metricas, i);
+        assert(total.intentos == coincidencias[i]);
+        assert(total.aciertos == elegidas[i]);
+        assert(total.cache == 0);
+    }
+
+    /* con cache, cada paquete se cuenta una vez en la clase elegida, como
+     * eleccion o como acierto de la cache */
+    assert(iniciar_cache(&analizador) == 0);
+    assert(reiniciar_clases_metricas(analizador.metricas, cant_clases) == 0);
+    analizar_lote(&analizador, paquetes, cant_paquetes, NULL);
+    analizar_lote(&analizador, paquetes, cant_paquetes, NULL);
+    estadisticas_cache(&analizador, &aciertos, &fallos);
+    assert(aciertos > (u_int64_t) cant_paquetes / 2);
+    asignados = 0;
+    for (i = 0; i < cant_clases; i++) {
+        total = sumar_metricas_clase(analizador.metricas, i);
+        assert(total.aciertos + total.cache == 2 * elegidas[i]);
+        assert(total.intentos <= 2 * coincidencias[i]);
+        asignados += total.cache;
+    }
+    assert(asignados == aciertos);
+
+    /* con otra cantidad de clases no se cuentan las comparaciones */
+    assert(metricas_clases_hilo(analizador.metricas, cant_clases) != NULL);
+    assert(metricas_clases_hilo(analizador.metricas, cant_clases - 1) ==
+           NULL);
+
+    salida = tmpfile();
+    assert(salida != NULL);
+    assert(metricas_to_file(salida, analizador.metricas, &analizador) == 0);
+    assert(contar_ocurrencias(salida, "\"etapas\"") == 1);
+    assert(contar_ocurrencias(salida, "\"filas_por_segundo\"") == 1);
+    assert(contar_ocurrencias(salida, "\"intentos\"") == cant_clases);
+    assert(contar_ocurrencias(salida, "\"paquetes\"") ==
+           analizador.metricas->cant_hilos);
+    fclose(salida);
+    free_metricas(analizador.metricas);
+    analizador.metricas = NULL;
+    free_analizador(&analizador);
+    free(paquetes);
 }
 
 int main() {
@@ -840,6 +3055,7 @@ int main() {
     test_coincide_subred();
     test_coincide_muchas_subredes();
     test_coincide_subred_origen_destino();
+    test_coincide_prefijo_mas_largo();
     test_coincide_stress(50000000);
     test_coincide_puerto();
     test_coincide_muchos_puertos();
@@ -849,6 +3065,30 @@ int main() {
     test_analizar_paquete();
     test_prefijo();
     test_mejor_coincidencia();
+    test_indice();
+    test_indice_protocolo();
+    test_contadores_hilos();
+    test_contadores_64_bits();
+    test_cache_flujos();
+    test_ventanas();
+    test_instantanea();
+    test_decodificar_paquete();
+    test_analizar_captura();
+    test_vivo();
+    test_analizar_fuente();
+    test_fuente_fallida();
+    test_analizar_lote();
+    test_subredes_simd();
+    test_vectorizar_clases();
+    test_lote_columnas();
+    test_analizar_columnas();
+    test_recarga();
+    test_clases_en_bloque();
+    test_copia();
+    test_analizar_particiones();
+    test_cola();
+    test_canalizar_columnas();
+    test_metricas();
     printf("SUCCESS\n");
     return 0;
 }